@@ -0,0 +1,428 @@
+/* ---------------------------------------------
+DD-CSV.h
+Defines Memory-Mapped Files and a Reader for CSV Data Files
+(fields separated by ',', subfields by ';')
+---------------------------------------------- */
+
+#ifndef CSV_H
+#define CSV_H
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include <string>
+#include <vector>
+#include <stdlib.h>
+#include <string.h>
+
+// A (sub)field is a view into the mapped file; it is only valid while the file is open
+struct KPDField {
+
+	const char * data;
+	int length;
+
+	bool equals(const char * s) const;
+	std::string toString() const;
+	int toInt() const;			// Same as atoi
+	double toDouble() const;	// Same as atof
+};
+
+class KPDCSVRow {
+
+private:
+
+	std::vector<KPDField> subfields;
+	std::vector<int> fieldStart; // Subfields of field f are subfields[fieldStart[f]], ..., subfields[fieldStart[f + 1] - 1]
+
+	friend class KPDCSVFile;
+
+public:
+
+	KPDCSVRow();
+	~KPDCSVRow();
+
+	int getNumberOfFields() const;
+	int getNumberOfSubfields(int field) const;
+
+	const KPDField & getField(int field, int subfield = 0) const;
+};
+
+// A read-only view of a whole file
+class KPDMappedFile {
+
+protected:
+
+	std::string fileName;
+
+	const char * begin;
+	const char * end;
+
+#ifdef _WIN32
+	HANDLE fileHandle;
+	HANDLE mappingHandle;
+#else
+	size_t mappedLength;
+#endif
+
+	// Files are not copyable; views refer to the mapping
+	KPDMappedFile(const KPDMappedFile &);
+	KPDMappedFile & operator=(const KPDMappedFile &);
+
+public:
+
+	KPDMappedFile(std::string name);
+	~KPDMappedFile();
+
+	bool isOpen();
+	std::string getFileName();
+
+	const char * getData();
+	size_t getSize();
+
+	// 64-bit FNV-1a hash of the contents (taken 8 bytes at a time)
+	unsigned long long hash();
+};
+
+class KPDCSVFile : public KPDMappedFile {
+
+private:
+
+	const char * position;
+
+	int rowsRead;
+
+public:
+
+	KPDCSVFile(std::string name);
+	~KPDCSVFile();
+
+	int getRowsRead(); // Non-empty rows, including the header
+
+	// Returns to the start of the file
+	void restart();
+
+	// Offset of the next row, and moving to a previously recorded offset (e.g., to read rows out of order)
+	size_t getPosition();
+	void setPosition(size_t offset);
+
+	// Reads the next non-empty row; returns false at the end of the file
+	bool nextRow(KPDCSVRow & row);
+};
+
+bool KPDField::equals(const char * s) const {
+
+	return (int)strlen(s) == length && strncmp(data, s, length) == 0;
+}
+
+std::string KPDField::toString() const {
+
+	return std::string(data, length);
+}
+
+int KPDField::toInt() const {
+
+	int i = 0;
+	while (i < length && (data[i] == ' ' || data[i] == '\t')) {
+		i++;
+	}
+
+	bool negative = false;
+	if (i < length && (data[i] == '-' || data[i] == '+')) {
+		negative = (data[i] == '-');
+		i++;
+	}
+
+	int value = 0;
+	while (i < length && data[i] >= '0' && data[i] <= '9') {
+		value = 10 * value + (data[i] - '0');
+		i++;
+	}
+
+	return negative ? -value : value;
+}
+
+double KPDField::toDouble() const {
+
+	// Fields are not null-terminated; numbers are short enough to copy to the stack
+	char buffer[64];
+
+	int n = (length < 63) ? length : 63;
+	memcpy(buffer, data, n);
+	buffer[n] = '\0';
+
+	return atof(buffer);
+}
+
+KPDCSVRow::KPDCSVRow() {
+
+}
+
+KPDCSVRow::~KPDCSVRow() {
+
+}
+
+int KPDCSVRow::getNumberOfFields() const {
+
+	return (int)fieldStart.size() - 1;
+}
+
+int KPDCSVRow::getNumberOfSubfields(int field) const {
+
+	return fieldStart[field + 1] - fieldStart[field];
+}
+
+const KPDField & KPDCSVRow::getField(int field, int subfield) const {
+
+	return subfields[fieldStart[field] + subfield];
+}
+
+KPDMappedFile::KPDMappedFile(std::string name) {
+
+	fileName = name;
+
+	begin = NULL;
+	end = NULL;
+
+#ifdef _WIN32
+	fileHandle = INVALID_HANDLE_VALUE;
+	mappingHandle = NULL;
+
+	fileHandle = CreateFileA(name.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+
+	if (fileHandle == INVALID_HANDLE_VALUE) {
+		return;
+	}
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(fileHandle, &size) || size.QuadPart == 0) {
+		begin = end = ""; // Empty files cannot be mapped
+		return;
+	}
+
+	mappingHandle = CreateFileMappingA(fileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+
+	if (mappingHandle != NULL) {
+		begin = (const char *)MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+	}
+
+	if (begin != NULL) {
+		end = begin + size.QuadPart;
+	}
+#else
+	mappedLength = 0;
+
+	int fileDescriptor = open(name.c_str(), O_RDONLY);
+
+	if (fileDescriptor < 0) {
+		return;
+	}
+
+	struct stat fileStatus;
+
+	if (fstat(fileDescriptor, &fileStatus) == 0) {
+
+		if (fileStatus.st_size == 0) {
+			begin = end = ""; // Empty files cannot be mapped
+		}
+		else {
+			void * mapping = mmap(NULL, (size_t)fileStatus.st_size, PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+
+			if (mapping != MAP_FAILED) {
+				mappedLength = (size_t)fileStatus.st_size;
+				begin = (const char *)mapping;
+				end = begin + mappedLength;
+
+				madvise(mapping, mappedLength, MADV_SEQUENTIAL);
+			}
+		}
+	}
+
+	close(fileDescriptor); // The mapping stays valid after the descriptor is closed
+#endif
+}
+
+KPDMappedFile::~KPDMappedFile() {
+
+#ifdef _WIN32
+	if (mappingHandle != NULL) {
+		if (begin != NULL) {
+			UnmapViewOfFile(begin);
+		}
+		CloseHandle(mappingHandle);
+	}
+	if (fileHandle != INVALID_HANDLE_VALUE) {
+		CloseHandle(fileHandle);
+	}
+#else
+	if (mappedLength > 0) {
+		munmap((void *)begin, mappedLength);
+	}
+#endif
+}
+
+bool KPDMappedFile::isOpen() {
+
+	return begin != NULL;
+}
+
+std::string KPDMappedFile::getFileName() {
+
+	return fileName;
+}
+
+const char * KPDMappedFile::getData() {
+
+	return begin;
+}
+
+size_t KPDMappedFile::getSize() {
+
+	return (size_t)(end - begin);
+}
+
+unsigned long long KPDMappedFile::hash() {
+
+	unsigned long long h = 0xCBF29CE484222325ULL;
+
+	if (begin == NULL) {
+		return h;
+	}
+
+	const char * p = begin;
+
+	for (; p + 8 <= end; p += 8) {
+		unsigned long long word;
+		memcpy(&word, p, 8);
+		h = (h ^ word) * 0x100000001B3ULL;
+	}
+
+	for (; p < end; p++) {
+		h = (h ^ (unsigned char)*p) * 0x100000001B3ULL;
+	}
+
+	// Mix in the length, so files that differ only by trailing zero bytes differ
+	return (h ^ (unsigned long long)(end - begin)) * 0x100000001B3ULL;
+}
+
+KPDCSVFile::KPDCSVFile(std::string name) : KPDMappedFile(name) {
+
+	position = begin;
+
+	rowsRead = 0;
+}
+
+KPDCSVFile::~KPDCSVFile() {
+
+}
+
+int KPDCSVFile::getRowsRead() {
+
+	return rowsRead;
+}
+
+void KPDCSVFile::restart() {
+
+	position = begin;
+
+	rowsRead = 0;
+}
+
+size_t KPDCSVFile::getPosition() {
+
+	return (size_t)(position - begin);
+}
+
+void KPDCSVFile::setPosition(size_t offset) {
+
+	position = begin + offset;
+}
+
+bool KPDCSVFile::nextRow(KPDCSVRow & row) {
+
+	row.subfields.clear();
+	row.fieldStart.clear();
+
+	while (position != NULL && position < end) {
+
+		// Find the end of the line (ignoring a trailing carriage return)
+		const char * lineEnd = (const char *)memchr(position, '\n', end - position);
+		const char * next = (lineEnd == NULL) ? end : lineEnd + 1;
+
+		if (lineEnd == NULL) {
+			lineEnd = end;
+		}
+		if (lineEnd > position && *(lineEnd - 1) == '\r') {
+			lineEnd--;
+		}
+
+		const char * line = position;
+		position = next;
+
+		if (lineEnd == line) {
+			continue;
+		}
+
+		rowsRead++;
+
+		// Split into fields (skipping empty fields) and subfields
+		const char * fieldBegin = line;
+
+		while (fieldBegin <= lineEnd) {
+
+			const char * fieldEnd = (const char *)memchr(fieldBegin, ',', lineEnd - fieldBegin);
+			if (fieldEnd == NULL) {
+				fieldEnd = lineEnd;
+			}
+
+			if (fieldEnd > fieldBegin) {
+
+				row.fieldStart.push_back((int)row.subfields.size());
+
+				const char * subfieldBegin = fieldBegin;
+
+				while (true) {
+
+					const char * subfieldEnd = (const char *)memchr(subfieldBegin, ';', fieldEnd - subfieldBegin);
+					if (subfieldEnd == NULL) {
+						subfieldEnd = fieldEnd;
+					}
+
+					KPDField subfield;
+					subfield.data = subfieldBegin;
+					subfield.length = (int)(subfieldEnd - subfieldBegin);
+					row.subfields.push_back(subfield);
+
+					if (subfieldEnd == fieldEnd) {
+						break;
+					}
+
+					subfieldBegin = subfieldEnd + 1;
+				}
+			}
+
+			fieldBegin = fieldEnd + 1;
+		}
+
+		row.fieldStart.push_back((int)row.subfields.size());
+
+		return true;
+	}
+
+	row.fieldStart.push_back(0);
+
+	return false;
+}
+
+#endif
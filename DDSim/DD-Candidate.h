@@ -7,6 +7,7 @@ Stores information about candidates (KPD and waitlist)
 #define CANDIDATE_H
 
 #include "DD-Enums-Functions.h"
+#include "DD-HLA.h"
 
 #include <vector>
 #include <string>
@@ -28,9 +29,15 @@ private:
 	KPDBloodType candidateBT;
 	bool candidateMinorA;
 
-	std::vector<std::string> candidateHLA;
-	std::vector<std::string> candidateUnacceptableHLA;
-	std::vector<std::string> candidateDesensitizableHLA;
+	KPDHLA candidateHLA;
+	std::vector<KPDAntigen> candidateUnacceptableHLA;
+	std::vector<KPDAntigen> candidateDesensitizableHLA;
+
+	//Antigen lists expanded through the HLA dictionary (set by the data, as they depend on the dictionary)
+	bool candidateAntigensExpanded;
+	KPDAntigenSet candidateUnacceptableAntigens; // Antigens associated with the unacceptable HLA
+	KPDAntigenSet candidateDesensitizableAntigens; // Antigens associated with the desensitizable HLA
+	KPDAntigenSet candidateWaitlistUnacceptableAntigens; // Antigens associated with the candidate's own HLA (used for waitlist crossmatches)
 
 	//Characteristics
 	int candidateAge;
@@ -46,6 +53,10 @@ private:
 	double candidateEPTS;
 	bool candidateEPTSPriority;
 
+	//Candidate-only terms of the survival model (5-year, 10-year; set by the data, as they depend on the survival parameters)
+	bool candidateSurvivalTermsSet;
+	double candidateSurvivalTerms[2];
+
 	//Waitlist Information
 	bool candidateWaitlist;
 	int candidateListingTime;
@@ -84,9 +95,14 @@ public:
 	KPDBloodType getBT();
 	bool getMinorA();
 
-	std::vector<std::string> getHLA();
-	std::vector<std::string> getUnacceptableHLA();
-	std::vector<std::string> getDesensitizableHLA();
+	const KPDHLA & getHLA();
+	const std::vector<KPDAntigen> & getUnacceptableHLA();
+	const std::vector<KPDAntigen> & getDesensitizableHLA();
+
+	bool getAntigensExpanded();
+	const KPDAntigenSet & getUnacceptableAntigens();
+	const KPDAntigenSet & getDesensitizableAntigens();
+	const KPDAntigenSet & getWaitlistUnacceptableAntigens();
 
 	int getAge();
 	bool getMale();
@@ -102,6 +118,9 @@ public:
 	double getEPTS();
 	bool getEPTSPriority();
 
+	bool getSurvivalTermsSet();
+	const double * getSurvivalTerms();
+
 	bool getWaitlist();
 	int getListingTime();
 	std::deque<int> getStatusChangeTimes();
@@ -119,9 +138,11 @@ public:
 	void setBT(KPDBloodType bt);
 	void setMinorA(bool minorA);
 
-	void setHLA(std::vector<std::string> hla);
-	void setUnacceptableHLA(std::vector<std::string> hla);
-	void setDesensitizableHLA(std::vector<std::string> hla);
+	void setHLA(const KPDHLA & hla);
+	void setUnacceptableHLA(const std::vector<KPDAntigen> & hla);
+	void setDesensitizableHLA(const std::vector<KPDAntigen> & hla);
+
+	void setExpandedAntigens(const KPDAntigenSet & unacceptable, const KPDAntigenSet & desensitizable, const KPDAntigenSet & waitlistUnacceptable);
 
 	void setAge(int age);
 	void setMale(bool genderMale);
@@ -136,6 +157,8 @@ public:
 	void setEPTS(double epts);
 	void setEPTSPriority(bool priority);
 
+	void setSurvivalTerms(const double terms[2]);
+
 	void setWaitlist(bool waitlist);
 	void setListingTime(int time);
 	void setStatusChangeTime(std::vector<int> time);
@@ -165,6 +188,7 @@ KPDCandidate::KPDCandidate() {
 	candidatePRA = 0;
 	candidateBT = BT_UNSPECIFIED;
 	candidateMinorA = false;
+	candidateAntigensExpanded = false;
 
 	candidateAge = 40;
 	candidateMale = true;
@@ -178,6 +202,7 @@ KPDCandidate::KPDCandidate() {
 	candidateInsurance = INSURANCE_UNSPECIFIED;
 	candidateEPTS = 0;
 	candidateEPTSPriority = false;
+	candidateSurvivalTermsSet = false;
 	
 	candidateWaitlist = false;
 	candidateListingTime = -1;
@@ -196,6 +221,7 @@ KPDCandidate::KPDCandidate(int id, int matchingID, int pra, KPDBloodType bt,
 	candidatePRA = pra;
 	candidateBT = bt;
 	candidateMinorA = false;
+	candidateAntigensExpanded = false;
 
 	candidateAge = age;
 	candidateMale = male;
@@ -209,6 +235,7 @@ KPDCandidate::KPDCandidate(int id, int matchingID, int pra, KPDBloodType bt,
 	candidateInsurance = insurance;
 	candidateEPTS = 0;
 	candidateEPTSPriority = false;
+	candidateSurvivalTermsSet = false;
 
 	candidateWaitlist = false;
 	candidateListingTime = -1;
@@ -228,6 +255,7 @@ KPDCandidate::KPDCandidate(int id, int pra, KPDBloodType bt, bool minorA,
 	candidatePRA = pra;
 	candidateBT = bt;
 	candidateMinorA = minorA;
+	candidateAntigensExpanded = false;
 
 	candidateAge = age;
 	candidateMale = male;
@@ -241,6 +269,7 @@ KPDCandidate::KPDCandidate(int id, int pra, KPDBloodType bt, bool minorA,
 	candidateInsurance = insurance;
 	candidateEPTS = epts;
 	candidateEPTSPriority = eptsPriority;
+	candidateSurvivalTermsSet = false;
 
 	candidateWaitlist = true;
 	candidateListingTime = listingTime;
@@ -260,6 +289,7 @@ KPDCandidate::KPDCandidate(int id, int matchingID, int pra, KPDBloodType bt, boo
 	candidatePRA = pra;
 	candidateBT = bt;
 	candidateMinorA = minorA;
+	candidateAntigensExpanded = false;
 
 	candidateAge = age;
 	candidateMale = male;
@@ -273,6 +303,7 @@ KPDCandidate::KPDCandidate(int id, int matchingID, int pra, KPDBloodType bt, boo
 	candidateInsurance = insurance;
 	candidateEPTS = epts;
 	candidateEPTSPriority = eptsPriority;
+	candidateSurvivalTermsSet = false;
 
 	candidateWaitlist = waitlist;
 	candidateListingTime = listingTime;
@@ -307,37 +338,39 @@ bool KPDCandidate::getMinorA(){
 	return candidateMinorA;
 }
 
-std::vector<std::string> KPDCandidate::getHLA() {
-	
-	std::vector<std::string> hla;
+const KPDHLA & KPDCandidate::getHLA() {
 
-	for (std::vector<std::string>::iterator it = candidateHLA.begin(); it != candidateHLA.end(); it++) {
-		hla.push_back(*it);
-	}
+	return candidateHLA;
+}
 
-	return hla;
+const std::vector<KPDAntigen> & KPDCandidate::getUnacceptableHLA() {
+
+	return candidateUnacceptableHLA;
 }
 
-std::vector<std::string> KPDCandidate::getUnacceptableHLA() {
+const std::vector<KPDAntigen> & KPDCandidate::getDesensitizableHLA() {
 
-	std::vector<std::string> hla;
+	return candidateDesensitizableHLA;
+}
 
-	for (std::vector<std::string>::iterator it = candidateUnacceptableHLA.begin(); it != candidateUnacceptableHLA.end(); it++) {
-		hla.push_back(*it);
-	}
+bool KPDCandidate::getAntigensExpanded() {
 
-	return hla;
+	return candidateAntigensExpanded;
 }
 
-std::vector<std::string> KPDCandidate::getDesensitizableHLA() {
+const KPDAntigenSet & KPDCandidate::getUnacceptableAntigens() {
 
-	std::vector<std::string> hla;
+	return candidateUnacceptableAntigens;
+}
 
-	for (std::vector<std::string>::iterator it = candidateDesensitizableHLA.begin(); it != candidateDesensitizableHLA.end(); it++) {
-		hla.push_back(*it);
-	}
+const KPDAntigenSet & KPDCandidate::getDesensitizableAntigens() {
 
-	return hla;
+	return candidateDesensitizableAntigens;
+}
+
+const KPDAntigenSet & KPDCandidate::getWaitlistUnacceptableAntigens() {
+
+	return candidateWaitlistUnacceptableAntigens;
 }
 
 int KPDCandidate::getAge() {
@@ -392,6 +425,14 @@ bool KPDCandidate::getEPTSPriority(){
 	return candidateEPTSPriority;
 }
 
+bool KPDCandidate::getSurvivalTermsSet() {
+	return candidateSurvivalTermsSet;
+}
+
+const double * KPDCandidate::getSurvivalTerms() {
+	return candidateSurvivalTerms;
+}
+
 bool KPDCandidate::getWaitlist() {
 	return candidateWaitlist;
 }
@@ -450,6 +491,7 @@ void KPDCandidate::setKPDMatchingID(int id) {
 
 void KPDCandidate::setPRA(int pra){
 	candidatePRA = pra;
+	candidateSurvivalTermsSet = false;
 }
 
 void KPDCandidate::setBT(KPDBloodType bt){
@@ -460,32 +502,35 @@ void KPDCandidate::setMinorA(bool minorA){
 	candidateMinorA = minorA;
 }
 
-void KPDCandidate::setHLA(std::vector<std::string> hla) {
+void KPDCandidate::setHLA(const KPDHLA & hla) {
 
-	candidateHLA.clear();
-	for (std::vector<std::string>::iterator it = hla.begin(); it != hla.end(); it++) {
-		candidateHLA.push_back(*it);
-	}
+	candidateHLA = hla;
+	candidateAntigensExpanded = false;
 }
 
-void KPDCandidate::setUnacceptableHLA(std::vector<std::string> unacceptableHLA) {
-	
-	candidateUnacceptableHLA.clear();
-	for (std::vector<std::string>::iterator it = unacceptableHLA.begin(); it != unacceptableHLA.end(); it++) {
-		candidateUnacceptableHLA.push_back(*it);
-	}
+void KPDCandidate::setUnacceptableHLA(const std::vector<KPDAntigen> & unacceptableHLA) {
+
+	candidateUnacceptableHLA = unacceptableHLA;
+	candidateAntigensExpanded = false;
 }
 
-void KPDCandidate::setDesensitizableHLA(std::vector<std::string> desensitizableHLA) {
-	
-	candidateDesensitizableHLA.clear();
-	for (std::vector<std::string>::iterator it = desensitizableHLA.begin(); it != desensitizableHLA.end(); it++) {
-		candidateDesensitizableHLA.push_back(*it);
-	}
+void KPDCandidate::setDesensitizableHLA(const std::vector<KPDAntigen> & desensitizableHLA) {
+
+	candidateDesensitizableHLA = desensitizableHLA;
+	candidateAntigensExpanded = false;
+}
+
+void KPDCandidate::setExpandedAntigens(const KPDAntigenSet & unacceptable, const KPDAntigenSet & desensitizable, const KPDAntigenSet & waitlistUnacceptable) {
+
+	candidateUnacceptableAntigens = unacceptable;
+	candidateDesensitizableAntigens = desensitizable;
+	candidateWaitlistUnacceptableAntigens = waitlistUnacceptable;
+	candidateAntigensExpanded = true;
 }
 
 void KPDCandidate::setAge(int age){
 	candidateAge = age;
+	candidateSurvivalTermsSet = false;
 }
 
 void KPDCandidate::setMale(bool genderMale){
@@ -494,34 +539,42 @@ void KPDCandidate::setMale(bool genderMale){
 
 void KPDCandidate::setRace(KPDRace race){
 	candidateRace = race;
+	candidateSurvivalTermsSet = false;
 }
 
 void KPDCandidate::setHeight(double height) {
 	candidateHeight = height;
+	candidateSurvivalTermsSet = false;
 }
 
 void KPDCandidate::setWeight(double weight){
 	candidateWeight = weight;
+	candidateSurvivalTermsSet = false;
 }
 
 void KPDCandidate::setDiabetes(bool diabetes){
 	candidateDiabetes = diabetes;
+	candidateSurvivalTermsSet = false;
 }
 
 void KPDCandidate::setPrevTrans(bool prevTrans){
 	candidatePrevTrans = prevTrans;
+	candidateSurvivalTermsSet = false;
 }
 
 void KPDCandidate::setTOD(double tod){
 	candidateTOD = tod;
+	candidateSurvivalTermsSet = false;
 }
 
 void KPDCandidate::setHepC(bool hepC){
 	candidateHepC = hepC;
+	candidateSurvivalTermsSet = false;
 }
 
 void KPDCandidate::setInsurance(KPDInsurance insurance) {
 	candidateInsurance = insurance;
+	candidateSurvivalTermsSet = false;
 }
 
 void KPDCandidate::setEPTS(double epts){
@@ -532,6 +585,13 @@ void KPDCandidate::setEPTSPriority(bool priority){
 	candidateEPTSPriority = priority;
 }
 
+void KPDCandidate::setSurvivalTerms(const double terms[2]) {
+
+	candidateSurvivalTerms[0] = terms[0];
+	candidateSurvivalTerms[1] = terms[1];
+	candidateSurvivalTermsSet = true;
+}
+
 void KPDCandidate::setWaitlist(bool waitlist) {
 	candidateWaitlist = waitlist;
 }
@@ -669,20 +729,20 @@ std::string KPDCandidate::candidateOutput() {
 	
 	if (candidateWaitlist) {
 		candidateInfo << KPDFunctions::indent(tab) << "HLA:";
-		for (std::vector<std::string>::iterator hla = candidateHLA.begin(); hla != candidateHLA.end(); hla++) {
-			candidateInfo << " " << *hla;
+		for (const KPDAntigen * hla = candidateHLA.begin(); hla != candidateHLA.end(); hla++) {
+			candidateInfo << " " << KPDAntigenTable::name(*hla);
 		}
 	}
 	else {
 		candidateInfo << KPDFunctions::indent(tab) << "Unacceptable HLA:";
-		for (std::vector<std::string>::iterator hla = candidateUnacceptableHLA.begin(); hla != candidateUnacceptableHLA.end(); hla++) {
-			candidateInfo << " " << *hla;
+		for (std::vector<KPDAntigen>::iterator hla = candidateUnacceptableHLA.begin(); hla != candidateUnacceptableHLA.end(); hla++) {
+			candidateInfo << " " << KPDAntigenTable::name(*hla);
 		}
 		candidateInfo << std::endl;
 
 		candidateInfo << KPDFunctions::indent(tab) << "Desensitizable HLA:";
-		for (std::vector<std::string>::iterator hla = candidateDesensitizableHLA.begin(); hla != candidateDesensitizableHLA.end(); hla++) {
-			candidateInfo << " " << *hla;
+		for (std::vector<KPDAntigen>::iterator hla = candidateDesensitizableHLA.begin(); hla != candidateDesensitizableHLA.end(); hla++) {
+			candidateInfo << " " << KPDAntigenTable::name(*hla);
 		}
 	}
 	candidateInfo << std::endl;
@@ -708,6 +768,12 @@ KPDCandidate * KPDCandidate::copy(){
 	copyCandidate->setUnacceptableHLA(candidateUnacceptableHLA);
 	copyCandidate->setDesensitizableHLA(candidateDesensitizableHLA);
 	copyCandidate->setHLA(candidateHLA);
+	if (candidateAntigensExpanded) {
+		copyCandidate->setExpandedAntigens(candidateUnacceptableAntigens, candidateDesensitizableAntigens, candidateWaitlistUnacceptableAntigens);
+	}
+	if (candidateSurvivalTermsSet) {
+		copyCandidate->setSurvivalTerms(candidateSurvivalTerms);
+	}
 	copyCandidate->setStatusChangeTime(candidateStatusChangeTimes);
 	copyCandidate->setStatusChanges(candidateStatuses);
 
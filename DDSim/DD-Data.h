@@ -9,41 +9,111 @@ Collects and Stores Data from Files
 #include "DD-Enums-Functions.h"
 #include "DD-Candidate.h"
 #include "DD-Donor.h"
+#include "DD-Survival.h"
 #include "DD-Parameters.h"
 #include "DD-RNG.h"
+#include "DD-CSV.h"
+#include "DD-DataCache.h"
 
 #include <vector>
 #include <string>
 #include <map>
+#include <algorithm>
 #include <iostream>
 #include <sstream>
 #include <fstream>
 #include <stdlib.h>
 #include <math.h>
 
-class KPDData {
+// Crossmatch information of many candidates in contiguous arrays, for crossmatching donors against all of them at once
+class KPDCrossmatchPanel {
 
 private:
 
-	KPDParameters * kpdParameters;
+	bool waitlist;
+
+	std::vector<KPDCandidate *> candidates;
+	std::vector<KPDBloodType> bloodTypes;
+	std::vector<KPDAntigenSet> unacceptableAntigens; // Waitlist crossmatches use the antigens associated with the candidate's own HLA
+	std::vector<KPDAntigenSet> desensitizableAntigens;
+	std::vector<char> antigensExpanded;
+	std::vector<char> antigensExact;
+	bool allAntigensExact; // All candidates are expanded, with exact antigen sets
+
+	friend class KPDData;
+
+public:
+
+	KPDCrossmatchPanel();
+	KPDCrossmatchPanel(const std::vector<KPDCandidate *> & candidates, bool waitlist);
+	~KPDCrossmatchPanel();
+
+	void setCandidates(const std::vector<KPDCandidate *> & candidates, bool waitlist); // The panel refers to the candidates, which must outlive it
+	int size() const;
+};
+
+// What part of a donor's HLA does to a crossmatch with a given candidate (the whole HLA is in the worst class of its parts)
+#define ANTIGEN_CLASS_NONE 0
+#define ANTIGEN_CLASS_DESENSITIZABLE 1
+#define ANTIGEN_CLASS_UNACCEPTABLE 2
+#define ANTIGEN_CLASSES 3
+
+// A generated donor's HLA is two haplotypes and the BW4 and BW6 antigens, drawn independently
+#define DONOR_HLA_COMPONENTS 4
+
+// Generated donor HLA split by antigen class for candidates with the same unacceptable and desensitizable antigens, for drawing donors that are incompatible with their candidate
+class KPDIncompatibleDonorSampler {
+
+private:
+
+	// Haplotypes in the desensitizable and unacceptable classes (sorted), drawn from with the alias tables; these are few, so haplotypes
+	// in no class are not listed, and are drawn from all haplotypes, redrawing any that are in a class
+	std::vector<int> haplotypes[ANTIGEN_CLASSES];
+	KPDAliasTable haplotypeAliasTables[ANTIGEN_CLASSES];
+
+	int bwClass[2]; // Classes of the BW4 and BW6 antigens
 
-	//Raw data
-	std::vector<std::vector<std::vector<std::string> > > hlaFrequencyData;
-	std::vector<std::vector<std::vector<std::string> > > hlaDictionaryData;
-	std::vector<std::vector<std::vector<std::string> > > characteristicsData;
+	double componentProbability[DONOR_HLA_COMPONENTS][ANTIGEN_CLASSES]; // Probability of each class for the two haplotypes, BW4 and BW6
 
-	std::vector<std::vector<std::vector<std::string> > > kpdData;
-	std::vector<std::vector<std::vector<std::string> > > deceasedDonorData;
-	std::vector<std::vector<std::vector<std::string> > > waitlistCandidatesData;
+	friend class KPDData;
+
+public:
+
+	KPDIncompatibleDonorSampler();
+	~KPDIncompatibleDonorSampler();
+
+	// Probability that the whole HLA is in each class
+	void getClassProbabilities(double probability[ANTIGEN_CLASSES]) const;
+
+	// Classes of the HLA components, given the class of the whole HLA (u holds a uniform for each component)
+	void sampleComponentClasses(int hlaClass, const double * u, int componentClass[DONOR_HLA_COMPONENTS]) const;
+
+	int getHaplotypeClass(int haplotype) const;
+};
+
+class KPDData {
+
+private:
+
+	KPDParameters * kpdParameters;
 
 	//Clean data	
-	std::vector<std::vector<std::string> > donorHLA;
+	std::vector<KPDHLA> donorHLA;
 	std::vector<double> donorHLAFrequency;
 
-	std::map<std::string, std::vector<std::string> > hlaDictionary;
+	std::vector<std::vector<KPDAntigen> > hlaDictionary; // Unacceptable antigens associated with each antigen (by antigen ID)
+
+	KPDAntigen antigenBW4;
+	KPDAntigen antigenBW6;
 	std::map<std::string, std::vector<double> > survivalParameters;
 	std::map<std::string, std::vector<double> > characteristicsFrequency;
 
+	//Alias tables for drawing HLA haplotypes and characteristics in constant time (built once the frequencies are read)
+	KPDAliasTable donorHLAAliasTable;
+	std::map<std::string, KPDAliasTable> characteristicsAliasTables;
+
+	KPDSurvivalModel survivalModel; // Compiled from the survival parameters
+
 	std::vector<KPDDonor *> nddPool;
 	std::vector<KPDCandidate *> candidatePool;
 	std::vector<KPDCandidate *> pairedCandidatesPool;
@@ -56,19 +126,70 @@ private:
 
 	std::map<int, std::vector<int> > actualDeceasedDonorWaitlistCandidateTransplants;
 
+	//Streamed data (deceased donors and waitlist candidates are indexed by time, and formed from the mapped files as they arrive)
+	bool streamDeceasedDonorsAndWaitlist;
 
-	//Convert raw to clean data
+	KPDCSVFile * deceasedDonorFile;
+	KPDCSVFile * waitlistCandidatesFile;
 
-	void readDataFromFile(std::vector<std::vector<std::vector<std::string> > > & parsedData, std::string fileName); // Reads and parses data from files
+	std::vector<std::pair<int, size_t> > deceasedDonorStream; // (Recovery Time, Row Position), in order of recovery
+	std::vector<std::pair<int, int> > waitlistCandidateStream; // (First Status Change Time, Candidate), in order of first status change
+	std::vector<size_t> waitlistCandidateRows; // Row positions of candidate c are waitlistCandidateRows[waitlistCandidateFirstRow[c]], ..., [waitlistCandidateFirstRow[c + 1] - 1]
+	std::vector<int> waitlistCandidateFirstRow;
 
-	void formDonorHLAFrequency();
-	void formHLADictionary();	
-	void formSurvivalParameters();	
-	void formCharacteristicsFrequency();
+	int deceasedDonorStreamPosition;
+	int waitlistCandidateStreamPosition;
 
-	void formKPDPopulation();
-	void formDeceasedDonorPopulation();
-	void formWaitlistPopulation();
+	//Convert data files to clean data (rows are converted as they are read, and are not kept)
+
+	bool readHeader(KPDCSVFile & file); // Starts reading a data file, skipping the header
+
+	void formDonorHLAFrequency(KPDCSVFile & file);
+	void formHLADictionary(KPDCSVFile & file);
+	void formSurvivalParameters(KPDCSVFile & file);
+	void formCharacteristicsFrequency(KPDCSVFile & file);
+
+	void formKPDPopulation(KPDCSVFile & file);
+	void formDeceasedDonorPopulation(KPDCSVFile & file);
+	void formWaitlistPopulation(KPDCSVFile & file);
+
+	KPDDonor * formDeceasedDonor(const KPDCSVRow & srtrRow);
+	KPDCandidate * formWaitlistCandidate(const KPDCSVRow & srtrRow);
+	void addWaitlistStatusChange(KPDCandidate * candidate, const KPDCSVRow & srtrRow);
+
+	void indexDeceasedDonorPopulation(KPDCSVFile & file);
+	void indexWaitlistPopulation(KPDCSVFile & file);
+
+	//Binary cache of assembled data (the data log is cached along with it)
+	bool readDataFromCache(KPDDataCache & cache, std::string & dataLog);
+	void writeDataToCache(KPDDataCache & cache, const std::string & dataLog);
+	void clearData();
+
+	void formAliasTables();
+
+	//Incompatible donors are drawn from the donor distribution conditioned on failing the crossmatch with their candidate
+	std::vector<KPDIncompatibleDonorSampler> incompatibleDonorSamplers; // One for each distinct pair of unacceptable and desensitizable antigen lists
+	std::vector<double> donorBTProbability; // Probabilities of BT_O, BT_A, BT_B and BT_AB for generated donors
+	std::vector<double> donorHLAProbability; // Probabilities of the haplotypes for generated donors
+	std::vector<std::vector<int> > antigenHaplotypes; // Haplotypes with each antigen (by antigen ID)
+	std::map<std::pair<std::vector<KPDAntigen>, std::vector<KPDAntigen> >, int> incompatibleDonorSamplerIndices;
+
+	void formIncompatibleDonorSamplers();
+
+	int getAntigenClass(const std::vector<char> & antigenClasses, KPDAntigen antigen);
+	KPDDonor * formGeneratedDonor(int btIndex, int hlaIndex1, int hlaIndex2, bool bw4, bool bw6);
+
+	//Crossmatching: candidate antigen lists are expanded through the HLA dictionary once, so a crossmatch is a blood type lookup and bitset tests
+	void expandAntigens(KPDCandidate * candidate);
+
+	//Whether the donor has any antigen the dictionary associates with the given antigen (used when the antigen sets cannot hold all antigen IDs)
+	bool hasUnacceptableAntigen(KPDAntigen antigen, const KPDHLA & donorHLA);
+	KPDCrossmatch performCrossmatchByAntigens(KPDCandidate * candidate, KPDDonor * donor, bool waitlist, KPDCrossmatch bloodTypeCrossmatch);
+	KPDCrossmatch performCrossmatchByAntigenLists(KPDCandidate * candidate, KPDDonor * donor, bool waitlist, KPDCrossmatch bloodTypeCrossmatch);
+
+	//Survival: the candidate-only and donor-only terms are calculated once, when the candidate or donor is formed
+	void calculateSurvivalTerms(KPDCandidate * candidate);
+	void calculateSurvivalTerms(KPDDonor * donor);
 
 	std::stringstream kpdDataLog;
 
@@ -87,15 +208,32 @@ public:
 
 	std::vector<int> getActualTransplantedCandidates(int donorID);
 
-	// Stochastic draws from data
+	// Stream deceased donors and waitlisted candidates in time order (the caller owns the returned objects)
+	bool getStreamDeceasedDonorsAndWaitlist();
+	void restartStreams();
+	KPDDonor * nextDeceasedDonor(int time); // Next deceased donor recovered by the given time (NULL if none)
+	KPDCandidate * nextWaitlistedCandidate(int time, int & position); // Next waitlisted candidate whose first status change is by the given time (NULL if none); position is the candidate's order of first appearance, as when all candidates are loaded
+
+	// Stochastic draws from data (drawn candidates and NDDs are shared with the pools and owned by the data; generated donors are owned by the caller)
 	std::pair<KPDCandidate *, int> drawCandidate(double u);
 	KPDDonor * drawNDD(double u);
-	KPDDonor * generateDonor(std::vector<double> u);
+	KPDDonor * generateDonor(const std::vector<double> & u);
+	int indexOfIncompatibleDonorSampler(KPDCandidate * candidate); // Sampler for the candidate's unacceptable and desensitizable antigens (formed if new)
+	KPDDonor * generateIncompatibleDonor(int samplerIndex, KPDCandidate * candidate, const std::vector<double> & u, RNG & rng); // Uses 9 uniforms, and rng to redraw haplotypes; NULL if no donor can be incompatible with the candidate
 
 	// Crossmatch and survival calculations
 	KPDCrossmatch performCrossmatch(KPDCandidate * candidate, KPDDonor * donor, bool waitlist);
+	// One donor against many candidates, and one candidate against many donors (results[i] is the crossmatch with the i-th candidate or donor)
+	void performCrossmatchBatch(KPDDonor * donor, const std::vector<KPDCandidate *> & candidates, bool waitlist, std::vector<KPDCrossmatch> & results);
+	void performCrossmatchBatch(KPDDonor * donor, const KPDCrossmatchPanel & panel, std::vector<KPDCrossmatch> & results);
+	void performCrossmatchBatch(KPDCandidate * candidate, const std::vector<KPDDonor *> & donors, bool waitlist, std::vector<KPDCrossmatch> & results);
 	bool allowableMatch(KPDCrossmatch crossmatch);
 	double calculateSurvival(KPDCandidate * candidate, KPDDonor * donor, int fiveyear);
+	void calculateSurvival(KPDCandidate * candidate, KPDDonor * donor, double & fiveYearSurvival, double & tenYearSurvival);
+
+	// Pairs (candidates[i], donors[i]), and one candidate against many donors (survival[i] is the survival of the i-th pair)
+	void calculateSurvivalBatch(const std::vector<KPDCandidate *> & candidates, const std::vector<KPDDonor *> & donors, std::vector<double> & fiveYearSurvival, std::vector<double> & tenYearSurvival);
+	void calculateSurvivalBatch(KPDCandidate * candidate, const std::vector<KPDDonor *> & donors, std::vector<double> & fiveYearSurvival, std::vector<double> & tenYearSurvival);
 	
 	void printLog();
 };
@@ -104,102 +242,141 @@ KPDData::KPDData(KPDParameters * params) {
 	
 	kpdParameters = params;
 
+	antigenBW4 = KPDAntigenTable::intern("BW4");
+	antigenBW6 = KPDAntigenTable::intern("BW6");
+
 	kpdDataLog << "--------------------------" << std::endl;
 	kpdDataLog << "Reading Data from Files..." << std::endl;
 	kpdDataLog << "--------------------------" << std::endl;
 
 	kpdDataLog << std::endl;
 	
-	// Read data 
-	readDataFromFile(hlaFrequencyData, "data/" + params->getFileHLAFrequency());
-	readDataFromFile(hlaDictionaryData, "data/" + params->getFileHLADictionary());
-	readDataFromFile(characteristicsData, "data/" + params->getFileSurvivalParameters());
+	// Read data (files stay mapped until the objects are assembled, or for the whole run if deceased donors and waitlist candidates are streamed)
+	KPDCSVFile hlaFrequencyFile("data/" + params->getFileHLAFrequency());
+	KPDCSVFile hlaDictionaryFile("data/" + params->getFileHLADictionary());
+	KPDCSVFile characteristicsFile("data/" + params->getFileSurvivalParameters());
 
-	readDataFromFile(kpdData, "data/" + params->getFileKPDData());
-	readDataFromFile(deceasedDonorData, "data/" + params->getFileDeceasedDonors());
-	readDataFromFile(waitlistCandidatesData, "data/" + params->getFileWaitingListCandidates());
+	KPDCSVFile kpdFile("data/" + params->getFileKPDData());
+	deceasedDonorFile = new KPDCSVFile("data/" + params->getFileDeceasedDonors());
+	waitlistCandidatesFile = new KPDCSVFile("data/" + params->getFileWaitingListCandidates());
 
-	kpdDataLog << std::endl;
-	
-	// Assemble objects from raw data
-	formDonorHLAFrequency();
-	formHLADictionary();
-	formSurvivalParameters();
-	formCharacteristicsFrequency();
-
-	formKPDPopulation();
-	formDeceasedDonorPopulation();
-	formWaitlistPopulation();
-}
+	streamDeceasedDonorsAndWaitlist = params->getStreamDeceasedDonorsAndWaitlist();
 
-KPDData::~KPDData() {
-	printLog();
-}
+	deceasedDonorStreamPosition = 0;
+	waitlistCandidateStreamPosition = 0;
 
-void KPDData::readDataFromFile(std::vector<std::vector<std::vector<std::string> > > & parsedData, std::string fileName) {
+	// The cache is keyed by the contents of the files and the options used in assembling the KPD population
+	std::vector<unsigned long long> cacheKey;
 
-	std::stringstream log;
-	std::ifstream iFile;
-	iFile.open(fileName.c_str());
+	if (params->getUseDataCache()) {
+		cacheKey.push_back(hlaFrequencyFile.hash());
+		cacheKey.push_back(hlaDictionaryFile.hash());
+		cacheKey.push_back(characteristicsFile.hash());
 
-	if (!iFile.is_open()) {
-		std::cerr << "Cannot open file for reading: " << fileName << std::endl;
+		cacheKey.push_back(kpdFile.hash());
+		cacheKey.push_back(deceasedDonorFile->hash());
+		cacheKey.push_back(waitlistCandidatesFile->hash());
+
+		cacheKey.push_back(params->getAllowDesensitization());
+		cacheKey.push_back(params->getReserveODonorsForOCandidates());
+		cacheKey.push_back(streamDeceasedDonorsAndWaitlist);
 	}
 
-	int i = 0;
-	while (!iFile.eof()) {
+	KPDDataCache cache("data/" + params->getFileDataCache(), cacheKey);
 
-		//Extract row
-		std::stringstream rowStream;
-		std::string row;
-		getline(iFile, row);
+	std::string dataLog;
 
-		if (row.empty())
-			continue;
+	if (params->getUseDataCache() && cache.open() && readDataFromCache(cache, dataLog)) {
 
-		rowStream << row;
+		kpdDataLog << dataLog;
+		kpdDataLog << "Data Loaded from Cache " << cache.getFileName() << std::endl << std::endl;
+	}
+
+	else {
 
-		if (i > 0) {
+		std::streampos dataLogStart = kpdDataLog.tellp();
 
-			std::vector<std::vector<std::string> > dataRow;
+		// Assemble objects directly from the data files
+		formDonorHLAFrequency(hlaFrequencyFile);
+		formHLADictionary(hlaDictionaryFile);
+		formSurvivalParameters(characteristicsFile);
+		formCharacteristicsFrequency(characteristicsFile);
 
-			while (!rowStream.eof()) {
+		formKPDPopulation(kpdFile);
 
-				//Extract token
-				std::stringstream tokenStream;
-				std::string token;
-				getline(rowStream, token, ',');
+		if (!streamDeceasedDonorsAndWaitlist) {
+			formDeceasedDonorPopulation(*deceasedDonorFile);
+			formWaitlistPopulation(*waitlistCandidatesFile);
+		}
 
-				if (token.empty())
-					continue;
+		kpdDataLog << "Read in " << hlaFrequencyFile.getRowsRead() << " rows from " << hlaFrequencyFile.getFileName() << std::endl;
+		kpdDataLog << "Read in " << hlaDictionaryFile.getRowsRead() << " rows from " << hlaDictionaryFile.getFileName() << std::endl;
+		kpdDataLog << "Read in " << characteristicsFile.getRowsRead() << " rows from " << characteristicsFile.getFileName() << std::endl;
 
-				tokenStream << token;
+		kpdDataLog << "Read in " << kpdFile.getRowsRead() << " rows from " << kpdFile.getFileName() << std::endl;
 
-				std::vector<std::string> dataField;
+		if (!streamDeceasedDonorsAndWaitlist) {
+			kpdDataLog << "Read in " << deceasedDonorFile->getRowsRead() << " rows from " << deceasedDonorFile->getFileName() << std::endl;
+			kpdDataLog << "Read in " << waitlistCandidatesFile->getRowsRead() << " rows from " << waitlistCandidatesFile->getFileName() << std::endl;
+		}
 
-				while (!tokenStream.eof()) {
+		kpdDataLog << std::endl;
 
-					std::string subToken;
-					getline(tokenStream, subToken, ';');
+		if (params->getUseDataCache()) {
 
-					dataField.push_back(subToken);
-				}
+			dataLog = kpdDataLog.str().substr((size_t)dataLogStart);
+			writeDataToCache(cache, dataLog);
 
-				dataRow.push_back(dataField);
+			if (cache.save()) {
+				kpdDataLog << "Data Cache Written to " << cache.getFileName() << std::endl << std::endl;
+			}
+			else {
+				kpdDataLog << "Could Not Write Data Cache " << cache.getFileName() << std::endl << std::endl;
 			}
-
-			parsedData.push_back(dataRow);
 		}
+	}
+
+	formAliasTables();
+	formIncompatibleDonorSamplers();
+
+	// Streamed files stay mapped; only the positions and times of their rows are kept
+	if (streamDeceasedDonorsAndWaitlist) {
+		indexDeceasedDonorPopulation(*deceasedDonorFile);
+		indexWaitlistPopulation(*waitlistCandidatesFile);
+	}
+
+	else {
+		delete deceasedDonorFile;
+		delete waitlistCandidatesFile;
+
+		deceasedDonorFile = NULL;
+		waitlistCandidatesFile = NULL;
+	}
+}
+
+KPDData::~KPDData() {
+	printLog();
+
+	delete deceasedDonorFile;
+	delete waitlistCandidatesFile;
+}
 
-		i++;
+bool KPDData::readHeader(KPDCSVFile & file) {
+
+	if (!file.isOpen()) {
+		std::cerr << "Cannot open file for reading: " << file.getFileName() << std::endl;
+		return false;
 	}
 
-	iFile.close();
+	file.restart();
+
+	KPDCSVRow header;
+	file.nextRow(header);
 
-	kpdDataLog << "Read in " << i << " rows from " << fileName << std::endl;
+	return true;
 }
 
-void KPDData::formDonorHLAFrequency() {
+void KPDData::formDonorHLAFrequency(KPDCSVFile & file) {
 
 	kpdDataLog << "--------------------------------" << std::endl;
 	kpdDataLog << "Setting Donor HLA Frequencies..." << std::endl;
@@ -209,16 +386,20 @@ void KPDData::formDonorHLAFrequency() {
 
 	//Columns 1-8: Major HLA antigens; Column 9: Frequency
 
-	for (std::vector<std::vector<std::vector<std::string> > >::iterator hlaRow = hlaFrequencyData.begin(); hlaRow != hlaFrequencyData.end(); hlaRow++) {
-		std::vector<std::string> donorProfile;
+	KPDCSVRow hlaRow;
+
+	readHeader(file);
+
+	while (file.nextRow(hlaRow)) {
+		KPDHLA donorProfile;
 
-		for (std::vector<std::vector<std::string> >::iterator hla = hlaRow->begin(); hla != hlaRow->begin() + 8; hla++) {
+		for (int hla = 0; hla < 8; hla++) {
 
-			std::string antigen = (*hla)[0];
+			std::string antigen = hlaRow.getField(hla).toString();
 
 			if (antigen.compare("NA") != 0) {
 				
-				donorProfile.push_back(antigen);
+				donorProfile.add(antigen);
 
 				kpdDataLog << antigen << " ";
 			}
@@ -227,9 +408,7 @@ void KPDData::formDonorHLAFrequency() {
 		donorHLA.push_back(donorProfile);
 
 		//Stores frequency info
-		std::vector<std::vector<std::string> >::iterator profileFreq = (*hlaRow).begin() + 8;
-		std::string freq = (*profileFreq).at(0);
-		double probability = atof(freq.c_str());
+		double probability = hlaRow.getField(8).toDouble();
 		donorHLAFrequency.push_back(probability);
 
 		kpdDataLog << "(" << probability << ")" << std::endl;
@@ -240,7 +419,7 @@ void KPDData::formDonorHLAFrequency() {
 	kpdDataLog << "Donor HLA Frequencies Set" << std::endl << std::endl;
 }
 
-void KPDData::formHLADictionary() {
+void KPDData::formHLADictionary(KPDCSVFile & file) {
 
 	kpdDataLog << "--------------------------------" << std::endl;
 	kpdDataLog << "Loading HLA Dictionary..." << std::endl;
@@ -248,15 +427,26 @@ void KPDData::formHLADictionary() {
 
 	kpdDataLog << std::endl;
 
-	for (std::vector<std::vector<std::vector<std::string> > >::iterator dictionaryRow = hlaDictionaryData.begin(); dictionaryRow != hlaDictionaryData.end(); dictionaryRow++) {
-		std::string antigen = (*dictionaryRow)[0][0];
+	KPDCSVRow dictionaryRow;
+
+	readHeader(file);
+
+	while (file.nextRow(dictionaryRow)) {
+		std::string antigen = dictionaryRow.getField(0).toString();
+
+		KPDAntigen antigenID = KPDAntigenTable::intern(antigen);
 
 		kpdDataLog << antigen << ": ";
 
-		for (std::vector<std::string>::iterator hla = (*dictionaryRow)[1].begin(); hla != (*dictionaryRow)[1].end(); hla++) {
-			hlaDictionary[antigen].push_back(*hla);
+		for (int hla = 0; hla < dictionaryRow.getNumberOfSubfields(1); hla++) {
+			KPDAntigen unacceptableAntigen = KPDAntigenTable::intern(dictionaryRow.getField(1, hla).toString());
+
+			if ((int)hlaDictionary.size() <= antigenID) {
+				hlaDictionary.resize(antigenID + 1);
+			}
+			hlaDictionary[antigenID].push_back(unacceptableAntigen);
 
-			kpdDataLog << *hla << " ";
+			kpdDataLog << KPDAntigenTable::name(unacceptableAntigen) << " ";
 		}
 
 		kpdDataLog << std::endl;
@@ -267,7 +457,7 @@ void KPDData::formHLADictionary() {
 	kpdDataLog << "HLA Dictionary Loaded" << std::endl << std::endl;
 }
 
-void KPDData::formSurvivalParameters() {
+void KPDData::formSurvivalParameters(KPDCSVFile & file) {
 
 	kpdDataLog << "------------------------------" << std::endl;
 	kpdDataLog << "Setting Survival Parameters..." << std::endl;
@@ -275,26 +465,32 @@ void KPDData::formSurvivalParameters() {
 
 	kpdDataLog << std::endl;
 	
-	for (std::vector<std::vector<std::vector<std::string> > >::iterator paramRow = characteristicsData.begin(); paramRow != characteristicsData.end(); paramRow++) {
+	KPDCSVRow paramRow;
+
+	readHeader(file);
 
-		std::string characteristic = (*paramRow)[0][0];
+	while (file.nextRow(paramRow)) {
+
+		std::string characteristic = paramRow.getField(0).toString();
 
 		kpdDataLog << characteristic << ": ";
 
 		// Store 5-year and 10-year survival parameters
-		survivalParameters["5 Year " + characteristic].push_back(atof((*paramRow)[2][0].c_str()));
-		kpdDataLog << (*paramRow)[2][0] << " (5-Year), ";
+		survivalParameters["5 Year " + characteristic].push_back(paramRow.getField(2).toDouble());
+		kpdDataLog << paramRow.getField(2).toString() << " (5-Year), ";
 
-		survivalParameters["10 Year " + characteristic].push_back(atof((*paramRow)[3][0].c_str()));
-		kpdDataLog << (*paramRow)[3][0] << " (10-Year)"  << std::endl;
+		survivalParameters["10 Year " + characteristic].push_back(paramRow.getField(3).toDouble());
+		kpdDataLog << paramRow.getField(3).toString() << " (10-Year)"  << std::endl;
 	}
 
+	survivalModel.compile(survivalParameters);
+
 	kpdDataLog << std::endl;
 	
 	kpdDataLog << "Survival Parameters Set" << std::endl << std::endl;
 }
 
-void KPDData::formCharacteristicsFrequency() {
+void KPDData::formCharacteristicsFrequency(KPDCSVFile & file) {
 
 	kpdDataLog << "------------------------------------" << std::endl;
 	kpdDataLog << "Setting Characteristics Frequency..." << std::endl;
@@ -302,9 +498,13 @@ void KPDData::formCharacteristicsFrequency() {
 
 	kpdDataLog << std::endl;
 		
-	for (std::vector<std::vector<std::vector<std::string> > >::iterator paramRow = characteristicsData.begin(); paramRow != characteristicsData.end(); paramRow++) {
+	KPDCSVRow paramRow;
 
-		std::string characteristic = (*paramRow)[0][0];
+	readHeader(file);
+
+	while (file.nextRow(paramRow)) {
+
+		std::string characteristic = paramRow.getField(0).toString();
 
 		// Collect probabilities for randomly assigned characterisitcs
 		if (characteristic.compare("Donor Race") == 0 || 
@@ -314,9 +514,9 @@ void KPDData::formCharacteristicsFrequency() {
 			characteristic.compare("Recipient Hepatitis C Seriology") == 0 || 
 			characteristic.compare("Recipient Insurance") == 0) {
 
-			characteristicsFrequency[characteristic].push_back(atof((*paramRow)[6][0].c_str()));
+			characteristicsFrequency[characteristic].push_back(paramRow.getField(6).toDouble());
 
-			kpdDataLog << characteristic << ": " << (*paramRow)[6][0] << std::endl;
+			kpdDataLog << characteristic << ": " << paramRow.getField(6).toString() << std::endl;
 		}
 	}
 
@@ -353,7 +553,7 @@ void KPDData::formCharacteristicsFrequency() {
 
 }
 
-void KPDData::formKPDPopulation() {
+void KPDData::formKPDPopulation(KPDCSVFile & file) {
 
 	kpdDataLog << "-------------------------" << std::endl;
 	kpdDataLog << "Forming KPD Population..." << std::endl;
@@ -366,33 +566,35 @@ void KPDData::formKPDPopulation() {
 	int numberOfPairedCandidates = 0;
 	int numberOfPairedDonors = 0;
 
-	std::vector<std::vector<std::vector<std::string> > >::iterator it = kpdData.begin();
+	KPDCSVRow row;
 
-	while (it != kpdData.end()) {
+	readHeader(file);
 
-		int matchingID = atoi((*it)[0][0].c_str());
-		std::string ndd = (*it)[1][0];
+	bool rowRead = file.nextRow(row);
 
+	while (rowRead) {
+
+		int matchingID = row.getField(0).toInt();
 		//Non-Directed Donor
-		if (ndd.compare("TRUE") == 0) {
+		if (row.getField(1).equals("TRUE")) {
 
 			KPDRelation dRelation = RELATION_UNSPECIFIED;
 
-			int donorID = atoi((*it)[3][0].c_str());
+			int donorID = row.getField(3).toInt();
 
 			//Donor Crossmatch Information
-			KPDBloodType dBT = KPDFunctions::stringToBloodType((*it)[7][0]);
+			KPDBloodType dBT = KPDFunctions::stringToBloodType(row.getField(7).toString());
 
-			std::vector<std::string> dHLA;
-			for (std::vector<std::string>::iterator hla = (*it)[8].begin(); hla != (*it)[8].end(); hla++) {
-				dHLA.push_back(*hla);
+			KPDHLA dHLA;
+			for (int hla = 0; hla < row.getNumberOfSubfields(8); hla++) {
+				dHLA.add(row.getField(8, hla).toString());
 			}
 
 			//Donor Characteristics
-			int dAge = atoi((*it)[15][0].c_str());
-			bool dMale = ((*it)[16][0].compare("MALE") == 0);
-			double dHeight = atof((*it)[17][0].c_str());
-			double dWeight = atof((*it)[18][0].c_str());
+			int dAge = row.getField(15).toInt();
+			bool dMale = (row.getField(16).equals("MALE"));
+			double dHeight = row.getField(17).toDouble();
+			double dWeight = row.getField(18).toDouble();
 
 			KPDRace dRace = RACE_OTHER;
 			bool dCigaretteUse = false;
@@ -401,6 +603,7 @@ void KPDData::formKPDPopulation() {
 				dBT, dRelation, dAge, dMale, dRace, dHeight, dWeight, dCigaretteUse);
 
 			d->setHLA(dHLA);
+			calculateSurvivalTerms(d);
 
 			kpdDataLog << "NDD " << donorID << " (Matching ID: " << matchingID << ") added to NDD Pool" << std::endl;
 			kpdDataLog << d->donorOutput() << std::endl;
@@ -408,30 +611,30 @@ void KPDData::formKPDPopulation() {
 			nddPool.push_back(d);
 			numberOfNDDs++;
 
-			it++;
+			rowRead = file.nextRow(row);
 		}
 
 		//Incompatible Donor-Candidate Pairing
 		else {
-			int candidateID = atoi((*it)[2][0].c_str());
+			int candidateID = row.getField(2).toInt();
 
 			//Recipient Crossmatch Information
-			int cPRA = atoi((*it)[4][0].c_str());
-			KPDBloodType cBT = KPDFunctions::stringToBloodType((*it)[5][0]);
+			int cPRA = row.getField(4).toInt();
+			KPDBloodType cBT = KPDFunctions::stringToBloodType(row.getField(5).toString());
 
-			std::vector<std::string> cUnacceptableHLA;
-			std::vector<std::string> cDesensitizableHLA;
-			for (std::vector<std::string>::iterator hla = (*it)[6].begin(); hla != (*it)[6].end(); hla++) {
-				cUnacceptableHLA.push_back(*hla);
+			std::vector<KPDAntigen> cUnacceptableHLA;
+			std::vector<KPDAntigen> cDesensitizableHLA;
+			for (int hla = 0; hla < row.getNumberOfSubfields(6); hla++) {
+				cUnacceptableHLA.push_back(KPDAntigenTable::intern(row.getField(6, hla).toString()));
 			}
 
 			//Recipient Characteristics
-			int cAge = atoi((*it)[9][0].c_str());
-			bool cMale = ((*it)[10][0].compare("MALE") == 0);
-			KPDRace cRace = KPDFunctions::stringToRace((*it)[11][0]);
-			bool cDiabetes = ((*it)[12][0].compare("TRUE") == 0);
-			double cHeight = atof((*it)[13][0].c_str());
-			double cWeight = atof((*it)[14][0].c_str());
+			int cAge = row.getField(9).toInt();
+			bool cMale = (row.getField(10).equals("MALE"));
+			KPDRace cRace = KPDFunctions::stringToRace(row.getField(11).toString());
+			bool cDiabetes = (row.getField(12).equals("TRUE"));
+			double cHeight = row.getField(13).toDouble();
+			double cWeight = row.getField(14).toDouble();
 
 			bool cPrevTrans = false;
 			double cTOD = 1.5;
@@ -443,6 +646,8 @@ void KPDData::formKPDPopulation() {
 			
 			c->setUnacceptableHLA(cUnacceptableHLA);
 			c->setDesensitizableHLA(cDesensitizableHLA);
+			expandAntigens(c);
+			calculateSurvivalTerms(c);
 			
 			kpdDataLog << "Candidate " << candidateID << " (Matching ID: " << matchingID << ") added to Candidate Pool" << std::endl;
 			kpdDataLog << c->candidateOutput() << std::endl;
@@ -457,27 +662,27 @@ void KPDData::formKPDPopulation() {
 			bool compatiblePair = false;
 
 			do {
-				int donorID = atoi((*it)[3][0].c_str());
+				int donorID = row.getField(3).toInt();
 
 				//Donor Crossmatch Information
-				KPDBloodType dBT = KPDFunctions::stringToBloodType((*it)[7][0]);
+				KPDBloodType dBT = KPDFunctions::stringToBloodType(row.getField(7).toString());
 
 				if (dBT == BT_AB) {
 					abDonor = true;
 				}
 
-				std::vector<std::string> dHLA;
-				for (std::vector<std::string>::iterator hla = (*it)[8].begin(); hla != (*it)[8].end(); hla++) {
-					dHLA.push_back(*hla);
+				KPDHLA dHLA;
+				for (int hla = 0; hla < row.getNumberOfSubfields(8); hla++) {
+					dHLA.add(row.getField(8, hla).toString());
 				}
 
 				//Donor Characteristics
 				KPDRelation dRelation = RELATION_UNSPECIFIED;
 
-				int dAge = atoi((*it)[15][0].c_str());
-				bool dMale = ((*it)[16][0].compare("MALE") == 0);
-				double dHeight = atof((*it)[17][0].c_str());
-				double dWeight = atof((*it)[18][0].c_str());
+				int dAge = row.getField(15).toInt();
+				bool dMale = (row.getField(16).equals("MALE"));
+				double dHeight = row.getField(17).toDouble();
+				double dWeight = row.getField(18).toDouble();
 
 				KPDRace dRace = RACE_OTHER;
 				bool dCigaretteUse = false;
@@ -486,6 +691,7 @@ void KPDData::formKPDPopulation() {
 					dBT, dRelation, dAge, dMale, dRace, dHeight, dWeight, dCigaretteUse);
 
 				d->setHLA(dHLA);
+				calculateSurvivalTerms(d);
 
 				associatedDonors.push_back(d);
 
@@ -494,9 +700,9 @@ void KPDData::formKPDPopulation() {
 					compatiblePair = true;
 				}
 
-				it++;
+				rowRead = file.nextRow(row);
 
-			} while (matchingID == atoi((*it)[0][0].c_str()) && it != kpdData.end());
+			} while (rowRead && matchingID == row.getField(0).toInt());
 
 			
 			if (!compatiblePair) {
@@ -518,6 +724,8 @@ void KPDData::formKPDPopulation() {
 				kpdDataLog << "Donors Excluded with Candidate " << matchingID << std::endl;
 				for (std::vector<KPDDonor *>::iterator donorIt = associatedDonors.begin(); donorIt != associatedDonors.end(); donorIt++) {
 					kpdDataLog << (*donorIt)->donorOutput() << std::endl;
+
+					delete *donorIt; // Not kept in any pool
 				}
 			}
 		}
@@ -530,7 +738,96 @@ void KPDData::formKPDPopulation() {
 }
 
 
-void KPDData::formDeceasedDonorPopulation() {
+KPDDonor * KPDData::formDeceasedDonor(const KPDCSVRow & srtrRow) {
+
+	int id = srtrRow.getField(0).toInt();
+		
+	int recoveryTimeSinceReference = 0;
+	const KPDField & recoveryTime = srtrRow.getField(1);
+	if (!recoveryTime.equals("NA")) {
+		recoveryTimeSinceReference = recoveryTime.toInt();
+	}
+
+	int opo = srtrRow.getField(2).toInt();
+
+	KPDBloodType bt = KPDFunctions::stringToBloodType(srtrRow.getField(3).toString());
+	bool minorA = srtrRow.getField(4).equals("TRUE");
+
+	int age = srtrRow.getField(5).toInt();
+	bool genderMale = srtrRow.getField(6).equals("M");
+	KPDRace race = KPDFunctions::stringToRace(srtrRow.getField(7).toString());
+	double height = srtrRow.getField(8).toDouble() / 100.0;
+	double weight = srtrRow.getField(9).toDouble();
+	bool cigarette = srtrRow.getField(10).equals("TRUE");
+
+	KPDHLA dHLA;
+	if (!srtrRow.getField(11).equals("NA")) {
+		dHLA.add("A" + srtrRow.getField(11).toString());
+	}
+	if (!srtrRow.getField(12).equals("NA")) {
+		dHLA.add("A" + srtrRow.getField(12).toString());
+	}
+	if (!srtrRow.getField(13).equals("NA")) {
+		dHLA.add("B" + srtrRow.getField(13).toString());
+	}
+	if (!srtrRow.getField(14).equals("NA")) {
+		dHLA.add("B" + srtrRow.getField(14).toString());
+	}
+	if (srtrRow.getField(15).equals("True")) {
+		dHLA.add("BW4");
+	}
+	if (srtrRow.getField(16).equals("True")) {
+		dHLA.add("BW6");
+	}
+	if (!srtrRow.getField(17).equals("NA")) {
+		dHLA.add("CW" + srtrRow.getField(17).toString());
+	}
+	if (!srtrRow.getField(18).equals("NA")) {
+		dHLA.add("CW" + srtrRow.getField(18).toString());
+	}
+	if (!srtrRow.getField(19).equals("NA")) {
+		dHLA.add("DR" + srtrRow.getField(19).toString());
+	}
+	if (!srtrRow.getField(20).equals("NA")) {
+		dHLA.add("DR" + srtrRow.getField(20).toString());
+	}
+	if (srtrRow.getField(21).equals("True")) {
+		dHLA.add("DR51");
+	}
+	if (srtrRow.getField(22).equals("True")) {
+		dHLA.add("DR52");
+	}
+	if (srtrRow.getField(23).equals("True")) {
+		dHLA.add("DR53");
+	}
+	if (!srtrRow.getField(24).equals("NA")) {
+		dHLA.add("DQ" + srtrRow.getField(24).toString());
+	}
+	if (!srtrRow.getField(25).equals("NA")) {
+		dHLA.add("DQ" + srtrRow.getField(25).toString());
+	}
+	if (!srtrRow.getField(26).equals("NA")) {
+		dHLA.add("DP" + srtrRow.getField(26).toString());
+	}
+	if (!srtrRow.getField(27).equals("NA")) {
+		dHLA.add("DP" + srtrRow.getField(27).toString());
+	}
+
+	bool bothKidneysAvailable = srtrRow.getField(28).toInt() == 2;
+	double kdpi = 1.0;
+
+	KPDDonor * d = new KPDDonor(id, bt, minorA,
+		age, genderMale, race, height, weight, cigarette,
+		recoveryTimeSinceReference, opo, kdpi);
+
+	d->setHLA(dHLA);
+	d->setBothKidneysAvailable(bothKidneysAvailable);
+	calculateSurvivalTerms(d);
+
+	return d;
+}
+
+void KPDData::formDeceasedDonorPopulation(KPDCSVFile & file) {
 
 	kpdDataLog << "--------------------------------" << std::endl;
 	kpdDataLog << "Loading Deceased Donors..." << std::endl;
@@ -538,99 +835,126 @@ void KPDData::formDeceasedDonorPopulation() {
 
 	kpdDataLog << std::endl;
 
-	for (std::vector<std::vector<std::vector<std::string> > >::iterator srtrRow = deceasedDonorData.begin(); srtrRow != deceasedDonorData.end(); srtrRow++) {
+	KPDCSVRow srtrRow;
 
-		int id = atoi((*srtrRow)[0][0].c_str());
-			
-		int recoveryTimeSinceReference = 0;
-		std::string recoveryTime = (*srtrRow)[1][0];
-		if (recoveryTime.compare("NA") != 0) {
-			recoveryTimeSinceReference = atoi(recoveryTime.c_str());
-		}
+	readHeader(file);
 
-		int opo = atoi((*srtrRow)[2][0].c_str());
+	while (file.nextRow(srtrRow)) {
 
-		KPDBloodType bt = KPDFunctions::stringToBloodType((*srtrRow)[3][0]);
-		bool minorA = (*srtrRow)[4][0].compare("TRUE") == 0;
+		KPDDonor * d = formDeceasedDonor(srtrRow);
 
-		int age = atoi((*srtrRow)[5][0].c_str());
-		bool genderMale = (*srtrRow)[6][0].compare("M") == 0;
-		KPDRace race = KPDFunctions::stringToRace((*srtrRow)[7][0]);
-		double height = atof((*srtrRow)[8][0].c_str()) / 100.0;
-		double weight = atof((*srtrRow)[9][0].c_str());
-		bool cigarette = (*srtrRow)[10][0].compare("TRUE") == 0;
+		deceasedDonors.push_back(d);
 
-		std::vector<std::string> dHLA;
-		if ((*srtrRow)[11][0].compare("NA") != 0) {
-			dHLA.push_back("A" + (*srtrRow)[11][0]);
-		}
-		if ((*srtrRow)[12][0].compare("NA") != 0) {
-			dHLA.push_back("A" + (*srtrRow)[12][0]);
-		}
-		if ((*srtrRow)[13][0].compare("NA") != 0) {
-			dHLA.push_back("B" + (*srtrRow)[13][0]);
-		}
-		if ((*srtrRow)[14][0].compare("NA") != 0) {
-			dHLA.push_back("B" + (*srtrRow)[14][0]);
-		}
-		if ((*srtrRow)[15][0].compare("True") == 0) {
-			dHLA.push_back("BW4");
-		}
-		if ((*srtrRow)[16][0].compare("True") == 0) {
-			dHLA.push_back("BW6");
-		}
-		if ((*srtrRow)[17][0].compare("NA") != 0) {
-			dHLA.push_back("CW" + (*srtrRow)[17][0]);
-		}
-		if ((*srtrRow)[18][0].compare("NA") != 0) {
-			dHLA.push_back("CW" + (*srtrRow)[18][0]);
-		}
-		if ((*srtrRow)[19][0].compare("NA") != 0) {
-			dHLA.push_back("DR" + (*srtrRow)[19][0]);
-		}
-		if ((*srtrRow)[20][0].compare("NA") != 0) {
-			dHLA.push_back("DR" + (*srtrRow)[20][0]);
-		}
-		if ((*srtrRow)[21][0].compare("True") == 0) {
-			dHLA.push_back("DR51");
-		}
-		if ((*srtrRow)[22][0].compare("True") == 0) {
-			dHLA.push_back("DR52");
-		}
-		if ((*srtrRow)[23][0].compare("True") == 0) {
-			dHLA.push_back("DR53");
-		}
-		if ((*srtrRow)[24][0].compare("NA") != 0) {
-			dHLA.push_back("DQ" + (*srtrRow)[24][0]);
-		}
-		if ((*srtrRow)[25][0].compare("NA") != 0) {
-			dHLA.push_back("DQ" + (*srtrRow)[25][0]);
-		}
-		if ((*srtrRow)[26][0].compare("NA") != 0) {
-			dHLA.push_back("DP" + (*srtrRow)[26][0]);
-		}
-		if ((*srtrRow)[27][0].compare("NA") != 0) {
-			dHLA.push_back("DP" + (*srtrRow)[27][0]);
-		}
+		kpdDataLog << "Deceased Donor " << d->getDonorID() << std::endl;
+		kpdDataLog << d->donorOutput() << std::endl;		
+	}
+}
 
-		bool bothKidneysAvailable = atoi((*srtrRow)[28][0].c_str()) == 2;
-		double kdpi = 1.0;
+KPDCandidate * KPDData::formWaitlistCandidate(const KPDCSVRow & srtrRow) {
 
-		KPDDonor * d = new KPDDonor(id, bt, minorA,
-			age, genderMale, race, height, weight, cigarette,
-			recoveryTimeSinceReference, opo, kdpi);
+	int id = srtrRow.getField(0).toInt();
 
-		d->setHLA(dHLA);
-		d->setBothKidneysAvailable(bothKidneysAvailable);
+	int listingTime = 0;
+	const KPDField & listingTimeBegin = srtrRow.getField(1);
+	if (!listingTimeBegin.equals("NA")) {
+		listingTime = listingTimeBegin.toInt();
+	}
 
-		deceasedDonors.push_back(d);
+	int opo = srtrRow.getField(6).toInt();
 
-		kpdDataLog << "Deceased Donor " << id << std::endl;
-		kpdDataLog << d->donorOutput() << std::endl;		
+	KPDBloodType bt = KPDFunctions::stringToBloodType(srtrRow.getField(7).toString());
+	bool minorA = srtrRow.getField(8).equals("TRUE");
+
+	int age = 40;
+	const KPDField & ageCategory = srtrRow.getField(9);
+	if (ageCategory.equals("Age < 18 years")) {
+		age = 18;
+	}
+	else if (ageCategory.equals("Age 18-29 years")) {
+		age = 26;
+	}
+	else if (ageCategory.equals("Age 30-39 years")) {
+		age = 35;
+	}
+	else if (ageCategory.equals("Age 40-49 years")) {
+		age = 45;
+	}
+	else if (ageCategory.equals("Age 50-59 years")) {
+		age = 55;
+	}
+	else if (ageCategory.equals("Age 60+ years")) {
+		age = 65;
+	}
+
+	bool genderMale = srtrRow.getField(10).equals("M");
+	KPDRace race = KPDFunctions::stringToRace(srtrRow.getField(11).toString());
+	int pra = srtrRow.getField(12).toInt();
+	double height = srtrRow.getField(13).toDouble() / 100;
+	double weight = srtrRow.getField(14).toDouble();
+	bool hepC = srtrRow.getField(15).equals("Y");
+	bool previousTransplant = srtrRow.getField(16).equals("Yes");
+	int timeOnDialysis = srtrRow.getField(17).toInt();
+	bool diabetes = srtrRow.getField(18).equals("Diabetes");
+	KPDInsurance insurance = KPDFunctions::stringToInsurance(srtrRow.getField(19).toString());
+
+	double epts = srtrRow.getField(20).toDouble();
+	bool eptsPriority = srtrRow.getField(21).equals("TRUE");
+
+	KPDHLA cHLA;
+	if (!srtrRow.getField(22).equals("0")) {
+		cHLA.add("A" + srtrRow.getField(22).toString());
+	}
+	if (!srtrRow.getField(23).equals("0")) {
+		cHLA.add("A" + srtrRow.getField(23).toString());
+	}
+	if (!srtrRow.getField(24).equals("0")) {
+		cHLA.add("B" + srtrRow.getField(24).toString());
+	}
+	if (!srtrRow.getField(25).equals("0")) {
+		cHLA.add("B" + srtrRow.getField(25).toString());
+	}
+	if (!srtrRow.getField(26).equals("0")) {
+		cHLA.add("DR" + srtrRow.getField(26).toString());
+	}
+	if (!srtrRow.getField(27).equals("0")) {
+		cHLA.add("DR" + srtrRow.getField(27).toString());
+	}
+
+	int withdrawalTime = -1;
+	if (!srtrRow.getField(29).equals("NA")) {
+		withdrawalTime = srtrRow.getField(29).toInt();
+	}
+	
+	bool withdrawn = srtrRow.getField(29).equals("NA") && srtrRow.getField(30).equals("Removed from Waitlist");
+
+	KPDCandidate * c = new KPDCandidate(id, pra, bt, minorA,
+		age, genderMale, race, diabetes, height, weight, previousTransplant, timeOnDialysis, hepC, insurance, epts, eptsPriority,
+		listingTime, opo, withdrawn, withdrawalTime);
+
+	c->setHLA(cHLA);
+	expandAntigens(c);
+	calculateSurvivalTerms(c);
+
+	addWaitlistStatusChange(c, srtrRow);
+
+	return c;
+}
+
+void KPDData::addWaitlistStatusChange(KPDCandidate * candidate, const KPDCSVRow & srtrRow) {
+
+	int statusTime = 0;
+	const KPDField & statusTimeBegin = srtrRow.getField(3);
+	if (!statusTimeBegin.equals("NA")) {
+		statusTime = statusTimeBegin.toInt();
 	}
+
+	bool active = !srtrRow.getField(4).equals("Inactive");
+
+	candidate->addStatusChangeTime(statusTime);
+	candidate->addStatusChange(active);
 }
 
-void KPDData::formWaitlistPopulation() {
+void KPDData::formWaitlistPopulation(KPDCSVFile & file) {
 
 	kpdDataLog << "--------------------------------" << std::endl;
 	kpdDataLog << "Loading Waitlist Candidates..." << std::endl;
@@ -638,116 +962,30 @@ void KPDData::formWaitlistPopulation() {
 
 	kpdDataLog << std::endl;
 
-	for (std::vector<std::vector<std::vector<std::string> > >::iterator srtrRow = waitlistCandidatesData.begin(); srtrRow != waitlistCandidatesData.end(); srtrRow++) {
+	KPDCSVRow srtrRow;
 
-		int id = atoi((*srtrRow)[0][0].c_str());
-		
-		int statusTime = 0;
-		std::string statusTimeBegin = (*srtrRow)[3][0];
-		if (statusTimeBegin.compare("NA") != 0) {
-			statusTime = atoi(statusTimeBegin.c_str());
-		}
+	readHeader(file);
+
+	while (file.nextRow(srtrRow)) {
 
-		bool active = (*srtrRow)[4][0].compare("Inactive") != 0;
+		int id = srtrRow.getField(0).toInt();
 
 		if (waitlistCandidates.count(id) == 0) {
 
 			waitlistCandidateIDs.push_back(id);
 
-			int listingTime = 0;
-			std::string listingTimeBegin = (*srtrRow)[1][0];
-			if (listingTimeBegin.compare("NA") != 0) {
-				listingTime = atoi(listingTimeBegin.c_str());
-			}
-
-			int opo = atoi((*srtrRow)[6][0].c_str());
-
-			KPDBloodType bt = KPDFunctions::stringToBloodType((*srtrRow)[7][0]);
-			bool minorA = (*srtrRow)[8][0].compare("TRUE") == 0;
-
-			int age = 40;
-			string ageCategory = (*srtrRow)[9][0];
-			if (ageCategory.compare("Age < 18 years") == 0) {
-				age = 18;
-			}
-			else if (ageCategory.compare("Age 18-29 years") == 0) {
-				age = 26;
-			}
-			else if (ageCategory.compare("Age 30-39 years") == 0) {
-				age = 35;
-			}
-			else if (ageCategory.compare("Age 40-49 years") == 0) {
-				age = 45;
-			}
-			else if (ageCategory.compare("Age 50-59 years") == 0) {
-				age = 55;
-			}
-			else if (ageCategory.compare("Age 60+ years") == 0) {
-				age = 65;
-			}
-
-			bool genderMale = (*srtrRow)[10][0].compare("M") == 0;
-			KPDRace race = KPDFunctions::stringToRace((*srtrRow)[11][0]);
-			int pra = atoi((*srtrRow)[12][0].c_str());
-			double height = atof((*srtrRow)[13][0].c_str()) / 100;
-			double weight = atof((*srtrRow)[14][0].c_str());
-			bool hepC = (*srtrRow)[15][0].compare("Y") == 0;
-			bool previousTransplant = (*srtrRow)[16][0].compare("Yes") == 0;
-			int timeOnDialysis = atoi((*srtrRow)[17][0].c_str());
-			bool diabetes = (*srtrRow)[18][0].compare("Diabetes") == 0;
-			KPDInsurance insurance = KPDFunctions::stringToInsurance((*srtrRow)[19][0]);
-
-			double epts = atof((*srtrRow)[20][0].c_str());
-			bool eptsPriority = (*srtrRow)[21][0].compare("TRUE") == 0;
-
-			std::vector<std::string> cHLA;
-			if ((*srtrRow)[22][0].compare("0") != 0) {
-				cHLA.push_back("A" + (*srtrRow)[22][0]);
-			}
-			if ((*srtrRow)[23][0].compare("0") != 0) {
-				cHLA.push_back("A" + (*srtrRow)[23][0]);
-			}
-			if ((*srtrRow)[24][0].compare("0") != 0) {
-				cHLA.push_back("B" + (*srtrRow)[24][0]);
-			}
-			if ((*srtrRow)[25][0].compare("0") != 0) {
-				cHLA.push_back("B" + (*srtrRow)[25][0]);
-			}
-			if ((*srtrRow)[26][0].compare("0") != 0) {
-				cHLA.push_back("DR" + (*srtrRow)[26][0]);
-			}
-			if ((*srtrRow)[27][0].compare("0") != 0) {
-				cHLA.push_back("DR" + (*srtrRow)[27][0]);
-			}
-
-			int withdrawalTime = -1;
-			if ((*srtrRow)[29][0].compare("NA") != 0) {
-				withdrawalTime = atoi((*srtrRow)[29][0].c_str());
-			}
-			
-			bool withdrawn = (*srtrRow)[29][0].compare("NA") == 0 && (*srtrRow)[30][0].compare("Removed from Waitlist") == 0;
-
-			if ((*srtrRow)[31][0].compare("NA") != 0) {
+			if (!srtrRow.getField(31).equals("NA")) {
 
-				int actualDonorID = atoi((*srtrRow)[31][0].c_str());
+				int actualDonorID = srtrRow.getField(31).toInt();
 				actualDeceasedDonorWaitlistCandidateTransplants[actualDonorID].push_back(id);
 			}
-						
-			KPDCandidate * c = new KPDCandidate(id, pra, bt, minorA,
-				age, genderMale, race, diabetes, height, weight, previousTransplant, timeOnDialysis, hepC, insurance, epts, eptsPriority,
-				listingTime, opo, withdrawn, withdrawalTime);
-
-			c->setHLA(cHLA);
-			c->addStatusChangeTime(statusTime);
-			c->addStatusChange(active);
 
-			waitlistCandidates[id] = c;
+			waitlistCandidates[id] = formWaitlistCandidate(srtrRow);
 		}
 
 		else {
 
-			waitlistCandidates[id]->addStatusChangeTime(statusTime);
-			waitlistCandidates[id]->addStatusChange(active);
+			addWaitlistStatusChange(waitlistCandidates[id], srtrRow);
 		}
 	}
 
@@ -761,191 +999,1011 @@ void KPDData::formWaitlistPopulation() {
 
 }
 
-std::deque<KPDDonor*> KPDData::getDeceasedDonors() {
+void KPDData::indexDeceasedDonorPopulation(KPDCSVFile & file) {
 
-	return std::deque<KPDDonor* >(deceasedDonors);
-}
+	kpdDataLog << "--------------------------------" << std::endl;
+	kpdDataLog << "Indexing Deceased Donors..." << std::endl;
+	kpdDataLog << "--------------------------------" << std::endl;
 
-std::deque<int> KPDData::getDeceasedDonorArrivalTimes() {
+	kpdDataLog << std::endl;
 
-	std::deque<int> arrivalTimes;
+	KPDCSVRow srtrRow;
 
-	for (std::deque<KPDDonor *>::iterator it = deceasedDonors.begin(); it != deceasedDonors.end(); it++) {
-		arrivalTimes.push_back((*it)->getRecoveryTime());
-	}
+	readHeader(file);
 
-	return arrivalTimes;
-}
+	size_t rowPosition = file.getPosition();
 
-std::vector<KPDCandidate*> KPDData::getWaitlistedCandidates() {
+	while (file.nextRow(srtrRow)) {
 
-	std::vector<KPDCandidate* > candidates;
+		int recoveryTimeSinceReference = 0;
+		const KPDField & recoveryTime = srtrRow.getField(1);
+		if (!recoveryTime.equals("NA")) {
+			recoveryTimeSinceReference = recoveryTime.toInt();
+		}
 
-	for (std::vector<int>::iterator it = waitlistCandidateIDs.begin(); it != waitlistCandidateIDs.end(); it++) {
-		candidates.push_back(waitlistCandidates[*it]);
+		deceasedDonorStream.push_back(std::pair<int, size_t>(recoveryTimeSinceReference, rowPosition));
+
+		rowPosition = file.getPosition();
 	}
 
-	return candidates;
+	// Order by recovery time (ties in file order)
+	std::sort(deceasedDonorStream.begin(), deceasedDonorStream.end());
+
+	kpdDataLog << "Deceased Donors Indexed for Streaming: " << deceasedDonorStream.size() << std::endl;
+	kpdDataLog << "Read in " << file.getRowsRead() << " rows from " << file.getFileName() << std::endl << std::endl;
 }
 
-std::vector<std::deque<KPDStatus> > KPDData::getWaitlistCandidatesStateTransitionMatrix() {
-	
-	std::vector<std::deque<KPDStatus> > waitlistCandidateTransitions;
+void KPDData::indexWaitlistPopulation(KPDCSVFile & file) {
 
-	for (std::vector<int>::iterator it = waitlistCandidateIDs.begin(); it != waitlistCandidateIDs.end(); it++) {
-		waitlistCandidateTransitions.push_back(waitlistCandidates[*it]->getStatuses());
-	}
+	kpdDataLog << "--------------------------------" << std::endl;
+	kpdDataLog << "Indexing Waitlist Candidates..." << std::endl;
+	kpdDataLog << "--------------------------------" << std::endl;
 
-	return waitlistCandidateTransitions;
-}
+	kpdDataLog << std::endl;
 
-std::vector<std::deque<int> > KPDData::getWaitlistCandidatesStateTransitionTimeMatrix() {
+	std::map<int, int> candidateIndex; // Candidate ID -> Order of first appearance
+	std::vector<std::pair<int, size_t> > candidateRows; // (Candidate, Row Position)
 
-	std::vector<std::deque<int> > waitlistCandidateTransitionTimes;
+	KPDCSVRow srtrRow;
 
-	for (std::vector<int>::iterator it = waitlistCandidateIDs.begin(); it != waitlistCandidateIDs.end(); it++) {
+	readHeader(file);
 
-		waitlistCandidateTransitionTimes.push_back(waitlistCandidates[*it]->getStatusChangeTimes());
-	}
+	size_t rowPosition = file.getPosition();
 
-	return waitlistCandidateTransitionTimes;
-}
+	while (file.nextRow(srtrRow)) {
 
-std::vector<int> KPDData::getActualTransplantedCandidates(int donorID) {
-	return actualDeceasedDonorWaitlistCandidateTransplants[donorID];
-}
+		int id = srtrRow.getField(0).toInt();
 
+		std::map<int, int>::iterator it = candidateIndex.find(id);
 
-std::pair<KPDCandidate *, int> KPDData::drawCandidate(double u) {
+		if (it == candidateIndex.end()) {
 
-	int candidateIndex = (int)(u * pairedCandidatesPool.size());
-	KPDCandidate * candidate = pairedCandidatesPool[candidateIndex]->copy();
+			int candidate = (int)candidateIndex.size();
+			it = candidateIndex.insert(std::pair<int, int>(id, candidate)).first;
 
-	int numberOfDonors = (int) pairedDonorsPool[candidate->getKPDMatchingID()].size();
+			// A candidate's first status change is the first in the file, as when all candidates are loaded
+			int statusTime = 0;
+			const KPDField & statusTimeBegin = srtrRow.getField(3);
+			if (!statusTimeBegin.equals("NA")) {
+				statusTime = statusTimeBegin.toInt();
+			}
 
-	return std::pair<KPDCandidate *, int>(candidate, numberOfDonors);
-}
+			waitlistCandidateStream.push_back(std::pair<int, int>(statusTime, candidate));
 
-KPDDonor * KPDData::drawNDD(double u) {
+			if (!srtrRow.getField(31).equals("NA")) {
+
+				int actualDonorID = srtrRow.getField(31).toInt();
+				actualDeceasedDonorWaitlistCandidateTransplants[actualDonorID].push_back(id);
+			}
+		}
+
+		candidateRows.push_back(std::pair<int, size_t>(it->second, rowPosition));
+
+		rowPosition = file.getPosition();
+	}
+
+	// Group rows by candidate (each candidate's rows stay in file order)
+	std::sort(candidateRows.begin(), candidateRows.end());
+
+	waitlistCandidateFirstRow.assign(candidateIndex.size() + 1, 0);
+
+	for (int i = 0; i < (int)candidateRows.size(); i++) {
+		waitlistCandidateRows.push_back(candidateRows[i].second);
+		waitlistCandidateFirstRow[candidateRows[i].first + 1] = i + 1;
+	}
+
+	// Order by first status change (ties in order of first appearance)
+	std::sort(waitlistCandidateStream.begin(), waitlistCandidateStream.end());
+
+	kpdDataLog << "Waitlist Candidates Indexed for Streaming: " << waitlistCandidateStream.size() << std::endl;
+	kpdDataLog << "Read in " << file.getRowsRead() << " rows from " << file.getFileName() << std::endl << std::endl;
+}
+
+bool KPDData::readDataFromCache(KPDDataCache & cache, std::string & dataLog) {
+
+	// Donor HLA Frequencies
+	int numberOfProfiles = cache.readInt();
+	for (int i = 0; i < numberOfProfiles && cache.isValid(); i++) {
+		donorHLA.push_back(KPDHLA(cache.readStrings()));
+	}
+	donorHLAFrequency = cache.readDoubles();
+
+	// HLA Dictionary
+	int numberOfAntigens = cache.readInt();
+	for (int i = 0; i < numberOfAntigens && cache.isValid(); i++) {
+		KPDAntigen antigen = KPDAntigenTable::intern(cache.readString());
+
+		if ((int)hlaDictionary.size() <= antigen) {
+			hlaDictionary.resize(antigen + 1);
+		}
+		hlaDictionary[antigen] = KPDAntigenTable::intern(cache.readStrings());
+	}
+
+	// Survival Parameters and Characteristics Frequencies
+	int numberOfParameters = cache.readInt();
+	for (int i = 0; i < numberOfParameters && cache.isValid(); i++) {
+		std::string parameter = cache.readString();
+		survivalParameters[parameter] = cache.readDoubles();
+	}
+
+	survivalModel.compile(survivalParameters);
+
+	int numberOfCharacteristics = cache.readInt();
+	for (int i = 0; i < numberOfCharacteristics && cache.isValid(); i++) {
+		std::string characteristic = cache.readString();
+		characteristicsFrequency[characteristic] = cache.readDoubles();
+	}
+
+	// KPD Population
+	int numberOfNDDs = cache.readInt();
+	for (int i = 0; i < numberOfNDDs && cache.isValid(); i++) {
+		KPDDonor * d = cache.readDonor();
+		calculateSurvivalTerms(d);
+
+		nddPool.push_back(d);
+	}
+
+	int numberOfCandidates = cache.readInt();
+	for (int i = 0; i < numberOfCandidates && cache.isValid(); i++) {
+		KPDCandidate * c = cache.readCandidate();
+		expandAntigens(c);
+		calculateSurvivalTerms(c);
+
+		candidatePool.push_back(c);
+	}
+
+	// Paired candidates are stored as positions in the candidate pool
+	std::vector<int> pairedCandidateIndices = cache.readInts();
+	for (std::vector<int>::iterator it = pairedCandidateIndices.begin(); it != pairedCandidateIndices.end() && cache.isValid(); it++) {
+		if (*it < 0 || *it >= (int)candidatePool.size()) {
+			clearData();
+			return false;
+		}
+		pairedCandidatesPool.push_back(candidatePool[*it]);
+	}
+
+	int numberOfPairs = cache.readInt();
+	for (int i = 0; i < numberOfPairs && cache.isValid(); i++) {
+		int matchingID = cache.readInt();
+		int numberOfDonors = cache.readInt();
+
+		std::vector<KPDDonor *> & associatedDonors = pairedDonorsPool[matchingID];
+		for (int k = 0; k < numberOfDonors && cache.isValid(); k++) {
+			KPDDonor * d = cache.readDonor();
+			calculateSurvivalTerms(d);
+
+			associatedDonors.push_back(d);
+		}
+	}
+
+	// Deceased Donors and Waitlist Candidates
+	int numberOfDeceasedDonors = cache.readInt();
+	for (int i = 0; i < numberOfDeceasedDonors && cache.isValid(); i++) {
+		KPDDonor * d = cache.readDonor();
+		calculateSurvivalTerms(d);
+
+		deceasedDonors.push_back(d);
+	}
+
+	int numberOfWaitlistCandidates = cache.readInt();
+	for (int i = 0; i < numberOfWaitlistCandidates && cache.isValid(); i++) {
+		KPDCandidate * c = cache.readCandidate();
+		expandAntigens(c);
+		calculateSurvivalTerms(c);
+
+		waitlistCandidateIDs.push_back(c->getCandidateID());
+		waitlistCandidates[c->getCandidateID()] = c;
+	}
+
+	int numberOfTransplantedDonors = cache.readInt();
+	for (int i = 0; i < numberOfTransplantedDonors && cache.isValid(); i++) {
+		int donorID = cache.readInt();
+		actualDeceasedDonorWaitlistCandidateTransplants[donorID] = cache.readInts();
+	}
+
+	dataLog = cache.readString();
+
+	if (!cache.isValid()) {
+		clearData();
+		return false;
+	}
+
+	return true;
+}
+
+void KPDData::writeDataToCache(KPDDataCache & cache, const std::string & dataLog) {
+
+	// Donor HLA Frequencies
+	cache.writeInt((int)donorHLA.size());
+	for (std::vector<KPDHLA>::iterator it = donorHLA.begin(); it != donorHLA.end(); it++) {
+		cache.writeStrings(it->toStrings());
+	}
+	cache.writeDoubles(donorHLAFrequency);
+
+	// HLA Dictionary
+	int numberOfAntigens = 0;
+	for (std::vector<std::vector<KPDAntigen> >::iterator it = hlaDictionary.begin(); it != hlaDictionary.end(); it++) {
+		if (!it->empty()) {
+			numberOfAntigens++;
+		}
+	}
+
+	cache.writeInt(numberOfAntigens);
+	for (int antigen = 0; antigen < (int)hlaDictionary.size(); antigen++) {
+		if (!hlaDictionary[antigen].empty()) {
+			cache.writeString(KPDAntigenTable::name((KPDAntigen)antigen));
+			cache.writeStrings(KPDAntigenTable::names(hlaDictionary[antigen]));
+		}
+	}
+
+	// Survival Parameters and Characteristics Frequencies
+	cache.writeInt((int)survivalParameters.size());
+	for (std::map<std::string, std::vector<double> >::iterator it = survivalParameters.begin(); it != survivalParameters.end(); it++) {
+		cache.writeString(it->first);
+		cache.writeDoubles(it->second);
+	}
+
+	cache.writeInt((int)characteristicsFrequency.size());
+	for (std::map<std::string, std::vector<double> >::iterator it = characteristicsFrequency.begin(); it != characteristicsFrequency.end(); it++) {
+		cache.writeString(it->first);
+		cache.writeDoubles(it->second);
+	}
+
+	// KPD Population
+	cache.writeInt((int)nddPool.size());
+	for (std::vector<KPDDonor *>::iterator it = nddPool.begin(); it != nddPool.end(); it++) {
+		cache.writeDonor(*it);
+	}
+
+	std::map<KPDCandidate *, int> candidateIndex;
+
+	cache.writeInt((int)candidatePool.size());
+	for (int i = 0; i < (int)candidatePool.size(); i++) {
+		cache.writeCandidate(candidatePool[i]);
+		candidateIndex[candidatePool[i]] = i;
+	}
+
+	std::vector<int> pairedCandidateIndices;
+	for (std::vector<KPDCandidate *>::iterator it = pairedCandidatesPool.begin(); it != pairedCandidatesPool.end(); it++) {
+		pairedCandidateIndices.push_back(candidateIndex[*it]);
+	}
+	cache.writeInts(pairedCandidateIndices);
+
+	cache.writeInt((int)pairedDonorsPool.size());
+	for (std::map<int, std::vector<KPDDonor *> >::iterator it = pairedDonorsPool.begin(); it != pairedDonorsPool.end(); it++) {
+		cache.writeInt(it->first);
+		cache.writeInt((int)it->second.size());
+		for (std::vector<KPDDonor *>::iterator donorIt = it->second.begin(); donorIt != it->second.end(); donorIt++) {
+			cache.writeDonor(*donorIt);
+		}
+	}
+
+	// Deceased Donors and Waitlist Candidates
+	cache.writeInt((int)deceasedDonors.size());
+	for (std::deque<KPDDonor *>::iterator it = deceasedDonors.begin(); it != deceasedDonors.end(); it++) {
+		cache.writeDonor(*it);
+	}
+
+	cache.writeInt((int)waitlistCandidateIDs.size());
+	for (std::vector<int>::iterator it = waitlistCandidateIDs.begin(); it != waitlistCandidateIDs.end(); it++) {
+		cache.writeCandidate(waitlistCandidates[*it]);
+	}
+
+	cache.writeInt((int)actualDeceasedDonorWaitlistCandidateTransplants.size());
+	for (std::map<int, std::vector<int> >::iterator it = actualDeceasedDonorWaitlistCandidateTransplants.begin(); it != actualDeceasedDonorWaitlistCandidateTransplants.end(); it++) {
+		cache.writeInt(it->first);
+		cache.writeInts(it->second);
+	}
+
+	cache.writeString(dataLog);
+}
+
+void KPDData::clearData() {
+
+	for (std::vector<KPDDonor *>::iterator it = nddPool.begin(); it != nddPool.end(); it++) {
+		delete *it;
+	}
+	for (std::vector<KPDCandidate *>::iterator it = candidatePool.begin(); it != candidatePool.end(); it++) {
+		delete *it;
+	}
+	for (std::map<int, std::vector<KPDDonor *> >::iterator it = pairedDonorsPool.begin(); it != pairedDonorsPool.end(); it++) {
+		for (std::vector<KPDDonor *>::iterator donorIt = it->second.begin(); donorIt != it->second.end(); donorIt++) {
+			delete *donorIt;
+		}
+	}
+	for (std::deque<KPDDonor *>::iterator it = deceasedDonors.begin(); it != deceasedDonors.end(); it++) {
+		delete *it;
+	}
+	for (std::map<int, KPDCandidate *>::iterator it = waitlistCandidates.begin(); it != waitlistCandidates.end(); it++) {
+		delete it->second;
+	}
+
+	donorHLA.clear();
+	donorHLAFrequency.clear();
+
+	hlaDictionary.clear();
+	survivalParameters.clear();
+	characteristicsFrequency.clear();
+
+	donorHLAAliasTable = KPDAliasTable();
+	characteristicsAliasTables.clear();
+
+	survivalModel = KPDSurvivalModel();
+
+	incompatibleDonorSamplers.clear();
+	incompatibleDonorSamplerIndices.clear();
+	donorBTProbability.clear();
+	donorHLAProbability.clear();
+	antigenHaplotypes.clear();
+
+	nddPool.clear();
+	candidatePool.clear();
+	pairedCandidatesPool.clear();
+	pairedDonorsPool.clear();
+
+	deceasedDonors.clear();
+
+	waitlistCandidates.clear();
+	waitlistCandidateIDs.clear();
+
+	actualDeceasedDonorWaitlistCandidateTransplants.clear();
+}
+
+std::deque<KPDDonor*> KPDData::getDeceasedDonors() {
+
+	return std::deque<KPDDonor* >(deceasedDonors);
+}
+
+std::deque<int> KPDData::getDeceasedDonorArrivalTimes() {
+
+	std::deque<int> arrivalTimes;
+
+	for (std::deque<KPDDonor *>::iterator it = deceasedDonors.begin(); it != deceasedDonors.end(); it++) {
+		arrivalTimes.push_back((*it)->getRecoveryTime());
+	}
+
+	return arrivalTimes;
+}
+
+std::vector<KPDCandidate*> KPDData::getWaitlistedCandidates() {
+
+	std::vector<KPDCandidate* > candidates;
+
+	for (std::vector<int>::iterator it = waitlistCandidateIDs.begin(); it != waitlistCandidateIDs.end(); it++) {
+		candidates.push_back(waitlistCandidates[*it]);
+	}
+
+	return candidates;
+}
+
+std::vector<std::deque<KPDStatus> > KPDData::getWaitlistCandidatesStateTransitionMatrix() {
+	
+	std::vector<std::deque<KPDStatus> > waitlistCandidateTransitions;
+
+	for (std::vector<int>::iterator it = waitlistCandidateIDs.begin(); it != waitlistCandidateIDs.end(); it++) {
+		waitlistCandidateTransitions.push_back(waitlistCandidates[*it]->getStatuses());
+	}
+
+	return waitlistCandidateTransitions;
+}
+
+std::vector<std::deque<int> > KPDData::getWaitlistCandidatesStateTransitionTimeMatrix() {
+
+	std::vector<std::deque<int> > waitlistCandidateTransitionTimes;
+
+	for (std::vector<int>::iterator it = waitlistCandidateIDs.begin(); it != waitlistCandidateIDs.end(); it++) {
+
+		waitlistCandidateTransitionTimes.push_back(waitlistCandidates[*it]->getStatusChangeTimes());
+	}
+
+	return waitlistCandidateTransitionTimes;
+}
+
+std::vector<int> KPDData::getActualTransplantedCandidates(int donorID) {
+	return actualDeceasedDonorWaitlistCandidateTransplants[donorID];
+}
+
+
+bool KPDData::getStreamDeceasedDonorsAndWaitlist() {
+
+	return streamDeceasedDonorsAndWaitlist;
+}
+
+void KPDData::restartStreams() {
+
+	deceasedDonorStreamPosition = 0;
+	waitlistCandidateStreamPosition = 0;
+}
+
+KPDDonor * KPDData::nextDeceasedDonor(int time) {
+
+	if (deceasedDonorStreamPosition >= (int)deceasedDonorStream.size() || deceasedDonorStream[deceasedDonorStreamPosition].first > time) {
+		return NULL;
+	}
+
+	KPDCSVRow srtrRow;
+
+	deceasedDonorFile->setPosition(deceasedDonorStream[deceasedDonorStreamPosition].second);
+	deceasedDonorFile->nextRow(srtrRow);
+
+	deceasedDonorStreamPosition++;
+
+	return formDeceasedDonor(srtrRow);
+}
+
+KPDCandidate * KPDData::nextWaitlistedCandidate(int time, int & position) {
+
+	if (waitlistCandidateStreamPosition >= (int)waitlistCandidateStream.size() || waitlistCandidateStream[waitlistCandidateStreamPosition].first > time) {
+		return NULL;
+	}
+
+	int candidate = waitlistCandidateStream[waitlistCandidateStreamPosition].second;
+
+	KPDCSVRow srtrRow;
+	KPDCandidate * c = NULL;
+
+	for (int row = waitlistCandidateFirstRow[candidate]; row < waitlistCandidateFirstRow[candidate + 1]; row++) {
+
+		waitlistCandidatesFile->setPosition(waitlistCandidateRows[row]);
+		waitlistCandidatesFile->nextRow(srtrRow);
+
+		if (c == NULL) {
+			c = formWaitlistCandidate(srtrRow);
+		}
+		else {
+			addWaitlistStatusChange(c, srtrRow);
+		}
+	}
+
+	waitlistCandidateStreamPosition++;
+
+	position = candidate;
+
+	return c;
+}
+
+std::pair<KPDCandidate *, int> KPDData::drawCandidate(double u) {
+
+	int candidateIndex = (int)(u * pairedCandidatesPool.size());
+	KPDCandidate * candidate = pairedCandidatesPool[candidateIndex];
+
+	int numberOfDonors = (int) pairedDonorsPool[candidate->getKPDMatchingID()].size();
+
+	return std::pair<KPDCandidate *, int>(candidate, numberOfDonors);
+}
+
+KPDDonor * KPDData::drawNDD(double u) {
 
 	int nddIndex = (int)(u * nddPool.size());
-	KPDDonor * donor = nddPool[nddIndex]->copy();
+	KPDDonor * donor = nddPool[nddIndex];
+
+	return donor;
+}
+
+void KPDData::formAliasTables() {
+
+	donorHLAAliasTable.setProbabilities(donorHLAFrequency);
+
+	// Donor HLA BW holds the probabilities of two independent antigens, so is not a distribution to draw from
+	characteristicsAliasTables.clear();
+
+	for (std::map<std::string, std::vector<double> >::iterator it = characteristicsFrequency.begin(); it != characteristicsFrequency.end(); it++) {
+		if (it->first.compare("Donor HLA BW") != 0) {
+			characteristicsAliasTables[it->first].setProbabilities(it->second);
+		}
+	}
+}
+
+int KPDData::getAntigenClass(const std::vector<char> & antigenClasses, KPDAntigen antigen) {
+
+	if (antigen >= antigenClasses.size()) {
+		return ANTIGEN_CLASS_NONE;
+	}
+
+	return antigenClasses[antigen];
+}
+
+int KPDData::indexOfIncompatibleDonorSampler(KPDCandidate * candidate) {
+
+	std::vector<KPDAntigen> unacceptableHLA = candidate->getUnacceptableHLA();
+	std::vector<KPDAntigen> desensitizableHLA = candidate->getDesensitizableHLA();
+
+	std::sort(unacceptableHLA.begin(), unacceptableHLA.end());
+	std::sort(desensitizableHLA.begin(), desensitizableHLA.end());
+
+	std::pair<std::vector<KPDAntigen>, std::vector<KPDAntigen> > antigenLists(unacceptableHLA, desensitizableHLA);
+
+	std::map<std::pair<std::vector<KPDAntigen>, std::vector<KPDAntigen> >, int>::iterator it = incompatibleDonorSamplerIndices.find(antigenLists);
+
+	if (it != incompatibleDonorSamplerIndices.end()) {
+		return it->second;
+	}
+
+	//Class of each antigen (through the HLA dictionary, as in a crossmatch)
+	std::vector<char> antigenClasses(KPDAntigenTable::size(), ANTIGEN_CLASS_NONE);
+
+	for (std::vector<KPDAntigen>::iterator cHLA = desensitizableHLA.begin(); cHLA != desensitizableHLA.end(); cHLA++) {
+		if (*cHLA < hlaDictionary.size()) {
+			for (std::vector<KPDAntigen>::iterator antigen = hlaDictionary[*cHLA].begin(); antigen != hlaDictionary[*cHLA].end(); antigen++) {
+				if (*antigen < antigenClasses.size()) {
+					antigenClasses[*antigen] = ANTIGEN_CLASS_DESENSITIZABLE;
+				}
+			}
+		}
+	}
+
+	for (std::vector<KPDAntigen>::iterator cHLA = unacceptableHLA.begin(); cHLA != unacceptableHLA.end(); cHLA++) {
+		if (*cHLA < hlaDictionary.size()) {
+			for (std::vector<KPDAntigen>::iterator antigen = hlaDictionary[*cHLA].begin(); antigen != hlaDictionary[*cHLA].end(); antigen++) {
+				if (*antigen < antigenClasses.size()) {
+					antigenClasses[*antigen] = ANTIGEN_CLASS_UNACCEPTABLE;
+				}
+			}
+		}
+	}
+
+	KPDIncompatibleDonorSampler sampler;
+
+	//Haplotypes with an antigen in a class
+	std::map<int, int> haplotypeClasses;
+
+	for (int antigen = 0; antigen < (int)antigenClasses.size() && antigen < (int)antigenHaplotypes.size(); antigen++) {
+		if (antigenClasses[antigen] != ANTIGEN_CLASS_NONE) {
+			for (std::vector<int>::iterator it = antigenHaplotypes[antigen].begin(); it != antigenHaplotypes[antigen].end(); it++) {
+				haplotypeClasses[*it] = std::max(haplotypeClasses[*it], (int)antigenClasses[antigen]);
+			}
+		}
+	}
+
+	std::vector<double> probabilities[ANTIGEN_CLASSES];
+	double classProbability[ANTIGEN_CLASSES] = { 0.0, 0.0, 0.0 };
+
+	for (std::map<int, int>::iterator it = haplotypeClasses.begin(); it != haplotypeClasses.end(); it++) {
+
+		sampler.haplotypes[it->second].push_back(it->first);
+		probabilities[it->second].push_back(donorHLAProbability[it->first]);
+
+		classProbability[it->second] += donorHLAProbability[it->first];
+	}
+
+	classProbability[ANTIGEN_CLASS_NONE] = std::max(0.0, 1 - classProbability[ANTIGEN_CLASS_DESENSITIZABLE] - classProbability[ANTIGEN_CLASS_UNACCEPTABLE]);
+
+	for (int k = 0; k < ANTIGEN_CLASSES; k++) {
+
+		if (k != ANTIGEN_CLASS_NONE && classProbability[k] > 0) {
+			for (std::vector<double>::iterator it = probabilities[k].begin(); it != probabilities[k].end(); it++) {
+				*it /= classProbability[k];
+			}
+			sampler.haplotypeAliasTables[k].setProbabilities(probabilities[k]);
+		}
+
+		sampler.componentProbability[0][k] = classProbability[k];
+		sampler.componentProbability[1][k] = classProbability[k];
+	}
+
+	//BW4 and BW6
+	sampler.bwClass[0] = getAntigenClass(antigenClasses, antigenBW4);
+	sampler.bwClass[1] = getAntigenClass(antigenClasses, antigenBW6);
+
+	for (int b = 0; b < 2; b++) {
+
+		double frequency = std::min(1.0, std::max(0.0, characteristicsFrequency["Donor HLA BW"][b]));
+
+		for (int k = 0; k < ANTIGEN_CLASSES; k++) {
+			sampler.componentProbability[2 + b][k] = 0.0;
+		}
+
+		sampler.componentProbability[2 + b][ANTIGEN_CLASS_NONE] += 1 - frequency;
+		sampler.componentProbability[2 + b][sampler.bwClass[b]] += frequency;
+	}
+
+	int index = (int)incompatibleDonorSamplers.size();
+
+	incompatibleDonorSamplers.push_back(sampler);
+	incompatibleDonorSamplerIndices[antigenLists] = index;
+
+	return index;
+}
+
+void KPDData::formIncompatibleDonorSamplers() {
+
+	incompatibleDonorSamplers.clear();
+	incompatibleDonorSamplerIndices.clear();
+
+	donorBTProbability = KPDAliasTable::impliedProbabilities(characteristicsFrequency["Blood Type"]);
+	donorBTProbability.resize(4, 0.0);
+
+	//Haplotypes (with the probabilities they are drawn with in generateDonor), by antigen
+	donorHLAProbability = KPDAliasTable::impliedProbabilities(donorHLAFrequency);
+
+	antigenHaplotypes.assign(KPDAntigenTable::size(), std::vector<int>());
+
+	for (int i = 0; i < (int)donorHLA.size(); i++) {
+		for (const KPDAntigen * antigen = donorHLA[i].begin(); antigen != donorHLA[i].end(); antigen++) {
+			if (antigenHaplotypes[*antigen].empty() || antigenHaplotypes[*antigen].back() != i) {
+				antigenHaplotypes[*antigen].push_back(i);
+			}
+		}
+	}
+
+	for (std::vector<KPDCandidate *>::iterator it = pairedCandidatesPool.begin(); it != pairedCandidatesPool.end(); it++) {
+		indexOfIncompatibleDonorSampler(*it);
+	}
+
+	kpdDataLog << "Incompatible Donor Samplers: " << incompatibleDonorSamplers.size() << " (for " << pairedCandidatesPool.size() << " Candidates)" << std::endl << std::endl;
+}
+
+KPDDonor * KPDData::formGeneratedDonor(int btIndex, int hlaIndex1, int hlaIndex2, bool bw4, bool bw6) {
+
+	// Blood Type
+	KPDBloodType dBT = BT_O;
+	if (btIndex == 1) {
+		dBT = BT_A;
+	}
+	else if (btIndex == 2) {
+		dBT = BT_B;
+	}
+	else if (btIndex == 3) {
+		dBT = BT_AB;
+	}
+
+	// HLA
+	KPDHLA dHLA;
+
+	for (const KPDAntigen * it = donorHLA[hlaIndex1].begin(); it != donorHLA[hlaIndex1].end(); it++) {
+		dHLA.add(*it);
+	}
+
+	for (const KPDAntigen * it = donorHLA[hlaIndex2].begin(); it != donorHLA[hlaIndex2].end(); it++) {
+		dHLA.add(*it);
+	}
+
+	if (bw4) {
+		dHLA.add(antigenBW4);
+	}
+	if (bw6) {
+		dHLA.add(antigenBW6);
+	}
+
+	KPDDonor * donor = new KPDDonor();
+	donor->setBT(dBT);
+	donor->setHLA(dHLA);
+	calculateSurvivalTerms(donor);
 
 	return donor;
 }
 
-KPDDonor * KPDData::generateDonor(std::vector<double> u) {
+KPDDonor * KPDData::generateDonor(const std::vector<double> & u) {
 
-	// Blood Type
-	int btIndex = KPDFunctions::retrieveDiscreteSampleIndex(u[0], characteristicsFrequency["Blood Type"]);
+	int btIndex = characteristicsAliasTables["Blood Type"].sample(u[0]);
 
-	KPDBloodType dBT = BT_O;
-	if (btIndex == 1) {
-		dBT = BT_A;
+	int hlaIndex1 = donorHLAAliasTable.sample(u[1]);
+	int hlaIndex2 = donorHLAAliasTable.sample(u[2]);
+
+	bool bw4 = u[3] <= characteristicsFrequency["Donor HLA BW"][0];
+	bool bw6 = u[4] <= characteristicsFrequency["Donor HLA BW"][1];
+
+	return formGeneratedDonor(btIndex, hlaIndex1, hlaIndex2, bw4, bw6);
+}
+
+KPDDonor * KPDData::generateIncompatibleDonor(int samplerIndex, KPDCandidate * candidate, const std::vector<double> & u, RNG & rng) {
+
+	const KPDIncompatibleDonorSampler & sampler = incompatibleDonorSamplers[samplerIndex];
+
+	double hlaClassProbability[ANTIGEN_CLASSES];
+	sampler.getClassProbabilities(hlaClassProbability);
+
+	//Probability of each combination of blood type and HLA class that fails the crossmatch
+	const KPDBloodType bloodTypes[4] = { BT_O, BT_A, BT_B, BT_AB };
+
+	double probability[4][ANTIGEN_CLASSES];
+	double totalProbability = 0.0;
+
+	for (int b = 0; b < 4; b++) {
+
+		KPDCrossmatch bloodTypeCrossmatch = KPDFunctions::bloodTypeCrossmatch(bloodTypes[b], candidate->getBT());
+
+		for (int k = 0; k < ANTIGEN_CLASSES; k++) {
+
+			KPDCrossmatch crossmatch = bloodTypeCrossmatch;
+
+			if (bloodTypeCrossmatch != CROSSMATCH_FAILED) {
+				if (k == ANTIGEN_CLASS_UNACCEPTABLE) {
+					crossmatch = CROSSMATCH_FAILED;
+				}
+				else if (k == ANTIGEN_CLASS_DESENSITIZABLE) {
+					crossmatch = (bloodTypeCrossmatch == CROSSMATCH_O_DONOR_TO_NON_O_CANDIDATE) ? CROSSMATCH_REQUIRES_DESENSITIZATION_AND_O_TO_NON_O : CROSSMATCH_REQUIRES_DESENSITIZATION;
+				}
+			}
+
+			probability[b][k] = allowableMatch(crossmatch) ? 0.0 : donorBTProbability[b] * hlaClassProbability[k];
+			totalProbability += probability[b][k];
+		}
 	}
-	else if (btIndex == 2) {
-		dBT = BT_B;
+
+	if (totalProbability <= 0) {
+		return NULL;
 	}
-	else if (btIndex == 3) {
-		dBT = BT_AB;
+
+	//Blood type and HLA class
+	int btIndex = -1;
+	int hlaClass = -1;
+
+	double x = u[0] * totalProbability;
+	bool found = false;
+
+	for (int b = 0; b < 4 && !found; b++) {
+		for (int k = 0; k < ANTIGEN_CLASSES; k++) {
+			if (probability[b][k] > 0) {
+
+				btIndex = b;
+				hlaClass = k; // The last possible combination is kept if rounding leaves x past the end
+
+				if (x < probability[b][k]) {
+					found = true;
+					break;
+				}
+
+				x -= probability[b][k];
+			}
+		}
 	}
 
-	// HLA
-	std::vector<std::string> dHLA;
+	//HLA components in that class
+	int componentClass[DONOR_HLA_COMPONENTS];
+	sampler.sampleComponentClasses(hlaClass, &u[1], componentClass);
+
+	int hlaIndex[2];
+
+	for (int h = 0; h < 2; h++) {
+
+		int haplotypeClass = componentClass[h];
 
-	int hlaIndex1 = KPDFunctions::retrieveDiscreteSampleIndex(u[1], donorHLAFrequency);
+		if (haplotypeClass == ANTIGEN_CLASS_NONE) {
 
-	for (std::vector<std::string>::iterator it = donorHLA[hlaIndex1].begin(); it != donorHLA[hlaIndex1].end(); it++) {
-		dHLA.push_back(*it);
+			// Haplotypes in no class are most haplotypes, so few are redrawn
+			hlaIndex[h] = donorHLAAliasTable.sample(u[5 + h]);
+
+			while (sampler.getHaplotypeClass(hlaIndex[h]) != ANTIGEN_CLASS_NONE) {
+				hlaIndex[h] = donorHLAAliasTable.sample(rng.runif());
+			}
+		}
+		else {
+			hlaIndex[h] = sampler.haplotypes[haplotypeClass][sampler.haplotypeAliasTables[haplotypeClass].sample(u[5 + h])];
+		}
 	}
 
-	int hlaIndex2 = KPDFunctions::retrieveDiscreteSampleIndex(u[2], donorHLAFrequency);
+	int hlaIndex1 = hlaIndex[0];
+	int hlaIndex2 = hlaIndex[1];
+
+	// A BW antigen outside of any class may or may not be present
+	bool bw4 = componentClass[2] != ANTIGEN_CLASS_NONE || (sampler.bwClass[0] == ANTIGEN_CLASS_NONE && u[7] <= characteristicsFrequency["Donor HLA BW"][0]);
+	bool bw6 = componentClass[3] != ANTIGEN_CLASS_NONE || (sampler.bwClass[1] == ANTIGEN_CLASS_NONE && u[8] <= characteristicsFrequency["Donor HLA BW"][1]);
+
+	return formGeneratedDonor(btIndex, hlaIndex1, hlaIndex2, bw4, bw6);
+}
+
+bool KPDData::hasUnacceptableAntigen(KPDAntigen antigen, const KPDHLA & donorHLA) {
 
-	for (std::vector<std::string>::iterator it = donorHLA[hlaIndex2].begin(); it != donorHLA[hlaIndex2].end(); it++) {
-		dHLA.push_back(*it);
+	if (antigen >= hlaDictionary.size()) {
+		return false;
 	}
 
-	if (u[3] <= characteristicsFrequency["Donor HLA BW"][0]) {
-		dHLA.push_back("BW4");
+	for (std::vector<KPDAntigen>::iterator unacceptableAntigen = hlaDictionary[antigen].begin(); unacceptableAntigen != hlaDictionary[antigen].end(); unacceptableAntigen++) {
+		if (donorHLA.contains(*unacceptableAntigen)) {
+			return true;
+		}
 	}
-	if (u[4] <= characteristicsFrequency["Donor HLA BW"][1]) {
-		dHLA.push_back("BW6");
+
+	return false;
+}
+
+void KPDData::expandAntigens(KPDCandidate * candidate) {
+
+	KPDAntigenSet unacceptable;
+	KPDAntigenSet desensitizable;
+	KPDAntigenSet waitlistUnacceptable;
+
+	const std::vector<KPDAntigen> & unacceptableHLA = candidate->getUnacceptableHLA();
+	const std::vector<KPDAntigen> & desensitizableHLA = candidate->getDesensitizableHLA();
+	const KPDHLA & hla = candidate->getHLA();
+
+	for (std::vector<KPDAntigen>::const_iterator it = unacceptableHLA.begin(); it != unacceptableHLA.end(); it++) {
+		if (*it < hlaDictionary.size()) {
+			for (std::vector<KPDAntigen>::iterator antigen = hlaDictionary[*it].begin(); antigen != hlaDictionary[*it].end(); antigen++) {
+				unacceptable.add(*antigen);
+			}
+		}
 	}
 
-	KPDDonor * donor = new KPDDonor();
-	donor->setBT(dBT);
-	donor->setHLA(dHLA);
+	for (std::vector<KPDAntigen>::const_iterator it = desensitizableHLA.begin(); it != desensitizableHLA.end(); it++) {
+		if (*it < hlaDictionary.size()) {
+			for (std::vector<KPDAntigen>::iterator antigen = hlaDictionary[*it].begin(); antigen != hlaDictionary[*it].end(); antigen++) {
+				desensitizable.add(*antigen);
+			}
+		}
+	}
 
-	return donor;
+	for (const KPDAntigen * it = hla.begin(); it != hla.end(); it++) {
+		if (*it < hlaDictionary.size()) {
+			for (std::vector<KPDAntigen>::iterator antigen = hlaDictionary[*it].begin(); antigen != hlaDictionary[*it].end(); antigen++) {
+				waitlistUnacceptable.add(*antigen);
+			}
+		}
+	}
 
+	candidate->setExpandedAntigens(unacceptable, desensitizable, waitlistUnacceptable);
 }
 
 //Checks for Match Between Candidate and Donor
 KPDCrossmatch KPDData::performCrossmatch(KPDCandidate * candidate, KPDDonor * donor, bool waitlist) {
 
 	//Check BT match
-	if ((donor->getBT() == BT_AB && candidate->getBT() != BT_AB) ||
-		(donor->getBT() == BT_A && (candidate->getBT() == BT_O || candidate->getBT() == BT_B)) ||
-		(donor->getBT() == BT_B && (candidate->getBT() == BT_O || candidate->getBT() == BT_A))) {
+	KPDCrossmatch bloodTypeCrossmatch = KPDFunctions::bloodTypeCrossmatch(donor->getBT(), candidate->getBT());
 
+	if (bloodTypeCrossmatch == CROSSMATCH_FAILED) {
 		return CROSSMATCH_FAILED;
 	}
 
-	bool oDonorToNonOCandidate = donor->getBT() == BT_O && candidate->getBT() != BT_O;
+	return performCrossmatchByAntigens(candidate, donor, waitlist, bloodTypeCrossmatch);
+}
+
+void KPDData::performCrossmatchBatch(KPDDonor * donor, const std::vector<KPDCandidate *> & candidates, bool waitlist, std::vector<KPDCrossmatch> & results) {
+
+	int n = (int)candidates.size();
+
+	results.resize(n);
+
+	//Blood types first (a table lookup per candidate), then antigens only for candidates that pass
+	KPDBloodType donorBT = donor->getBT();
+
+	for (int i = 0; i < n; i++) {
+		results[i] = KPDFunctions::bloodTypeCrossmatch(donorBT, candidates[i]->getBT());
+	}
+
+	for (int i = 0; i < n; i++) {
+		if (results[i] != CROSSMATCH_FAILED) {
+			results[i] = performCrossmatchByAntigens(candidates[i], donor, waitlist, results[i]);
+		}
+	}
+}
+
+void KPDData::performCrossmatchBatch(KPDDonor * donor, const KPDCrossmatchPanel & panel, std::vector<KPDCrossmatch> & results) {
+
+	int n = panel.size();
+
+	results.resize(n);
+
+	KPDBloodType donorBT = donor->getBT();
+
+	for (int i = 0; i < n; i++) {
+		results[i] = KPDFunctions::bloodTypeCrossmatch(donorBT, panel.bloodTypes[i]);
+	}
+
+	//Antigen tests only for candidates that pass; a bitset test is exact as long as one of the two sets holds all of its antigens
+	const KPDAntigenSet & donorAntigens = donor->getAntigens();
+
+	bool bitsetsExact = panel.allAntigensExact || donorAntigens.isExact();
+
+	for (int i = 0; i < n; i++) {
+
+		if (results[i] == CROSSMATCH_FAILED) {
+			continue;
+		}
+
+		if (!panel.antigensExpanded[i] || (!bitsetsExact && !panel.antigensExact[i])) {
+			results[i] = performCrossmatchByAntigenLists(panel.candidates[i], donor, panel.waitlist, results[i]);
+		}
+		else if (panel.unacceptableAntigens[i].intersects(donorAntigens)) {
+			results[i] = CROSSMATCH_FAILED;
+		}
+		else if (panel.desensitizableAntigens[i].intersects(donorAntigens)) {
+			results[i] = (results[i] == CROSSMATCH_O_DONOR_TO_NON_O_CANDIDATE) ? CROSSMATCH_REQUIRES_DESENSITIZATION_AND_O_TO_NON_O : CROSSMATCH_REQUIRES_DESENSITIZATION;
+		}
+	}
+}
+
+void KPDData::performCrossmatchBatch(KPDCandidate * candidate, const std::vector<KPDDonor *> & donors, bool waitlist, std::vector<KPDCrossmatch> & results) {
+
+	int n = (int)donors.size();
+
+	results.resize(n);
+
+	KPDBloodType candidateBT = candidate->getBT();
+
+	for (int i = 0; i < n; i++) {
+		results[i] = KPDFunctions::bloodTypeCrossmatch(donors[i]->getBT(), candidateBT);
+	}
+
+	for (int i = 0; i < n; i++) {
+		if (results[i] != CROSSMATCH_FAILED) {
+			results[i] = performCrossmatchByAntigens(candidate, donors[i], waitlist, results[i]);
+		}
+	}
+}
+
+KPDCrossmatch KPDData::performCrossmatchByAntigens(KPDCandidate * candidate, KPDDonor * donor, bool waitlist, KPDCrossmatch bloodTypeCrossmatch) {
+
+	//Check HLA (a bitset test is exact as long as one of the two sets holds all of its antigens)
+	const KPDAntigenSet & donorAntigens = donor->getAntigens();
+
+	if (!candidate->getAntigensExpanded()) {
+		return performCrossmatchByAntigenLists(candidate, donor, waitlist, bloodTypeCrossmatch);
+	}
+
+	if (waitlist) {
+
+		const KPDAntigenSet & unacceptable = candidate->getWaitlistUnacceptableAntigens();
+
+		if (!unacceptable.isExact() && !donorAntigens.isExact()) {
+			return performCrossmatchByAntigenLists(candidate, donor, waitlist, bloodTypeCrossmatch);
+		}
+
+		if (unacceptable.intersects(donorAntigens)) {
+			return CROSSMATCH_FAILED;
+		}
+	}
+
+	else {
+		const KPDAntigenSet & unacceptable = candidate->getUnacceptableAntigens();
+		const KPDAntigenSet & desensitizable = candidate->getDesensitizableAntigens();
+
+		if (!donorAntigens.isExact() && (!unacceptable.isExact() || !desensitizable.isExact())) {
+			return performCrossmatchByAntigenLists(candidate, donor, waitlist, bloodTypeCrossmatch);
+		}
+
+		if (unacceptable.intersects(donorAntigens)) {
+			return CROSSMATCH_FAILED;
+		}
+
+		if (desensitizable.intersects(donorAntigens)) {
+			if (bloodTypeCrossmatch == CROSSMATCH_O_DONOR_TO_NON_O_CANDIDATE) {
+				return CROSSMATCH_REQUIRES_DESENSITIZATION_AND_O_TO_NON_O;
+			}
+			else {
+				return CROSSMATCH_REQUIRES_DESENSITIZATION;
+			}
+		}
+	}
+
+	return bloodTypeCrossmatch;
+}
+
+KPDCrossmatch KPDData::performCrossmatchByAntigenLists(KPDCandidate * candidate, KPDDonor * donor, bool waitlist, KPDCrossmatch bloodTypeCrossmatch) {
+
+	bool oDonorToNonOCandidate = bloodTypeCrossmatch == CROSSMATCH_O_DONOR_TO_NON_O_CANDIDATE;
 
 	//Check HLA
-	std::vector<std::string> candidateHLA = candidate->getHLA();
-	std::vector<std::string> candidateUnacceptableHLA = candidate->getUnacceptableHLA();
-	std::vector<std::string> candidateDesensitizableHLA = candidate->getDesensitizableHLA();
-	std::vector<std::string> donorHLA = donor->getHLA();
+	const KPDHLA & donorHLA = donor->getHLA();
 
 	if (waitlist) {
 
-		for (std::vector<std::string>::iterator cHLA = candidateHLA.begin(); cHLA != candidateHLA.end(); cHLA++) {
-			std::map<std::string, std::vector<std::string> >::iterator unacceptableAntigens = hlaDictionary.find(*cHLA);
+		const KPDHLA & candidateHLA = candidate->getHLA();
 
-			if (unacceptableAntigens != hlaDictionary.end()) {
-				for (std::vector<std::string>::iterator antigen = unacceptableAntigens->second.begin(); antigen != unacceptableAntigens->second.end(); antigen++) {
-					for (std::vector<std::string>::iterator dHLA = donorHLA.begin(); dHLA != donorHLA.end(); dHLA++) {
-						if ((*dHLA).compare(*antigen) == 0) {
-							return CROSSMATCH_FAILED;
-						}
-					}
-				}
+		for (const KPDAntigen * cHLA = candidateHLA.begin(); cHLA != candidateHLA.end(); cHLA++) {
+			if (hasUnacceptableAntigen(*cHLA, donorHLA)) {
+				return CROSSMATCH_FAILED;
 			}
 		}
 	}
 
 	else {
-		for (std::vector<std::string>::iterator cHLA = candidateUnacceptableHLA.begin(); cHLA != candidateUnacceptableHLA.end(); cHLA++) {
-			std::map<std::string, std::vector<std::string > >::iterator unacceptableAntigens = hlaDictionary.find(*cHLA);
-
-			if (unacceptableAntigens != hlaDictionary.end()) {
-				for (std::vector<std::string>::iterator antigen = unacceptableAntigens->second.begin(); antigen != unacceptableAntigens->second.end(); antigen++) {
-					for (std::vector<std::string>::iterator dHLA = donorHLA.begin(); dHLA != donorHLA.end(); dHLA++) {
-						if ((*dHLA).compare(*antigen) == 0) {
-							return CROSSMATCH_FAILED;
-						}
-					}
-				}
+		const std::vector<KPDAntigen> & candidateUnacceptableHLA = candidate->getUnacceptableHLA();
+		const std::vector<KPDAntigen> & candidateDesensitizableHLA = candidate->getDesensitizableHLA();
+
+		for (std::vector<KPDAntigen>::const_iterator cHLA = candidateUnacceptableHLA.begin(); cHLA != candidateUnacceptableHLA.end(); cHLA++) {
+			if (hasUnacceptableAntigen(*cHLA, donorHLA)) {
+				return CROSSMATCH_FAILED;
 			}
 		}
 
-		for (std::vector<std::string>::iterator cHLA = candidateDesensitizableHLA.begin(); cHLA != candidateDesensitizableHLA.end(); cHLA++) {
-			std::map<std::string, std::vector<std::string > >::iterator unacceptableAntigens = hlaDictionary.find(*cHLA);
-
-			if (unacceptableAntigens != hlaDictionary.end()) {
-				for (std::vector<std::string>::iterator antigen = unacceptableAntigens->second.begin(); antigen != unacceptableAntigens->second.end(); antigen++) {
-					for (std::vector<std::string>::iterator dHLA = donorHLA.begin(); dHLA != donorHLA.end(); dHLA++) {
-						if ((*dHLA).compare(*antigen) == 0) {
-							if (oDonorToNonOCandidate) {
-								return CROSSMATCH_REQUIRES_DESENSITIZATION_AND_O_TO_NON_O;
-							}
-							else {
-								return CROSSMATCH_REQUIRES_DESENSITIZATION;
-							}
-						}
-					}
+		for (std::vector<KPDAntigen>::const_iterator cHLA = candidateDesensitizableHLA.begin(); cHLA != candidateDesensitizableHLA.end(); cHLA++) {
+			if (hasUnacceptableAntigen(*cHLA, donorHLA)) {
+				if (oDonorToNonOCandidate) {
+					return CROSSMATCH_REQUIRES_DESENSITIZATION_AND_O_TO_NON_O;
+				}
+				else {
+					return CROSSMATCH_REQUIRES_DESENSITIZATION;
 				}
 			}
 		}
@@ -985,264 +2043,232 @@ bool KPDData::allowableMatch(KPDCrossmatch crossmatch) {
 	return false;
 }
 
+void KPDData::calculateSurvivalTerms(KPDCandidate * candidate) {
+
+	double terms[SURVIVAL_HORIZONS];
+
+	survivalModel.calculateCandidateTerms(candidate, terms);
+	candidate->setSurvivalTerms(terms);
+}
+
+void KPDData::calculateSurvivalTerms(KPDDonor * donor) {
+
+	double terms[SURVIVAL_HORIZONS];
+
+	survivalModel.calculateDonorTerms(donor, terms);
+	donor->setSurvivalTerms(terms);
+}
+
 //Calculates Survival (fiveyear == 1 => 5 year survival; fiveyear == 0 => 10 year survival)
 double KPDData::calculateSurvival(KPDCandidate * candidate, KPDDonor * donor, int fiveyear) {
-	double survival = 0.0;
 
-	//Age
-	std::vector<double> cAge5yr = survivalParameters["5 Year Recipient Age"];
-	std::vector<double> cAge10yr = survivalParameters["10 Year Recipient Age"];
+	double fiveYearSurvival;
+	double tenYearSurvival;
 
-	std::vector<double> dAge5yr;
-	std::vector<double> dAge10yr;
+	calculateSurvival(candidate, donor, fiveYearSurvival, tenYearSurvival);
 
-	std::vector<int> donorAgeChangePoints;
-	donorAgeChangePoints.push_back(30);
-	donorAgeChangePoints.push_back(10);
-	donorAgeChangePoints.push_back(10);
-	donorAgeChangePoints.push_back(10);
-	donorAgeChangePoints.push_back(10);
+	if (fiveyear == 1) {
+		return fiveYearSurvival;
+	}
 
-	int changePoint = 0;
+	return tenYearSurvival;
+}
 
-	int donorsAge = donor->getAge();
+//Calculates 5 and 10 Year Survival in One Pass
+void KPDData::calculateSurvival(KPDCandidate * candidate, KPDDonor * donor, double & fiveYearSurvival, double & tenYearSurvival) {
 
-	if (candidate->getAge() < 13) {
+	double survival[SURVIVAL_HORIZONS];
 
-		dAge5yr = survivalParameters["5 Year Among Recipients Age < 12"];
-		dAge10yr = survivalParameters["10 Year Among Recipients Age < 12"];
+	survivalModel.calculateSurvival(candidate, donor, survival);
 
-		survival += fiveyear*(cAge5yr[0]) + (1 - fiveyear)*(cAge10yr[0]);
-	}
-	else if (candidate->getAge() >= 13 && candidate->getAge() <= 17) {
+	fiveYearSurvival = survival[SURVIVAL_5_YEAR];
+	tenYearSurvival = survival[SURVIVAL_10_YEAR];
+}
 
-		dAge5yr = survivalParameters["5 Year Among Recipients 13-17"];
-		dAge10yr = survivalParameters["10 Year Among Recipients 13-17"];
+void KPDData::calculateSurvivalBatch(const std::vector<KPDCandidate *> & candidates, const std::vector<KPDDonor *> & donors, std::vector<double> & fiveYearSurvival, std::vector<double> & tenYearSurvival) {
 
-		survival += fiveyear*(cAge5yr[1]) + (1 - fiveyear)*(cAge10yr[1]);
-	}
-	else if (candidate->getAge() >= 18 && candidate->getAge() <= 29) {
+	survivalModel.calculateSurvivalBatch(candidates, donors, fiveYearSurvival, tenYearSurvival);
+}
 
-		dAge5yr = survivalParameters["5 Year Among Recipients 18-29"];
-		dAge10yr = survivalParameters["10 Year Among Recipients 18-29"];
+void KPDData::calculateSurvivalBatch(KPDCandidate * candidate, const std::vector<KPDDonor *> & donors, std::vector<double> & fiveYearSurvival, std::vector<double> & tenYearSurvival) {
 
-		survival += fiveyear*(cAge5yr[2]) + (1 - fiveyear)*(cAge10yr[2]);
-	}
-	else if (candidate->getAge() >= 30 && candidate->getAge() <= 39) {
+	survivalModel.calculateSurvivalBatch(candidate, donors, fiveYearSurvival, tenYearSurvival);
+}
 
-		dAge5yr = survivalParameters["5 Year Among Recipients 30-39"];
-		dAge10yr = survivalParameters["10 Year Among Recipients 30-39"];
+void KPDData::printLog() {
 
-		survival += fiveyear*(cAge5yr[3]) + (1 - fiveyear)*(cAge10yr[3]);
-	}
-	else if (candidate->getAge() >= 40 && candidate->getAge() <= 49) {
+	std::string logFile = "output/" + kpdParameters->getOutputFolder() + "/" + kpdParameters->getSubFolder() + "/Log-Data.txt";
+	std::ofstream outputFileLog(logFile.c_str());
+	outputFileLog << kpdDataLog.str();
+	outputFileLog.close();
+}
 
-		dAge5yr = survivalParameters["5 Year Among Recipients 40-49"];
-		dAge10yr = survivalParameters["10 Year Among Recipients 40-49"];
-	}
-	else if (candidate->getAge() >= 50 && candidate->getAge() <= 59) {
 
-		dAge5yr = survivalParameters["5 Year Among Recipients 50-59"];
-		dAge10yr = survivalParameters["10 Year Among Recipients 50-59"];
+KPDCrossmatchPanel::KPDCrossmatchPanel() {
 
-		survival += fiveyear*(cAge5yr[5]) + (1 - fiveyear)*(cAge10yr[5]);
-	}
-	else if (candidate->getAge() >= 60) {
+	waitlist = false;
+	allAntigensExact = true;
+}
 
-		dAge5yr = survivalParameters["5 Year Among Recipients 60+"];
-		dAge10yr = survivalParameters["10 Year Among Recipients 60+"];
+KPDCrossmatchPanel::KPDCrossmatchPanel(const std::vector<KPDCandidate *> & candidates, bool waitlist) {
 
-		survival += fiveyear*(cAge5yr[6]) + (1 - fiveyear)*(cAge10yr[6]);
-	}
+	setCandidates(candidates, waitlist);
+}
 
-	while (donorsAge > 0 && changePoint <= 3) {
-		survival += donorsAge*(fiveyear*(dAge5yr[changePoint]) + (1 - fiveyear)*(dAge10yr[changePoint]));
-		donorsAge = donorsAge - donorAgeChangePoints[changePoint];
-		changePoint++;
-	}
+KPDCrossmatchPanel::~KPDCrossmatchPanel() {
 
-	//Sex Combination
-	std::vector<double> pSex5yr = survivalParameters["5 Year Donor-Recipient Sex"];
-	std::vector<double> pSex10yr = survivalParameters["10 Year Donor-Recipient Sex"];
-	if (!candidate->getMale() && !donor->getMale()) {
-		survival += fiveyear*(pSex5yr[0]) + (1 - fiveyear)*(pSex10yr[0]);
-	}
-	if (!candidate->getMale() && donor->getMale()) {
-		survival += fiveyear*(pSex5yr[1]) + (1 - fiveyear)*(pSex10yr[1]);
-	}
-	if (candidate->getMale() && donor->getMale()) {
-		survival += fiveyear*(pSex5yr[3]) + (1 - fiveyear)*(pSex10yr[3]);
-	}
+}
 
-	//HLA Mismatches
-	double pNoMismatch5yr = survivalParameters["5 Year HLA ABDR Mismatch"][0];
-	double pNoMismatch10yr = survivalParameters["10 Year HLA ABDR Mismatch"][0];
-	survival += fiveyear*(pNoMismatch5yr)+(1 - fiveyear)*(pNoMismatch10yr);
+void KPDCrossmatchPanel::setCandidates(const std::vector<KPDCandidate *> & panelCandidates, bool panelWaitlist) {
 
-	//BMI
-	double cBMI5yr = survivalParameters["5 Year Recipient BMI"][1];
-	double cBMI10yr = survivalParameters["10 Year Recipient BMI"][1];
-	double dBMI5yr = survivalParameters["5 Year Donor BMI"][1];
-	double dBMI10yr = survivalParameters["10 Year Donor BMI"][1];
+	waitlist = panelWaitlist;
 
-	if (candidate->getBMI()>30) {
-		survival += fiveyear*(cBMI5yr)+(1 - fiveyear)*(cBMI10yr);
-	}
-	if (donor->getBMI()>30) {
-		survival += fiveyear*(dBMI5yr)+(1 - fiveyear)*(dBMI10yr);
-	}
+	candidates = panelCandidates;
 
-	//Weight Ratio
-	double weightRatio = (donor->getWeight()) / (candidate->getWeight());
-	std::vector<double> pWR5yr = survivalParameters["5 Year Donor-Recipient Weight Ratio"];
-	std::vector<double> pWR10yr = survivalParameters["10 Year Donor-Recipient Weight Ratio"];
+	bloodTypes.clear();
+	unacceptableAntigens.clear();
+	desensitizableAntigens.clear();
+	antigensExpanded.clear();
+	antigensExact.clear();
 
-	if (weightRatio < 0.75) {
-		survival += fiveyear*(pWR5yr[0]) + (1 - fiveyear)*(pWR10yr[0]);
-	}
-	else if (weightRatio >= 0.75 && weightRatio < 0.90) {
-		survival += fiveyear*(pWR5yr[1]) + (1 - fiveyear)*(pWR10yr[1]);
-	}
-	else if (weightRatio >= 1.15) {
-		survival += fiveyear*(pWR5yr[3]) + (1 - fiveyear)*(pWR10yr[3]);
-	}
+	allAntigensExact = true;
 
-	//Height Ratio
-	double heightRatio = (donor->getHeight()) / (candidate->getHeight());
-	std::vector<double> pHR5yr = survivalParameters["5 Year Donor-Recipient Height Ratio"];
-	std::vector<double> pHR10yr = survivalParameters["10 Year Donor-Recipient Height Ratio"];
+	for (std::vector<KPDCandidate *>::iterator it = candidates.begin(); it != candidates.end(); it++) {
 
-	if (heightRatio < 0.94) {
-		survival += fiveyear*(pHR5yr[0]) + (1 - fiveyear)*(pHR10yr[0]);
-	}
-	else if (heightRatio >= 0.94 && heightRatio < 1.0) {
-		survival += fiveyear*(pHR5yr[1]) + (1 - fiveyear)*(pHR10yr[1]);
-	}
-	else if (heightRatio >= 1.06) {
-		survival += fiveyear*(pHR5yr[2]) + (1 - fiveyear)*(pHR10yr[2]);
-	}
+		KPDCandidate * candidate = *it;
 
-	//Race
-	std::vector<double> cRace5yr = survivalParameters["5 Year Recipient Race"];
-	std::vector<double> cRace10yr = survivalParameters["10 Year Recipient Race"];
-	if (candidate->getRace() == RACE_WHITE) {
-		survival += fiveyear*(cRace5yr[0]) + (1 - fiveyear)*(cRace10yr[0]);
-	}
-	else if (candidate->getRace() == RACE_BLACK) {
-		survival += fiveyear*(cRace5yr[1]) + (1 - fiveyear)*(cRace10yr[1]);
-	}
-	else if (candidate->getRace() == RACE_HISPANIC) {
-		survival += fiveyear*(cRace5yr[2]) + (1 - fiveyear)*(cRace10yr[2]);
-	}
-	else {
-		survival += fiveyear*(cRace5yr[3]) + (1 - fiveyear)*(cRace10yr[3]);
-	}
+		bloodTypes.push_back(candidate->getBT());
 
-	std::vector<double> dRace5yr = survivalParameters["5 Year Donor Race"];
-	std::vector<double> dRace10yr = survivalParameters["10 Year Donor Race"];
-	if (donor->getRace() != RACE_BLACK && donor->getRace() != RACE_HISPANIC) {
-		survival += fiveyear*(dRace5yr[0]) + (1 - fiveyear)*(dRace10yr[0]);
-	}
-	else if (donor->getRace() == RACE_BLACK) {
-		survival += fiveyear*(dRace5yr[1]) + (1 - fiveyear)*(dRace10yr[1]);
-	}
-	else if (donor->getRace() == RACE_HISPANIC) {
-		survival += fiveyear*(dRace5yr[2]) + (1 - fiveyear)*(dRace10yr[2]);
-	}
+		if (waitlist) {
+			unacceptableAntigens.push_back(candidate->getWaitlistUnacceptableAntigens());
+			desensitizableAntigens.push_back(KPDAntigenSet());
+		}
+		else {
+			unacceptableAntigens.push_back(candidate->getUnacceptableAntigens());
+			desensitizableAntigens.push_back(candidate->getDesensitizableAntigens());
+		}
 
-	//Donor Cigarette Use
-	std::vector<double> dCigarette5yr = survivalParameters["5 Year Donor Cigarette Use"];
-	std::vector<double> dCigarette10yr = survivalParameters["10 Year Donor Cigarette Use"];
-	if (donor->getCigaretteUse()) {
-		survival += fiveyear*(dCigarette5yr[1]) + (1 - fiveyear)*(dCigarette10yr[1]);
-	}
+		antigensExpanded.push_back(candidate->getAntigensExpanded());
+		antigensExact.push_back(unacceptableAntigens.back().isExact() && desensitizableAntigens.back().isExact());
 
-	//PRA
-	std::vector<double> cPRA5yr = survivalParameters["5 Year PRA"];
-	std::vector<double> cPRA10yr = survivalParameters["10 Year PRA"];
-	if (candidate->getPRA() >= 10 && candidate->getPRA() <= 79) {
-		survival += fiveyear*(cPRA5yr[1]) + (1 - fiveyear)*(cPRA10yr[1]);
-	}
-	else if (candidate->getPRA() >= 80 && candidate->getPRA() <= 100) {
-		survival += fiveyear*(cPRA5yr[2]) + (1 - fiveyear)*(cPRA10yr[2]);
+		if (!antigensExpanded.back() || !antigensExact.back()) {
+			allAntigensExact = false;
+		}
 	}
+}
 
-	//Recipient Diabetes Diagnosis
-	double cDiabetes5yr = survivalParameters["5 Year Recipient Diabetes Status"][1];
-	double cDiabetes10yr = survivalParameters["10 Year Recipient Diabetes Status"][1];
-	if (candidate->getDiabetes()) {
-		survival += fiveyear*(cDiabetes5yr)+(1 - fiveyear)*(cDiabetes10yr);
-	}
+int KPDCrossmatchPanel::size() const {
 
-	//Previous Tranpslant
-	double cPrevTrans5yr = survivalParameters["5 Year Previous Transplant"][1];
-	double cPrevTrans10yr = survivalParameters["10 Year Previous Transplant"][1];
-	if (candidate->getPrevTrans()) {
-		survival += fiveyear*(cPrevTrans5yr)+(1 - fiveyear)*(cPrevTrans10yr);
-	}
+	return (int)candidates.size();
+}
 
-	//Time on Dialysis
-	std::vector<double> cTOD5yr = survivalParameters["5 Year Time on Dialysis"];
-	std::vector<double> cTOD10yr = survivalParameters["10 Year Time on Dialysis"];
-	if (candidate->getTOD() == 0) {
-		survival += fiveyear*(cTOD5yr[0]) + (1 - fiveyear)*(cTOD10yr[0]);
-	}
-	else if (candidate->getTOD() > 0 && candidate->getTOD() <= 1) {
-		survival += fiveyear*(cTOD5yr[1]) + (1 - fiveyear)*(cTOD10yr[1]);
-	}
-	else if (candidate->getTOD() > 1 && candidate->getTOD() <= 2) {
-		survival += fiveyear*(cTOD5yr[2]) + (1 - fiveyear)*(cTOD10yr[2]);
-	}
-	else if (candidate->getTOD() > 2 && candidate->getTOD() <= 3) {
-		survival += fiveyear*(cTOD5yr[3]) + (1 - fiveyear)*(cTOD10yr[3]);
-	}
-	else if (candidate->getTOD() > 3) {
-		survival += fiveyear*(cTOD5yr[4]) + (1 - fiveyear)*(cTOD10yr[4]);
-	}
+KPDIncompatibleDonorSampler::KPDIncompatibleDonorSampler() {
 
-	//Hep C Seriology
-	double cHepC5yr = survivalParameters["5 Year Recipient Hepatitis C Seriology"][1];
-	double cHepC10yr = survivalParameters["10 Year Recipient Hepatitis C Seriology"][1];
-	if (candidate->getHepC()) {
-		survival += fiveyear*(cHepC5yr)+(1 - fiveyear)*(cHepC10yr);
+	bwClass[0] = ANTIGEN_CLASS_NONE;
+	bwClass[1] = ANTIGEN_CLASS_NONE;
+
+	for (int i = 0; i < DONOR_HLA_COMPONENTS; i++) {
+		for (int k = 0; k < ANTIGEN_CLASSES; k++) {
+			componentProbability[i][k] = (k == ANTIGEN_CLASS_NONE) ? 1.0 : 0.0;
+		}
 	}
+}
 
-	//Insurance
-	std::vector<double> cInsurance5yr = survivalParameters["5 Year Recipient Insurance"];
-	std::vector<double> cInsurance10yr = survivalParameters["10 Year Recipient Insurance"];
+KPDIncompatibleDonorSampler::~KPDIncompatibleDonorSampler() {
 
-	if (candidate->getInsurance() == INSURANCE_PUBLIC || candidate->getInsurance() == INSURANCE_MEDICARE || candidate->getInsurance() == INSURANCE_MEDICARE_PLUS || candidate->getInsurance() == INSURANCE_MEDICAID) {
-		survival += fiveyear*(cInsurance5yr[0]) + (1 - fiveyear)*(cInsurance10yr[0]);
-	}
-	else if (candidate->getInsurance() == INSURANCE_PRIVATE || candidate->getInsurance() == INSURANCE_PRIVATE_PLUS) {
-		survival += fiveyear*(cInsurance5yr[1]) + (1 - fiveyear)*(cInsurance10yr[1]);
-	}
-	else if (candidate->getInsurance() == INSURANCE_OTHER) {
-		survival += fiveyear*(cInsurance5yr[2]) + (1 - fiveyear)*(cInsurance10yr[2]);
-	}
+}
 
-	//Adjust for Year
-	survival += fiveyear*(survivalParameters["5 Year Transplant Year"][2]) + (1 - fiveyear)*(survivalParameters["10 Year Transplant Year"][2]);
+int KPDIncompatibleDonorSampler::getHaplotypeClass(int haplotype) const {
 
-	//Calculate Survival
-	double expo = exp(survival);
-	if (fiveyear == 1) {
-		survival = pow(survivalParameters["5 Year Baseline"][0], expo);
-	}
-	else {
-		survival = pow(survivalParameters["10 Year Baseline"][0], expo);
+	for (int k = ANTIGEN_CLASSES - 1; k > ANTIGEN_CLASS_NONE; k--) {
+		if (std::binary_search(haplotypes[k].begin(), haplotypes[k].end(), haplotype)) {
+			return k;
+		}
 	}
 
-	return survival;
+	return ANTIGEN_CLASS_NONE;
 }
 
-void KPDData::printLog() {
+void KPDIncompatibleDonorSampler::getClassProbabilities(double probability[ANTIGEN_CLASSES]) const {
 
-	std::string logFile = "output/" + kpdParameters->getOutputFolder() + "/" + kpdParameters->getSubFolder() + "/Log-Data.txt";
-	std::ofstream outputFileLog(logFile.c_str());
-	outputFileLog << kpdDataLog.str();
-	outputFileLog.close();
+	// The HLA is in no class if all of its components are, and is not unacceptable if none of its components are
+	double none = 1.0;
+	double notUnacceptable = 1.0;
+
+	for (int i = 0; i < DONOR_HLA_COMPONENTS; i++) {
+		none *= componentProbability[i][ANTIGEN_CLASS_NONE];
+		notUnacceptable *= componentProbability[i][ANTIGEN_CLASS_NONE] + componentProbability[i][ANTIGEN_CLASS_DESENSITIZABLE];
+	}
+
+	probability[ANTIGEN_CLASS_NONE] = none;
+	probability[ANTIGEN_CLASS_DESENSITIZABLE] = std::max(0.0, notUnacceptable - none);
+	probability[ANTIGEN_CLASS_UNACCEPTABLE] = std::max(0.0, 1 - notUnacceptable);
 }
 
+void KPDIncompatibleDonorSampler::sampleComponentClasses(int hlaClass, const double * u, int componentClass[DONOR_HLA_COMPONENTS]) const {
+
+	// Components are in classes up to hlaClass, and at least one is in hlaClass itself (unless that is no class);
+	// restAll[i] and restNone[i] are the probabilities that components i, ... are all in those classes, and in those classes but not hlaClass
+	double restAll[DONOR_HLA_COMPONENTS + 1];
+	double restNone[DONOR_HLA_COMPONENTS + 1];
+
+	restAll[DONOR_HLA_COMPONENTS] = 1.0;
+	restNone[DONOR_HLA_COMPONENTS] = 1.0;
+
+	for (int i = DONOR_HLA_COMPONENTS - 1; i >= 0; i--) {
+
+		double allowed = 0.0;
+		for (int k = 0; k <= hlaClass; k++) {
+			allowed += componentProbability[i][k];
+		}
+
+		restAll[i] = restAll[i + 1] * allowed;
+		restNone[i] = restNone[i + 1] * (allowed - componentProbability[i][hlaClass]);
+	}
+
+	bool found = (hlaClass == ANTIGEN_CLASS_NONE);
+
+	for (int i = 0; i < DONOR_HLA_COMPONENTS; i++) {
+
+		double weight[ANTIGEN_CLASSES];
+		double totalWeight = 0.0;
+
+		for (int k = 0; k < ANTIGEN_CLASSES; k++) {
+
+			if (k > hlaClass) {
+				weight[k] = 0.0;
+			}
+			else if (found || k == hlaClass) {
+				weight[k] = componentProbability[i][k] * restAll[i + 1];
+			}
+			else {
+				weight[k] = componentProbability[i][k] * (restAll[i + 1] - restNone[i + 1]); // A later component must be in hlaClass
+			}
+
+			totalWeight += weight[k];
+		}
+
+		double x = u[i] * totalWeight;
+
+		componentClass[i] = hlaClass;
+
+		for (int k = 0; k <= hlaClass; k++) {
+			if (weight[k] > 0) {
+
+				componentClass[i] = k;
+
+				if (x < weight[k]) {
+					break;
+				}
+
+				x -= weight[k];
+			}
+		}
+
+		if (componentClass[i] == hlaClass) {
+			found = true;
+		}
+	}
+}
 
 #endif
\ No newline at end of file
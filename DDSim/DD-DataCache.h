@@ -0,0 +1,510 @@
+/* ---------------------------------------------
+DD-DataCache.h
+Defines a Binary Cache of Data Assembled from Files
+---------------------------------------------- */
+
+#ifndef DATACACHE_H
+#define DATACACHE_H
+
+#include "DD-Enums-Functions.h"
+#include "DD-Candidate.h"
+#include "DD-Donor.h"
+#include "DD-CSV.h"
+
+#include <vector>
+#include <string>
+#include <deque>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <stdio.h>
+#include <string.h>
+
+/* Increment whenever the cached contents or their layout change (e.g., new donor or candidate fields,
+or changes to how the data is assembled from the files), so that existing caches are rebuilt */
+#define DATA_CACHE_VERSION 2
+#define DATA_CACHE_MAGIC "DDCACHE"
+
+/* A cache is a header (magic, version, key) followed by values in native byte order.
+Values are read directly from the mapped cache file; a cache is only used if its version and key
+(hashes of the input files and any options used to assemble the data) match exactly */
+class KPDDataCache {
+
+private:
+
+	std::string fileName;
+	std::vector<unsigned long long> key;
+
+	// Writing
+	std::string buffer;
+
+	// Reading
+	KPDMappedFile * mapping;
+	const char * position;
+	const char * end;
+	bool valid;
+
+	void write(const void * value, size_t size);
+	bool read(void * value, size_t size);
+
+public:
+
+	KPDDataCache(std::string name, std::vector<unsigned long long> cacheKey);
+	~KPDDataCache();
+
+	std::string getFileName();
+
+	// Maps the cache file; returns false if there is no usable cache (missing, outdated, or different key)
+	bool open();
+	// Returns false if any read ran past the end of the cache
+	bool isValid();
+
+	// Writes the values collected so far (to a temporary file, renamed into place)
+	bool save();
+
+	void writeInt(int value);
+	void writeBool(bool value);
+	void writeDouble(double value);
+	void writeString(const std::string & value);
+	void writeInts(const std::vector<int> & values);
+	void writeDoubles(const std::vector<double> & values);
+	void writeStrings(const std::vector<std::string> & values);
+	void writeDonor(KPDDonor * donor);
+	void writeCandidate(KPDCandidate * candidate);
+
+	int readInt();
+	bool readBool();
+	double readDouble();
+	std::string readString();
+	std::vector<int> readInts();
+	std::vector<double> readDoubles();
+	std::vector<std::string> readStrings();
+	KPDDonor * readDonor();
+	KPDCandidate * readCandidate();
+};
+
+KPDDataCache::KPDDataCache(std::string name, std::vector<unsigned long long> cacheKey) {
+
+	fileName = name;
+	key = cacheKey;
+
+	mapping = NULL;
+	position = NULL;
+	end = NULL;
+	valid = false;
+}
+
+KPDDataCache::~KPDDataCache() {
+
+	delete mapping;
+}
+
+std::string KPDDataCache::getFileName() {
+
+	return fileName;
+}
+
+bool KPDDataCache::open() {
+
+	delete mapping;
+
+	mapping = new KPDMappedFile(fileName);
+	valid = false;
+
+	if (!mapping->isOpen()) {
+		return false;
+	}
+
+	position = mapping->getData();
+	end = position + mapping->getSize();
+	valid = true;
+
+	// Header
+	char magic[8];
+	if (!read(magic, 8) || memcmp(magic, DATA_CACHE_MAGIC, 8) != 0) {
+		valid = false;
+		return false;
+	}
+
+	int version = readInt();
+	int keyLength = readInt();
+
+	if (!valid || version != DATA_CACHE_VERSION || keyLength != (int)key.size()) {
+		valid = false;
+		return false;
+	}
+
+	for (int k = 0; k < keyLength; k++) {
+
+		unsigned long long value = 0;
+		if (!read(&value, sizeof(value)) || value != key[k]) {
+			valid = false;
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool KPDDataCache::isValid() {
+
+	return valid;
+}
+
+bool KPDDataCache::save() {
+
+	std::string header(DATA_CACHE_MAGIC, 8);
+
+	int version = DATA_CACHE_VERSION;
+	int keyLength = (int)key.size();
+
+	header.append((const char *)&version, sizeof(int));
+	header.append((const char *)&keyLength, sizeof(int));
+
+	for (int k = 0; k < keyLength; k++) {
+		header.append((const char *)&key[k], sizeof(unsigned long long));
+	}
+
+	// Concurrent runs may rebuild the same cache; each writes its own temporary file and the last rename wins
+	std::stringstream temporaryName;
+	temporaryName << fileName << ".tmp" << std::chrono::high_resolution_clock::now().time_since_epoch().count() << "-" << (size_t)this;
+
+	std::ofstream cacheFile(temporaryName.str().c_str(), std::ios::out | std::ios::binary);
+
+	if (!cacheFile.is_open()) {
+		return false;
+	}
+
+	cacheFile.write(header.data(), header.size());
+	cacheFile.write(buffer.data(), buffer.size());
+	cacheFile.close();
+
+	if (cacheFile.fail()) {
+		remove(temporaryName.str().c_str());
+		return false;
+	}
+
+	// The cache may be mapped by this or another run (and rename does not replace files on Windows)
+	delete mapping;
+	mapping = NULL;
+
+	if (rename(temporaryName.str().c_str(), fileName.c_str()) != 0) {
+		remove(fileName.c_str());
+
+		if (rename(temporaryName.str().c_str(), fileName.c_str()) != 0) {
+			remove(temporaryName.str().c_str());
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void KPDDataCache::write(const void * value, size_t size) {
+
+	buffer.append((const char *)value, size);
+}
+
+bool KPDDataCache::read(void * value, size_t size) {
+
+	if (!valid || (size_t)(end - position) < size) {
+		valid = false;
+		memset(value, 0, size);
+		return false;
+	}
+
+	memcpy(value, position, size);
+	position += size;
+
+	return true;
+}
+
+void KPDDataCache::writeInt(int value) {
+
+	write(&value, sizeof(int));
+}
+
+void KPDDataCache::writeBool(bool value) {
+
+	char c = value ? 1 : 0;
+	write(&c, 1);
+}
+
+void KPDDataCache::writeDouble(double value) {
+
+	write(&value, sizeof(double));
+}
+
+void KPDDataCache::writeString(const std::string & value) {
+
+	writeInt((int)value.size());
+	write(value.data(), value.size());
+}
+
+void KPDDataCache::writeInts(const std::vector<int> & values) {
+
+	writeInt((int)values.size());
+	if (!values.empty()) {
+		write(&values[0], values.size() * sizeof(int));
+	}
+}
+
+void KPDDataCache::writeDoubles(const std::vector<double> & values) {
+
+	writeInt((int)values.size());
+	if (!values.empty()) {
+		write(&values[0], values.size() * sizeof(double));
+	}
+}
+
+void KPDDataCache::writeStrings(const std::vector<std::string> & values) {
+
+	writeInt((int)values.size());
+	for (std::vector<std::string>::const_iterator it = values.begin(); it != values.end(); it++) {
+		writeString(*it);
+	}
+}
+
+void KPDDataCache::writeDonor(KPDDonor * donor) {
+
+	writeInt(donor->getDonorID());
+	writeInt(donor->getKPDMatchingID());
+
+	writeInt(donor->getBT());
+	writeBool(donor->getMinorA());
+	writeStrings(donor->getHLA().toStrings());
+
+	writeInt(donor->getRelation());
+	writeInt(donor->getAge());
+	writeBool(donor->getMale());
+	writeInt(donor->getRace());
+	writeDouble(donor->getHeight());
+	writeDouble(donor->getWeight());
+	writeBool(donor->getCigaretteUse());
+
+	writeBool(donor->isDeceasedDonor());
+	writeInt(donor->getRecoveryTime());
+	writeBool(donor->getBothKidneysAvailable());
+	writeInt(donor->getOPO());
+	writeDouble(donor->getKDPI());
+}
+
+void KPDDataCache::writeCandidate(KPDCandidate * candidate) {
+
+	writeInt(candidate->getCandidateID());
+	writeInt(candidate->getKPDMatchingID());
+
+	writeInt(candidate->getPRA());
+	writeInt(candidate->getBT());
+	writeBool(candidate->getMinorA());
+
+	writeStrings(candidate->getHLA().toStrings());
+	writeStrings(KPDAntigenTable::names(candidate->getUnacceptableHLA()));
+	writeStrings(KPDAntigenTable::names(candidate->getDesensitizableHLA()));
+
+	writeInt(candidate->getAge());
+	writeBool(candidate->getMale());
+	writeInt(candidate->getRace());
+	writeBool(candidate->getDiabetes());
+	writeDouble(candidate->getHeight());
+	writeDouble(candidate->getWeight());
+	writeBool(candidate->getPrevTrans());
+	writeDouble(candidate->getTOD());
+	writeBool(candidate->getHepC());
+	writeInt(candidate->getInsurance());
+	writeDouble(candidate->getEPTS());
+	writeBool(candidate->getEPTSPriority());
+
+	writeBool(candidate->getWaitlist());
+	writeInt(candidate->getListingTime());
+	writeInt(candidate->getOPO());
+	writeBool(candidate->getWithdraws());
+	writeInt(candidate->getWithdrawalTime());
+
+	// Status changes (without the withdrawal, which the getters append)
+	std::deque<int> statusChangeTimes = candidate->getStatusChangeTimes();
+	std::deque<KPDStatus> statuses = candidate->getStatuses();
+
+	if (candidate->getWithdraws()) {
+		statusChangeTimes.pop_back();
+		statuses.pop_back();
+	}
+
+	writeInt((int)statuses.size());
+	for (int i = 0; i < (int)statuses.size(); i++) {
+		writeInt(statusChangeTimes[i]);
+		writeInt(statuses[i]);
+	}
+}
+
+int KPDDataCache::readInt() {
+
+	int value;
+	read(&value, sizeof(int));
+
+	return value;
+}
+
+bool KPDDataCache::readBool() {
+
+	char c;
+	read(&c, 1);
+
+	return c != 0;
+}
+
+double KPDDataCache::readDouble() {
+
+	double value;
+	read(&value, sizeof(double));
+
+	return value;
+}
+
+std::string KPDDataCache::readString() {
+
+	int length = readInt();
+
+	if (!valid || length < 0 || (size_t)(end - position) < (size_t)length) {
+		valid = false;
+		return std::string();
+	}
+
+	std::string value(position, length);
+	position += length;
+
+	return value;
+}
+
+std::vector<int> KPDDataCache::readInts() {
+
+	int n = readInt();
+
+	if (!valid || n < 0 || (size_t)(end - position) / sizeof(int) < (size_t)n) {
+		valid = false;
+		return std::vector<int>();
+	}
+
+	std::vector<int> values(n);
+	read(values.data(), n * sizeof(int));
+
+	return values;
+}
+
+std::vector<double> KPDDataCache::readDoubles() {
+
+	int n = readInt();
+
+	if (!valid || n < 0 || (size_t)(end - position) / sizeof(double) < (size_t)n) {
+		valid = false;
+		return std::vector<double>();
+	}
+
+	std::vector<double> values(n);
+	read(values.data(), n * sizeof(double));
+
+	return values;
+}
+
+std::vector<std::string> KPDDataCache::readStrings() {
+
+	int n = readInt();
+
+	std::vector<std::string> values;
+
+	for (int i = 0; i < n && valid; i++) {
+		values.push_back(readString());
+	}
+
+	return values;
+}
+
+KPDDonor * KPDDataCache::readDonor() {
+
+	int id = readInt();
+	int matchingID = readInt();
+
+	KPDBloodType bt = (KPDBloodType)readInt();
+	bool minorA = readBool();
+	KPDHLA hla(readStrings());
+
+	KPDRelation relation = (KPDRelation)readInt();
+	int age = readInt();
+	bool male = readBool();
+	KPDRace race = (KPDRace)readInt();
+	double height = readDouble();
+	double weight = readDouble();
+	bool cigaretteUse = readBool();
+
+	bool deceased = readBool();
+	int recoveryTime = readInt();
+	bool bothKidneys = readBool();
+	int opo = readInt();
+	double kdpi = readDouble();
+
+	KPDDonor * donor = new KPDDonor(id, matchingID, bt, minorA,
+		relation, age, male, race, height, weight, cigaretteUse,
+		deceased, recoveryTime, bothKidneys, opo, kdpi);
+
+	donor->setHLA(hla);
+
+	return donor;
+}
+
+KPDCandidate * KPDDataCache::readCandidate() {
+
+	int id = readInt();
+	int matchingID = readInt();
+
+	int pra = readInt();
+	KPDBloodType bt = (KPDBloodType)readInt();
+	bool minorA = readBool();
+
+	KPDHLA hla(readStrings());
+	std::vector<KPDAntigen> unacceptableHLA = KPDAntigenTable::intern(readStrings());
+	std::vector<KPDAntigen> desensitizableHLA = KPDAntigenTable::intern(readStrings());
+
+	int age = readInt();
+	bool male = readBool();
+	KPDRace race = (KPDRace)readInt();
+	bool diabetes = readBool();
+	double height = readDouble();
+	double weight = readDouble();
+	bool prevTrans = readBool();
+	double tod = readDouble();
+	bool hepC = readBool();
+	KPDInsurance insurance = (KPDInsurance)readInt();
+	double epts = readDouble();
+	bool eptsPriority = readBool();
+
+	bool waitlist = readBool();
+	int listingTime = readInt();
+	int opo = readInt();
+	bool withdraws = readBool();
+	int withdrawalTime = readInt();
+
+	KPDCandidate * candidate = new KPDCandidate(id, matchingID, pra, bt, minorA,
+		age, male, race, diabetes, height, weight, prevTrans, tod, hepC, insurance, epts, eptsPriority,
+		waitlist, listingTime, opo, withdraws, withdrawalTime);
+
+	candidate->setHLA(hla);
+	candidate->setUnacceptableHLA(unacceptableHLA);
+	candidate->setDesensitizableHLA(desensitizableHLA);
+
+	int numberOfStatusChanges = readInt();
+
+	std::vector<int> statusChangeTimes;
+	std::vector<KPDStatus> statuses;
+
+	for (int i = 0; i < numberOfStatusChanges && valid; i++) {
+		statusChangeTimes.push_back(readInt());
+		statuses.push_back((KPDStatus)readInt());
+	}
+
+	candidate->setStatusChangeTime(statusChangeTimes);
+	candidate->setStatusChanges(statuses);
+
+	return candidate;
+}
+
+#endif
@@ -7,6 +7,7 @@ Stores information about donors (KPD and deceased)
 #define DONOR_H
 
 #include "DD-Enums-Functions.h"
+#include "DD-HLA.h"
 
 #include <vector>
 #include <string>
@@ -25,7 +26,8 @@ private:
 	//Crossmatch Information	
 	KPDBloodType donorBT;
 	bool donorMinorA;
-	std::vector<std::string> donorHLA;
+	KPDHLA donorHLA;
+	KPDAntigenSet donorAntigens;
 
 	//Characteristics
 	KPDRelation donorRelation;	
@@ -36,6 +38,10 @@ private:
 	double donorWeight;
 	bool donorCigaretteUse;
 
+	//Donor-only terms of the survival model (5-year, 10-year; set by the data, as they depend on the survival parameters)
+	bool donorSurvivalTermsSet;
+	double donorSurvivalTerms[2];
+
 	bool donorDeceased;
 	int donorRecoveryTime;
 	bool donorBothKidneysAvailable;
@@ -67,7 +73,8 @@ public:
 		
 	KPDBloodType getBT();
 	bool getMinorA();
-	std::vector<std::string> getHLA();
+	const KPDHLA & getHLA();
+	const KPDAntigenSet & getAntigens();
 
 	KPDRelation getRelation();
 	int getAge();
@@ -78,6 +85,9 @@ public:
 	double getBMI();
 	bool getCigaretteUse();
 
+	bool getSurvivalTermsSet();
+	const double * getSurvivalTerms();
+
 	bool isDeceasedDonor();
 	int getRecoveryTime();
 	bool getBothKidneysAvailable();
@@ -91,7 +101,7 @@ public:
 		
 	void setBT(KPDBloodType bt);
 	void setMinorA(bool minorA);
-	void setHLA(std::vector<std::string> hla);
+	void setHLA(const KPDHLA & hla);
 
 	void setRelation(KPDRelation relation);
 	void setAge(int age);
@@ -101,6 +111,8 @@ public:
 	void setWeight(double weight);
 	void setCigaretteUse(bool cigaretteUse);
 
+	void setSurvivalTerms(const double terms[2]);
+
 	void setDeceasedDonor(bool dd);
 	void setRecoveryTime(int time);
 	void setBothKidneysAvailable(bool both);
@@ -130,6 +142,7 @@ KPDDonor::KPDDonor() {
 	donorHeight = 1.75;
 	donorWeight = 80;
 	donorCigaretteUse = false;
+	donorSurvivalTermsSet = false;
 
 	donorDeceased = false;
 	donorRecoveryTime = 0;
@@ -154,6 +167,7 @@ KPDDonor::KPDDonor(int id, int matchingID, KPDBloodType bt,
 	donorHeight = height;
 	donorWeight = weight;
 	donorCigaretteUse = cigaretteUse;
+	donorSurvivalTermsSet = false;
 
 	donorDeceased = false;
 	donorRecoveryTime = 0;
@@ -179,6 +193,7 @@ KPDDonor::KPDDonor(int id, KPDBloodType bt, bool minorA,
 	donorHeight = height;
 	donorWeight = weight;
 	donorCigaretteUse = cigaretteUse;
+	donorSurvivalTermsSet = false;
 
 	donorDeceased = true;
 	donorRecoveryTime = recoveryTime;
@@ -204,6 +219,7 @@ KPDDonor::KPDDonor(int id, int matchingID, KPDBloodType bt, bool minorA,
 	donorHeight = height;
 	donorWeight = weight;
 	donorCigaretteUse = cigaretteUse;
+	donorSurvivalTermsSet = false;
 
 	donorDeceased = dd;
 	donorRecoveryTime = recoveryTime;
@@ -233,15 +249,14 @@ bool KPDDonor::getMinorA() {
 	return donorMinorA;
 }
 
-std::vector<std::string> KPDDonor::getHLA() {
+const KPDHLA & KPDDonor::getHLA() {
 
-	std::vector<std::string> hla;
+	return donorHLA;
+}
 
-	for (std::vector<std::string>::iterator it = donorHLA.begin(); it != donorHLA.end(); it++) {
-		hla.push_back(*it);
-	}
+const KPDAntigenSet & KPDDonor::getAntigens() {
 
-	return hla;
+	return donorAntigens;
 }
 
 KPDRelation KPDDonor::getRelation() {
@@ -276,6 +291,14 @@ bool KPDDonor::getCigaretteUse() {
 	return donorCigaretteUse;
 }
 
+bool KPDDonor::getSurvivalTermsSet() {
+	return donorSurvivalTermsSet;
+}
+
+const double * KPDDonor::getSurvivalTerms() {
+	return donorSurvivalTerms;
+}
+
 bool KPDDonor::isDeceasedDonor(){
 	return donorDeceased;
 }
@@ -312,12 +335,10 @@ void KPDDonor::setMinorA(bool minorA){
 	donorMinorA = minorA;
 }
 
-void KPDDonor::setHLA(std::vector<std::string> hla) {
+void KPDDonor::setHLA(const KPDHLA & hla) {
 
-	donorHLA.clear();
-	for (std::vector<std::string>::iterator hlaIt = hla.begin(); hlaIt != hla.end(); hlaIt++) {
-		donorHLA.push_back(*hlaIt);
-	}
+	donorHLA = hla;
+	donorAntigens = KPDAntigenSet(hla);
 }
 
 void KPDDonor::setRelation(KPDRelation relation) {
@@ -334,18 +355,29 @@ void KPDDonor::setMale(bool genderMale) {
 
 void KPDDonor::setRace(KPDRace race) {
 	donorRace = race;
+	donorSurvivalTermsSet = false;
 }
 
 void KPDDonor::setHeight(double height) {
 	donorHeight = height;
+	donorSurvivalTermsSet = false;
 }
 
 void KPDDonor::setWeight(double weight) {
 	donorWeight = weight;
+	donorSurvivalTermsSet = false;
 }
 
 void KPDDonor::setCigaretteUse(bool cigaretteUse) {
 	donorCigaretteUse = cigaretteUse;
+	donorSurvivalTermsSet = false;
+}
+
+void KPDDonor::setSurvivalTerms(const double terms[2]) {
+
+	donorSurvivalTerms[0] = terms[0];
+	donorSurvivalTerms[1] = terms[1];
+	donorSurvivalTermsSet = true;
 }
 
 void KPDDonor::setDeceasedDonor(bool dd) {
@@ -429,8 +461,8 @@ std::string KPDDonor::donorOutput() {
 	}
 	
 	donorInfo << KPDFunctions::indent(tab) << "HLA:";
-	for (std::vector<std::string>::iterator hla = donorHLA.begin(); hla != donorHLA.end(); hla++) {
-		donorInfo << " " << *hla;
+	for (const KPDAntigen * hla = donorHLA.begin(); hla != donorHLA.end(); hla++) {
+		donorInfo << " " << KPDAntigenTable::name(*hla);
 	}
 	donorInfo << std::endl;
 
@@ -451,6 +483,9 @@ KPDDonor * KPDDonor::copy() {
 		donorDeceased, donorRecoveryTime, donorBothKidneysAvailable, donorOPO, donorKDPI);
 
 	copyDonor->setHLA(donorHLA);
+	if (donorSurvivalTermsSet) {
+		copyDonor->setSurvivalTerms(donorSurvivalTerms);
+	}
 
 	return copyDonor;
 }
@@ -20,6 +20,11 @@ For Use Throughout the Project
 // Simulation Specifications
 enum KPDOptimizationScheme { CYCLES_AND_CHAINS, CYCLES_AND_CHAINS_WITH_FALLBACKS, LOCALLY_RELEVANT_SUBSETS };
 enum KPDUtilityScheme { UTILITY_TRANSPLANTS, UTILITY_FIVE_YEAR_SURVIVAL, UTILITY_TEN_YEAR_SURVIVAL, UTILITY_TRANSPLANT_DIFFICULTY, UTILITY_RANDOM };
+enum KPDExpectedUtilityMethod { EU_CLOSED_FORM, EU_EXACT, EU_MONTE_CARLO, EU_CACHED, EU_UPPER_BOUND };
+
+// Random Number Streams (for counter-based generators)
+enum KPDRandomStream { STREAM_EXPECTED_UTILITY = 1, STREAM_NODE_AVAILABILITY, STREAM_DONOR_SUCCESS, STREAM_MATCH_PROPERTIES,
+	STREAM_DECEASED_DONOR_MATCH_PROPERTIES, STREAM_WAITLIST_MATCH_PROPERTIES };
 
 // Characteristics
 enum KPDBloodType { BT_O, BT_A, BT_B, BT_AB, BT_UNSPECIFIED };
@@ -74,6 +79,31 @@ namespace KPDFunctions {
 
 		return numberOfFlags;
 	}
+
+	// Counts the set bits of a 64-bit mask (e.g., the number of simulated scenarios in which an event occurs)
+	inline int countBits(unsigned long long mask) {
+
+		mask = mask - ((mask >> 1) & 0x5555555555555555ULL);
+		mask = (mask & 0x3333333333333333ULL) + ((mask >> 2) & 0x3333333333333333ULL);
+		mask = (mask + (mask >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+
+		return (int)((mask * 0x0101010101010101ULL) >> 56);
+	}
+
+	// Blood type part of a crossmatch (failed, O donor to non-O candidate, or successful), by donor and candidate blood type
+	inline KPDCrossmatch bloodTypeCrossmatch(KPDBloodType donorBT, KPDBloodType candidateBT) {
+
+		static const KPDCrossmatch crossmatches[5][5] = {
+			// Candidate: O, A, B, AB, Unspecified
+			{ CROSSMATCH_SUCCESSFUL, CROSSMATCH_O_DONOR_TO_NON_O_CANDIDATE, CROSSMATCH_O_DONOR_TO_NON_O_CANDIDATE, CROSSMATCH_O_DONOR_TO_NON_O_CANDIDATE, CROSSMATCH_O_DONOR_TO_NON_O_CANDIDATE }, // Donor O
+			{ CROSSMATCH_FAILED, CROSSMATCH_SUCCESSFUL, CROSSMATCH_FAILED, CROSSMATCH_SUCCESSFUL, CROSSMATCH_SUCCESSFUL }, // Donor A
+			{ CROSSMATCH_FAILED, CROSSMATCH_FAILED, CROSSMATCH_SUCCESSFUL, CROSSMATCH_SUCCESSFUL, CROSSMATCH_SUCCESSFUL }, // Donor B
+			{ CROSSMATCH_FAILED, CROSSMATCH_FAILED, CROSSMATCH_FAILED, CROSSMATCH_SUCCESSFUL, CROSSMATCH_FAILED }, // Donor AB
+			{ CROSSMATCH_SUCCESSFUL, CROSSMATCH_SUCCESSFUL, CROSSMATCH_SUCCESSFUL, CROSSMATCH_SUCCESSFUL, CROSSMATCH_SUCCESSFUL } // Donor Unspecified
+		};
+
+		return crossmatches[donorBT][candidateBT];
+	}
 		
 	// String Functions
 
@@ -159,6 +189,27 @@ namespace KPDFunctions {
 			return "Unspecified";
 		}
 	}
+
+	inline std::string expectedUtilityMethodToString(KPDExpectedUtilityMethod method) {
+		if (method == EU_CLOSED_FORM) {
+			return "Closed Form";
+		}
+		else if (method == EU_EXACT) {
+			return "Exact";
+		}
+		else if (method == EU_MONTE_CARLO) {
+			return "Monte Carlo";
+		}
+		else if (method == EU_CACHED) {
+			return "Cached";
+		}
+		else if (method == EU_UPPER_BOUND) {
+			return "Upper Bound";
+		}
+		else {
+			return "Unspecified";
+		}
+	}
 	
 	inline std::string bloodTypeToString(KPDBloodType bloodType) {
 		if (bloodType == BT_O) {
@@ -0,0 +1,331 @@
+/* ---------------------------------------------
+DD-HLA.h
+Defines Interned HLA Antigens, Fixed-Size HLA Types and Antigen Bitsets
+---------------------------------------------- */
+
+#ifndef HLA_H
+#define HLA_H
+
+#include <stdint.h>
+
+#include <vector>
+#include <string>
+#include <map>
+#include <iostream>
+
+/* Antigens are stored as IDs into a global table of antigen names; a person is typed for at most HLA_MAX_ANTIGENS antigens */
+typedef uint16_t KPDAntigen;
+
+#define HLA_MAX_ANTIGENS 32
+
+/* Antigen sets are bitsets over antigen IDs below 64 * HLA_SET_WORDS (sets holding larger IDs are marked inexact) */
+#define HLA_SET_WORDS 8
+
+class KPDAntigenTable {
+
+private:
+
+	static std::vector<std::string> & antigenNames();
+	static std::map<std::string, KPDAntigen> & antigenIDs();
+
+public:
+
+	// Returns the ID of an antigen, adding it to the table when first seen (antigens are interned while data is read, not from worker threads)
+	static KPDAntigen intern(const std::string & antigen);
+	static std::vector<KPDAntigen> intern(const std::vector<std::string> & antigens);
+
+	static const std::string & name(KPDAntigen antigen);
+	static std::vector<std::string> names(const std::vector<KPDAntigen> & antigens);
+
+	static int size();
+};
+
+class KPDHLA {
+
+private:
+
+	KPDAntigen antigens[HLA_MAX_ANTIGENS];
+	int numberOfAntigens;
+
+public:
+
+	KPDHLA();
+	KPDHLA(const std::vector<std::string> & hla);
+	~KPDHLA();
+
+	int size() const;
+	bool empty() const;
+
+	KPDAntigen operator[](int i) const;
+	const KPDAntigen * begin() const;
+	const KPDAntigen * end() const;
+
+	void add(KPDAntigen antigen);
+	void add(const std::string & antigen);
+	void clear();
+
+	bool contains(KPDAntigen antigen) const;
+
+	// Number of (this, other) antigen pairs that are the same antigen
+	int countShared(const KPDHLA & other) const;
+
+	std::vector<std::string> toStrings() const;
+};
+
+class KPDAntigenSet {
+
+private:
+
+	unsigned long long words[HLA_SET_WORDS];
+	bool exact;
+
+public:
+
+	KPDAntigenSet();
+	KPDAntigenSet(const KPDHLA & hla);
+	~KPDAntigenSet();
+
+	void add(KPDAntigen antigen);
+	void add(const KPDHLA & hla);
+	void clear();
+
+	// Whether every antigen added is held in the bitset (otherwise the set cannot be used for crossmatching)
+	bool isExact() const;
+
+	bool contains(KPDAntigen antigen) const;
+	bool intersects(const KPDAntigenSet & other) const;
+};
+
+std::vector<std::string> & KPDAntigenTable::antigenNames() {
+
+	static std::vector<std::string> names;
+
+	return names;
+}
+
+std::map<std::string, KPDAntigen> & KPDAntigenTable::antigenIDs() {
+
+	static std::map<std::string, KPDAntigen> ids;
+
+	return ids;
+}
+
+KPDAntigen KPDAntigenTable::intern(const std::string & antigen) {
+
+	std::map<std::string, KPDAntigen> & ids = antigenIDs();
+
+	std::map<std::string, KPDAntigen>::iterator it = ids.find(antigen);
+
+	if (it != ids.end()) {
+		return it->second;
+	}
+
+	std::vector<std::string> & names = antigenNames();
+
+	KPDAntigen id = (KPDAntigen)names.size();
+
+	names.push_back(antigen);
+	ids[antigen] = id;
+
+	return id;
+}
+
+std::vector<KPDAntigen> KPDAntigenTable::intern(const std::vector<std::string> & antigens) {
+
+	std::vector<KPDAntigen> ids;
+
+	for (std::vector<std::string>::const_iterator it = antigens.begin(); it != antigens.end(); it++) {
+		ids.push_back(intern(*it));
+	}
+
+	return ids;
+}
+
+const std::string & KPDAntigenTable::name(KPDAntigen antigen) {
+
+	return antigenNames()[antigen];
+}
+
+std::vector<std::string> KPDAntigenTable::names(const std::vector<KPDAntigen> & antigens) {
+
+	std::vector<std::string> antigenNames;
+
+	for (std::vector<KPDAntigen>::const_iterator it = antigens.begin(); it != antigens.end(); it++) {
+		antigenNames.push_back(name(*it));
+	}
+
+	return antigenNames;
+}
+
+int KPDAntigenTable::size() {
+
+	return (int)antigenNames().size();
+}
+
+KPDHLA::KPDHLA() {
+
+	numberOfAntigens = 0;
+}
+
+KPDHLA::KPDHLA(const std::vector<std::string> & hla) {
+
+	numberOfAntigens = 0;
+
+	for (std::vector<std::string>::const_iterator it = hla.begin(); it != hla.end(); it++) {
+		add(*it);
+	}
+}
+
+KPDHLA::~KPDHLA() {
+
+}
+
+int KPDHLA::size() const {
+
+	return numberOfAntigens;
+}
+
+bool KPDHLA::empty() const {
+
+	return numberOfAntigens == 0;
+}
+
+KPDAntigen KPDHLA::operator[](int i) const {
+
+	return antigens[i];
+}
+
+const KPDAntigen * KPDHLA::begin() const {
+
+	return antigens;
+}
+
+const KPDAntigen * KPDHLA::end() const {
+
+	return antigens + numberOfAntigens;
+}
+
+void KPDHLA::add(KPDAntigen antigen) {
+
+	if (numberOfAntigens == HLA_MAX_ANTIGENS) {
+		std::cerr << "Too many HLA antigens (more than " << HLA_MAX_ANTIGENS << "); ignoring " << KPDAntigenTable::name(antigen) << std::endl;
+		return;
+	}
+
+	antigens[numberOfAntigens++] = antigen;
+}
+
+void KPDHLA::add(const std::string & antigen) {
+
+	add(KPDAntigenTable::intern(antigen));
+}
+
+void KPDHLA::clear() {
+
+	numberOfAntigens = 0;
+}
+
+bool KPDHLA::contains(KPDAntigen antigen) const {
+
+	for (int i = 0; i < numberOfAntigens; i++) {
+		if (antigens[i] == antigen) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+int KPDHLA::countShared(const KPDHLA & other) const {
+
+	int shared = 0;
+
+	for (int i = 0; i < numberOfAntigens; i++) {
+		for (int j = 0; j < other.numberOfAntigens; j++) {
+			if (antigens[i] == other.antigens[j]) {
+				shared++;
+			}
+		}
+	}
+
+	return shared;
+}
+
+std::vector<std::string> KPDHLA::toStrings() const {
+
+	std::vector<std::string> hla;
+
+	for (int i = 0; i < numberOfAntigens; i++) {
+		hla.push_back(KPDAntigenTable::name(antigens[i]));
+	}
+
+	return hla;
+}
+
+KPDAntigenSet::KPDAntigenSet() {
+
+	clear();
+}
+
+KPDAntigenSet::KPDAntigenSet(const KPDHLA & hla) {
+
+	clear();
+	add(hla);
+}
+
+KPDAntigenSet::~KPDAntigenSet() {
+
+}
+
+void KPDAntigenSet::add(KPDAntigen antigen) {
+
+	if (antigen >= 64 * HLA_SET_WORDS) {
+		exact = false;
+		return;
+	}
+
+	words[antigen >> 6] |= 1ULL << (antigen & 63);
+}
+
+void KPDAntigenSet::add(const KPDHLA & hla) {
+
+	for (const KPDAntigen * it = hla.begin(); it != hla.end(); it++) {
+		add(*it);
+	}
+}
+
+void KPDAntigenSet::clear() {
+
+	for (int i = 0; i < HLA_SET_WORDS; i++) {
+		words[i] = 0;
+	}
+
+	exact = true;
+}
+
+bool KPDAntigenSet::isExact() const {
+
+	return exact;
+}
+
+bool KPDAntigenSet::contains(KPDAntigen antigen) const {
+
+	if (antigen >= 64 * HLA_SET_WORDS) {
+		return false;
+	}
+
+	return (words[antigen >> 6] >> (antigen & 63)) & 1ULL;
+}
+
+bool KPDAntigenSet::intersects(const KPDAntigenSet & other) const {
+
+	unsigned long long common = 0;
+
+	for (int i = 0; i < HLA_SET_WORDS; i++) {
+		common |= words[i] & other.words[i];
+	}
+
+	return common != 0;
+}
+
+#endif
@@ -13,6 +13,7 @@ Functions Relating to a Match Run of a KPD Program
 #include "DD-Node.h"
 #include "DD-Match.h"
 #include "DD-RNG.h"
+#include "DD-ThreadPool.h"
 
 #include <string>
 #include <vector>
@@ -21,6 +22,14 @@ Functions Relating to a Match Run of a KPD Program
 #include <iostream>
 #include <fstream>
 #include <sstream>
+#include <algorithm>
+#include <functional>
+#include <chrono>
+
+// Cost model used to select expected utility methods (seconds per unit of work, measured on a release build)
+#define EU_SECONDS_PER_EXACT_OUTCOME 4.0e-8
+#define EU_SECONDS_PER_MONTE_CARLO_DRAW 1.2e-8
+#define EU_MINIMUM_MONTE_CARLO_SCENARIOS 64
 
 class KPDMatchRun {
 
@@ -54,8 +63,17 @@ private:
 
 	int timeBetweenSelectionAndTransplantation;
 
+	bool closedFormEU;
 	bool estimateEU;
 	int numberOfExpectedUtilityIterations;
+	double expectedUtilityHalfWidth;
+	bool antitheticSampling;
+	bool commonRandomNumbers;
+	bool selectEUMethod;
+	double expectedUtilityTimeBudget;
+	double expectedUtilityTimePlanned; // Planned by earlier calls in this match run, charged against the budget
+
+	KPDThreadPool * threadPool; // Owned by the simulation, so worker threads are kept between match runs
 
 	bool allowABBridgeDonors;
 
@@ -64,19 +82,37 @@ private:
 	double probPairAttrition;
 	double probBridgeDonorAttrition;
 
+	double pairAssumedProbability; // Probability that a pair is still available at transplantation
+
+	// Method and time (in seconds) used for each arrangement's expected utility
+	std::vector<KPDExpectedUtilityMethod> expectedUtilityMethods;
+	std::vector<double> expectedUtilityTimes;
 
 	//Helper Functions For Collecting Arrangements
 	int selectDonor(int donorNodeIndex, int candidateNodeIndex);
 	int indexOf(int id);
 	int getChild(int start, int v, std::vector<int> &visitedVector, std::vector<std::vector<bool> > &adjacency);
 	
-	//Helper Functions For Assigning Expected Utilities
+	//Helper Functions For Assigning Expected Utilities (must not modify match run; called concurrently)
+	KPDMatch * getMatch(int donorNodeID, int candidateNodeID, int donorIndex);
+	int getArrangementKey(std::vector<int> &arrangement);
+	bool hasFallbackOptions(std::vector<int> &arrangement);
+	double calculateUpperBoundUtility(std::vector<int> &arrangement);
+	void countRandomOutcomes(std::vector<int> &arrangement, int &randomNodes, int &randomDonors);
+	double predictExactTime(std::vector<int> &arrangement);
+	double predictMonteCarloTime(std::vector<int> &arrangement, int scenarios);
+	void selectExpectedUtilityMethods(std::vector<std::vector<int> > &arrangements, std::vector<int> &selectedArrangements, int threads, std::vector<KPDExpectedUtilityMethod> &methods, std::vector<int> &maximumScenarios);
+	void getEdgeSuccess(int donorNodeID, int candidateNodeID, double &probSuccess, double &expectedUtility);
+	double calculateClosedFormExpectedUtility(std::vector<int> &arrangement);
 	double calculateExpectedUtility(std::vector<int> &arrangement);
-	double estimateExpectedUtility(std::vector<int> &arrangement);
+	double estimateExpectedUtility(std::vector<int> &arrangement, CounterRNG &rngExpectedUtility, int maximumScenarios, int &numberOfScenarios);
+	double packCyclesAndChains(int n, int words, std::vector<unsigned long long> &nodeMasks, std::vector<double> &utilities, std::vector<double> &remainingUtilities);
+	void branchAndBoundPacking(int n, int words, std::vector<unsigned long long> &nodeMasks, std::vector<double> &utilities, std::vector<double> &remainingUtilities, int next, std::vector<unsigned long long> &usedNodes, double currentUtility, double &bestUtility);
+	void collectPartialCyclesAndChains(int nV, std::vector<std::vector<bool> > &adjacency, std::vector<KPDNodeType> &nodeTypes, std::vector<std::vector<KPDBloodType> > &bloodTypes, std::vector<std::vector<int> > &possibleCyclesOrChains);
 	double calculatePartialUtility(int nV, std::vector<std::vector<bool> > &adjacency, std::vector<std::vector<std::vector<double> > > &utility, std::vector<KPDNodeType> &nodeTypes, std::vector<std::vector<KPDBloodType> > &bloodTypes);
 
 	// Random Number Generators
-	RNG rngExpectedUtility;
+	int rngSeedExpectedUtility; // Each arrangement (or, with common random numbers, each node and donor) draws from its own counter-based stream under this seed
 
 	// Logs
 	std::stringstream matchRunLog;
@@ -88,7 +124,8 @@ public:
 		std::vector<KPDNodeType> nodeTypes,
 		std::vector<KPDStatus> availability, 
 		std::vector<KPDTransplant> transplantStatuses,
-		std::map<int, std::map<int, std::vector<KPDMatch *> > > matches);
+		std::map<int, std::map<int, std::vector<KPDMatch *> > > matches,
+		KPDThreadPool * pool);
 	~KPDMatchRun();
 
 	//Collect Arrangements
@@ -97,6 +134,12 @@ public:
 	//Assign Expected Utilities
 	void assignUtilitiesForCurrentMatchRun(std::vector<std::vector<int> > & currentMatchRunArrangements, std::vector<double> & assignedValueOfCurrentMatchRunArrangements);
 	void assignExpectedUtilitiesForCurrentMatchRun(std::vector<std::vector<int> > & currentMatchRunArrangements, std::vector<double> & assignedValueOfCurrentMatchRunArrangements);
+	void assignExpectedUtilitiesForSelectedArrangements(std::vector<std::vector<int> > & currentMatchRunArrangements, std::vector<int> & selectedArrangements, std::vector<double> & assignedValueOfCurrentMatchRunArrangements);
+	void assignUpperBoundUtilitiesForSelectedArrangements(std::vector<std::vector<int> > & currentMatchRunArrangements, std::vector<int> & selectedArrangements, std::vector<double> & assignedValueOfCurrentMatchRunArrangements);
+
+	// Arrangements whose expected utilities were not assigned in this match run are reported as cached
+	KPDExpectedUtilityMethod getExpectedUtilityMethod(int arrangementIndex);
+	double getExpectedUtilityTime(int arrangementIndex);
 
 	//Select Arrangements by Optimization
 	void getOptimalSolutionForCurrentMatchRun(std::vector<int> & optimalSolution, std::vector<std::vector<int> > & currentMatchRunArrangements, std::vector<double> & assignedValueOfCurrentMatchRunArrangements);
@@ -111,7 +154,8 @@ KPDMatchRun::KPDMatchRun(KPDParameters * params, int iteration, int mrTime,
 	std::vector<KPDNodeType> nodeTypes,
 	std::vector<KPDStatus> availability,
 	std::vector<KPDTransplant> transplantStatuses,
-	std::map<int, std::map<int, std::vector<KPDMatch *> > > matches) {
+	std::map<int, std::map<int, std::vector<KPDMatch *> > > matches,
+	KPDThreadPool * pool) {
 
 	currentIteration = iteration;
 	matchRunTime = mrTime;
@@ -124,20 +168,38 @@ KPDMatchRun::KPDMatchRun(KPDParameters * params, int iteration, int mrTime,
 	maximum = std::max(maxChainLength + 1, maxCycleSize);
 
 	timeBetweenSelectionAndTransplantation = params->getTimeBetweenSelectionAndTransplantation();
+	closedFormEU = params->getClosedFormExpectedUtility();
 	estimateEU = params->getEstimateExpectedUtility();
 
 	utilityScheme = params->getUtilityScheme();
 	allowABBridgeDonors = params->getAllowABBridgeDonors();
 
 	numberOfExpectedUtilityIterations = params->getNumberOfExpectedUtilityIterations();
+	expectedUtilityHalfWidth = params->getExpectedUtilityHalfWidth();
+	antitheticSampling = params->getAntitheticSampling();
+	commonRandomNumbers = params->getCommonRandomNumbers();
+	selectEUMethod = params->getSelectExpectedUtilityMethod();
+	expectedUtilityTimeBudget = params->getExpectedUtilityTimeBudget();
+	expectedUtilityTimePlanned = 0.0;
+	threadPool = pool;
 
 	probPairActiveToInactive = params->getProbPairActiveToInactive();
 	probPairInactiveToActive = params->getProbPairInactiveToActive();
 	probPairAttrition = params->getProbPairAttrition();
 	probBridgeDonorAttrition = params->getProbBridgeDonorAttrition();
 
+	pairAssumedProbability = 0;
+
+	double p = probPairActiveToInactive + probPairAttrition;
+
+	for (int k = 1; k <= timeBetweenSelectionAndTransplantation; k++) {
+		pairAssumedProbability += (p * std::pow(1 - p, k - 1));
+	}
+
+	pairAssumedProbability = 1 - pairAssumedProbability;
+
 	//Set Match Run Values
-	rngExpectedUtility.setSeed(params->getRNGSeedExpectedUtility() * currentIteration + matchRunTime);
+	rngSeedExpectedUtility = params->getRNGSeedExpectedUtility();
 
 	matchRunNumberOfPairs = 0;
 	matchRunNumberOfNDDs = 0;
@@ -392,23 +454,133 @@ void KPDMatchRun::assignUtilitiesForCurrentMatchRun(std::vector<std::vector<int>
 
 void KPDMatchRun::assignExpectedUtilitiesForCurrentMatchRun(std::vector<std::vector<int> > & currentMatchRunArrangements, std::vector<double> & assignedValueOfCurrentMatchRunArrangements) {
 
-	// Iterating through arrangements...
-	for (std::vector<std::vector<int> >::iterator itArrangements = currentMatchRunArrangements.begin(); itArrangements != currentMatchRunArrangements.end(); itArrangements++) {
-		
+	std::vector<int> selectedArrangements;
+
+	for (int i = 1; i <= (int)currentMatchRunArrangements.size(); i++) {
+		selectedArrangements.push_back(i - 1);
+	}
+
+	assignedValueOfCurrentMatchRunArrangements.assign(currentMatchRunArrangements.size(), 0.0);
+
+	assignExpectedUtilitiesForSelectedArrangements(currentMatchRunArrangements, selectedArrangements, assignedValueOfCurrentMatchRunArrangements);
+}
+
+void KPDMatchRun::assignExpectedUtilitiesForSelectedArrangements(std::vector<std::vector<int> > & currentMatchRunArrangements, std::vector<int> & selectedArrangements, 
+	std::vector<double> & assignedValueOfCurrentMatchRunArrangements) {
+
+	// Values of arrangements that are not selected are left untouched
+	int nArrangements = (int)selectedArrangements.size();
+
+	// Methods recorded by earlier calls in this match run are kept
+	if (expectedUtilityMethods.size() != currentMatchRunArrangements.size()) {
+		expectedUtilityMethods.assign(currentMatchRunArrangements.size(), EU_CACHED);
+		expectedUtilityTimes.assign(currentMatchRunArrangements.size(), 0.0);
+	}
+
+	// Methods are chosen before any work is done so that the choice does not depend on timing
+	std::vector<KPDExpectedUtilityMethod> methods(nArrangements, EU_EXACT);
+	std::vector<int> maximumScenarios(nArrangements, numberOfExpectedUtilityIterations);
+	std::vector<int> numberOfScenarios(nArrangements, 0);
+
+	selectExpectedUtilityMethods(currentMatchRunArrangements, selectedArrangements, threadPool->getNumberOfThreads(), methods, maximumScenarios);
+
+	// Arrangements are independent; each task writes only to its own slot
+	threadPool->parallelFor(nArrangements, [&](int selectedIndex) {
+
+		std::vector<int> & arrangement = currentMatchRunArrangements[selectedArrangements[selectedIndex]];
+
+		std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+
 		double eu = 0;
 
-		// ... and either estimate or calculate expected utility
-		if (estimateEU) {
-			eu = estimateExpectedUtility(*itArrangements);
+		if (methods[selectedIndex] == EU_CLOSED_FORM) {
+			eu = calculateClosedFormExpectedUtility(arrangement);
+		}
+		else if (methods[selectedIndex] == EU_MONTE_CARLO) {
+
+			// Stream depends only on (iteration, match run, arrangement), so estimates do not depend on the number of threads
+			CounterRNG rngExpectedUtility(rngSeedExpectedUtility, STREAM_EXPECTED_UTILITY, currentIteration, CounterRNG::entityKey(matchRunTime, getArrangementKey(arrangement)));
+
+			eu = estimateExpectedUtility(arrangement, rngExpectedUtility, maximumScenarios[selectedIndex], numberOfScenarios[selectedIndex]);
 		}
 		else {
-			eu = calculateExpectedUtility(*itArrangements);
+			eu = calculateExpectedUtility(arrangement);
 		}
 
-		assignedValueOfCurrentMatchRunArrangements.push_back(eu);
+		std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - startTime;
+
+		assignedValueOfCurrentMatchRunArrangements[selectedArrangements[selectedIndex]] = eu;
+		expectedUtilityMethods[selectedArrangements[selectedIndex]] = methods[selectedIndex];
+		expectedUtilityTimes[selectedArrangements[selectedIndex]] = elapsed.count();
+	});
+
+	matchRunLog << "Expected Utilities Assigned Using " << threadPool->getNumberOfThreads() << " Thread(s)" << std::endl;
+
+	if (nArrangements > 0) {
+
+		int methodCounts[3] = { 0, 0, 0 };
+		double methodTimes[3] = { 0.0, 0.0, 0.0 };
+
+		int totalScenarios = 0;
+
+		for (int i = 1; i <= nArrangements; i++) {
+
+			int selectedIndex = i - 1;
+
+			methodCounts[methods[selectedIndex]]++;
+			methodTimes[methods[selectedIndex]] += expectedUtilityTimes[selectedArrangements[selectedIndex]];
+
+			totalScenarios += numberOfScenarios[selectedIndex];
+		}
+
+		KPDExpectedUtilityMethod loggedMethods[3] = { EU_CLOSED_FORM, EU_EXACT, EU_MONTE_CARLO };
+
+		for (int m = 0; m < 3; m++) {
+			if (methodCounts[loggedMethods[m]] > 0) {
+				matchRunLog << KPDFunctions::expectedUtilityMethodToString(loggedMethods[m]) << " Expected Utilities: " << methodCounts[loggedMethods[m]] << " of " << nArrangements << " Arrangements";
+				matchRunLog << " (" << methodTimes[loggedMethods[m]] << " Seconds)" << std::endl;
+			}
+		}
+
+		if (methodCounts[EU_MONTE_CARLO] > 0) {
+			matchRunLog << "Monte Carlo Scenarios: " << totalScenarios << " (Average " << (double)totalScenarios / methodCounts[EU_MONTE_CARLO] << " Per Arrangement)" << std::endl;
+		}
+	}
+}
+
+void KPDMatchRun::assignUpperBoundUtilitiesForSelectedArrangements(std::vector<std::vector<int> > & currentMatchRunArrangements, std::vector<int> & selectedArrangements,
+	std::vector<double> & assignedValueOfCurrentMatchRunArrangements) {
+
+	if (expectedUtilityMethods.size() != currentMatchRunArrangements.size()) {
+		expectedUtilityMethods.assign(currentMatchRunArrangements.size(), EU_CACHED);
+		expectedUtilityTimes.assign(currentMatchRunArrangements.size(), 0.0);
+	}
+
+	for (std::vector<int>::iterator it = selectedArrangements.begin(); it != selectedArrangements.end(); it++) {
+		assignedValueOfCurrentMatchRunArrangements[*it] = calculateUpperBoundUtility(currentMatchRunArrangements[*it]);
+		expectedUtilityMethods[*it] = EU_UPPER_BOUND;
+		expectedUtilityTimes[*it] = 0.0;
 	}
 }
 
+KPDExpectedUtilityMethod KPDMatchRun::getExpectedUtilityMethod(int arrangementIndex) {
+
+	if (arrangementIndex < 0 || arrangementIndex >= (int)expectedUtilityMethods.size()) {
+		return EU_CACHED;
+	}
+
+	return expectedUtilityMethods[arrangementIndex];
+}
+
+double KPDMatchRun::getExpectedUtilityTime(int arrangementIndex) {
+
+	if (arrangementIndex < 0 || arrangementIndex >= (int)expectedUtilityTimes.size()) {
+		return 0.0;
+	}
+
+	return expectedUtilityTimes[arrangementIndex];
+}
+
 void KPDMatchRun::getOptimalSolutionForCurrentMatchRun(std::vector<int> & optimalSolution,
 	std::vector<std::vector<int> > & currentMatchRunArrangements, 
 	std::vector<double> & assignedValueOfCurrentMatchRunArrangements) {
@@ -561,6 +733,442 @@ int KPDMatchRun::indexOf(int id){
 }
 
 
+KPDMatch * KPDMatchRun::getMatch(int donorNodeID, int candidateNodeID, int donorIndex) {
+
+	// Unlike operator[], find() never inserts, so lookups are safe to share between threads
+	std::map<int, std::map<int, std::vector<KPDMatch *> > >::const_iterator itDonor = matchRunMatches.find(donorNodeID);
+	if (itDonor == matchRunMatches.end()) {
+		return NULL;
+	}
+
+	std::map<int, std::vector<KPDMatch *> >::const_iterator itCandidate = itDonor->second.find(candidateNodeID);
+	if (itCandidate == itDonor->second.end() || donorIndex >= (int)itCandidate->second.size()) {
+		return NULL;
+	}
+
+	return itCandidate->second[donorIndex];
+}
+
+int KPDMatchRun::getArrangementKey(std::vector<int> & arrangement) {
+
+	// FNV-1a hash of the node IDs, in order
+	unsigned int key = 2166136261u;
+
+	for (std::vector<int>::iterator it = arrangement.begin(); it != arrangement.end(); it++) {
+		key = (key ^ (unsigned int)(*it)) * 16777619u;
+	}
+
+	return (int)key;
+}
+
+bool KPDMatchRun::hasFallbackOptions(std::vector<int> & arrangement) {
+
+	int N = (int)arrangement.size();
+
+	bool chain = (matchRunNodeTypes[indexOf(arrangement[0])] != PAIR);
+
+	// Any arc between arrangement nodes other than the arrangement's own arcs creates a sub-cycle or sub-chain
+	// (arcs into the NDD are implicit and are ignored)
+	for (int i = 1; i <= N; i++) {
+
+		int donorNodeIndex = indexOf(arrangement[i - 1]);
+
+		for (int j = 1; j <= N; j++) {
+
+			int candidateNodeIndex = indexOf(arrangement[j - 1]);
+
+			if (i == j || (chain && j == 1)) {
+				continue;
+			}
+
+			bool arrangementArc = (j == i + 1) || (!chain && i == N && j == 1);
+
+			if (matchRunAdjacencyMatrix[donorNodeIndex + 1][candidateNodeIndex + 1] && !arrangementArc) {
+				return true;
+			}
+		}
+	}
+
+	return false;
+}
+
+double KPDMatchRun::calculateUpperBoundUtility(std::vector<int> & arrangement) {
+
+	// The packing in any scenario is worth at most the total of every cycle/chain realized in that scenario,
+	// so the sum of the closed-form expected utilities of all sub-cycles/chains bounds the expected utility
+	// (the deterministic utility is not a bound: a fallback may use a donor with higher utility)
+
+	int N = (int)arrangement.size();
+
+	std::vector<KPDNodeType> nodeTypes(N, PAIR);
+	std::vector<std::vector<KPDBloodType> > donorBloodTypes(N);
+	std::vector<std::vector<bool> > possibleAdjacency(1 + N, std::vector<bool>(1 + N, false));
+
+	std::vector<std::vector<double> > edgeProbSuccess(N, std::vector<double>(N, 0.0));
+	std::vector<std::vector<double> > edgeExpectedUtility(N, std::vector<double>(N, 0.0));
+
+	for (int i = 1; i <= N; i++) {
+
+		int arrangementIndex = i - 1;
+		int nodeIndex = indexOf(arrangement[arrangementIndex]);
+
+		nodeTypes[arrangementIndex] = matchRunNodeTypes[nodeIndex];
+
+		for (int k = 1; k <= matchRunNodes[nodeIndex]->getNumberOfDonors(); k++) {
+			donorBloodTypes[arrangementIndex].push_back(matchRunNodes[nodeIndex]->getDonorBT(k - 1));
+		}
+	}
+
+	for (int i = 1; i <= N; i++) {
+		for (int j = 1; j <= N; j++) {
+
+			if (i == j) {
+				continue;
+			}
+
+			//Implicit backward edges from PAIRs toward the NDD/BRIDGE node carry no utility
+			if (nodeTypes[i - 1] == PAIR && nodeTypes[j - 1] != PAIR) {
+				possibleAdjacency[i][j] = true;
+				edgeProbSuccess[i - 1][j - 1] = 1;
+			}
+			else if (nodeTypes[j - 1] == PAIR) {
+
+				getEdgeSuccess(arrangement[i - 1], arrangement[j - 1], edgeProbSuccess[i - 1][j - 1], edgeExpectedUtility[i - 1][j - 1]);
+
+				if (edgeProbSuccess[i - 1][j - 1] > 0) {
+					possibleAdjacency[i][j] = true;
+				}
+			}
+		}
+	}
+
+	std::vector<std::vector<int> > possibleCyclesOrChains;
+	collectPartialCyclesAndChains(N, possibleAdjacency, nodeTypes, donorBloodTypes, possibleCyclesOrChains);
+
+	double bound = 0;
+
+	for (std::vector<std::vector<int> >::iterator it = possibleCyclesOrChains.begin(); it != possibleCyclesOrChains.end(); it++) {
+
+		int length = (int)it->size();
+
+		double probNodes = 1;
+		for (int i = 1; i <= length; i++) {
+			if (nodeTypes[(*it)[i - 1]] == PAIR) {
+				probNodes = probNodes * pairAssumedProbability;
+			}
+		}
+
+		// Each edge contributes its utility only if every other edge also succeeds
+		double structureUtility = 0;
+
+		for (int i = 1; i <= length; i++) {
+
+			double edgeUtility = edgeExpectedUtility[(*it)[i - 1]][(*it)[i % length]];
+
+			for (int l = 1; l <= length; l++) {
+				if (l != i) {
+					edgeUtility = edgeUtility * edgeProbSuccess[(*it)[l - 1]][(*it)[l % length]];
+				}
+			}
+
+			structureUtility += edgeUtility;
+		}
+
+		bound += probNodes * structureUtility;
+	}
+
+	return bound;
+}
+
+void KPDMatchRun::countRandomOutcomes(std::vector<int> & arrangement, int & randomNodes, int & randomDonors) {
+
+	int N = (int)arrangement.size();
+
+	randomNodes = 0;
+	randomDonors = 0;
+
+	// Pairs may drop out, and every donor with an arc to a pair may fail
+	for (int i = 1; i <= N; i++) {
+
+		int donorNodeID = arrangement[i - 1];
+		int donorNodeIndex = indexOf(donorNodeID);
+
+		if (matchRunNodeTypes[donorNodeIndex] == PAIR) {
+			randomNodes++;
+		}
+
+		for (int j = 1; j <= N; j++) {
+
+			int candidateNodeID = arrangement[j - 1];
+			int candidateNodeIndex = indexOf(candidateNodeID);
+
+			if (i == j || matchRunNodeTypes[candidateNodeIndex] != PAIR || !matchRunAdjacencyMatrix[donorNodeIndex + 1][candidateNodeIndex + 1]) {
+				continue;
+			}
+
+			for (int k = 1; k <= matchRunNodes[donorNodeIndex]->getNumberOfDonors(); k++) {
+
+				KPDMatch * match = getMatch(donorNodeID, candidateNodeID, k - 1);
+
+				if (match != NULL && match->getAdjacency()) {
+					randomDonors++;
+				}
+			}
+		}
+	}
+}
+
+double KPDMatchRun::predictExactTime(std::vector<int> & arrangement) {
+
+	int N = (int)arrangement.size();
+
+	int randomNodes = 0;
+	int randomDonors = 0;
+
+	countRandomOutcomes(arrangement, randomNodes, randomDonors);
+
+	// Every combination of available pairs and successful donors is evaluated, each at a cost that grows with N^2
+	return std::pow(2.0, randomNodes + randomDonors) * N * N * EU_SECONDS_PER_EXACT_OUTCOME;
+}
+
+double KPDMatchRun::predictMonteCarloTime(std::vector<int> & arrangement, int scenarios) {
+
+	int N = (int)arrangement.size();
+
+	int randomNodes = 0;
+	int randomDonors = 0;
+
+	countRandomOutcomes(arrangement, randomNodes, randomDonors);
+
+	// Each scenario draws every node and donor once
+	return (double)scenarios * (N + randomDonors) * EU_SECONDS_PER_MONTE_CARLO_DRAW;
+}
+
+void KPDMatchRun::selectExpectedUtilityMethods(std::vector<std::vector<int> > & arrangements, std::vector<int> & selectedArrangements, int threads,
+	std::vector<KPDExpectedUtilityMethod> & methods, std::vector<int> & maximumScenarios) {
+
+	int nArrangements = (int)selectedArrangements.size();
+
+	std::vector<double> exactTimes(nArrangements, 0.0);
+	std::vector<double> monteCarloTimes(nArrangements, 0.0);
+
+	double plannedTime = 0.0;
+
+	for (int i = 1; i <= nArrangements; i++) {
+
+		int selectedIndex = i - 1;
+
+		std::vector<int> & arrangement = arrangements[selectedArrangements[selectedIndex]];
+
+		maximumScenarios[selectedIndex] = numberOfExpectedUtilityIterations;
+
+		// Arrangements without fallback options have a closed form
+		if (closedFormEU && !hasFallbackOptions(arrangement)) {
+			methods[selectedIndex] = EU_CLOSED_FORM;
+		}
+		else if (selectEUMethod) {
+
+			exactTimes[selectedIndex] = predictExactTime(arrangement);
+			monteCarloTimes[selectedIndex] = predictMonteCarloTime(arrangement, numberOfExpectedUtilityIterations);
+
+			// Use the exact value whenever it is predicted to be no slower than estimating it
+			if (exactTimes[selectedIndex] <= monteCarloTimes[selectedIndex]) {
+				methods[selectedIndex] = EU_EXACT;
+				plannedTime += exactTimes[selectedIndex];
+			}
+			else {
+				methods[selectedIndex] = EU_MONTE_CARLO;
+				plannedTime += monteCarloTimes[selectedIndex];
+			}
+		}
+		else if (estimateEU) {
+			methods[selectedIndex] = EU_MONTE_CARLO;
+		}
+		else {
+			methods[selectedIndex] = EU_EXACT;
+		}
+	}
+
+	if (!selectEUMethod || expectedUtilityTimeBudget <= 0) {
+		return;
+	}
+
+	// The budget is shared across threads and across calls in this match run (e.g., lazy evaluation rounds)
+	double availableTime = std::max(0.0, expectedUtilityTimeBudget * threads - expectedUtilityTimePlanned);
+
+	// Spend any slack on exact values, cheapest upgrades first
+	std::vector<std::pair<double, int> > upgrades;
+
+	for (int i = 1; i <= nArrangements; i++) {
+		if (methods[i - 1] == EU_MONTE_CARLO) {
+			upgrades.push_back(std::make_pair(exactTimes[i - 1] - monteCarloTimes[i - 1], i - 1));
+		}
+	}
+
+	std::sort(upgrades.begin(), upgrades.end());
+
+	for (std::vector<std::pair<double, int> >::iterator it = upgrades.begin(); it != upgrades.end(); it++) {
+
+		if (plannedTime + it->first > availableTime) {
+			break;
+		}
+
+		methods[it->second] = EU_EXACT;
+		plannedTime += it->first;
+	}
+
+	// Otherwise scale back Monte Carlo scenarios to fit
+	if (plannedTime > availableTime) {
+
+		double monteCarloTime = 0.0;
+
+		for (int i = 1; i <= nArrangements; i++) {
+			if (methods[i - 1] == EU_MONTE_CARLO) {
+				monteCarloTime += monteCarloTimes[i - 1];
+			}
+		}
+
+		if (monteCarloTime > 0) {
+
+			double fraction = std::max(0.0, availableTime - (plannedTime - monteCarloTime)) / monteCarloTime;
+
+			for (int i = 1; i <= nArrangements; i++) {
+				if (methods[i - 1] == EU_MONTE_CARLO) {
+					maximumScenarios[i - 1] = std::min(numberOfExpectedUtilityIterations, std::max(EU_MINIMUM_MONTE_CARLO_SCENARIOS, (int)(numberOfExpectedUtilityIterations * fraction)));
+				}
+			}
+		}
+
+		matchRunLog << "Expected Utility Time Budget Exceeded: Monte Carlo Scenarios Scaled Back" << std::endl;
+	}
+
+	// Charge the planned (not measured) time, so that later choices do not depend on timing
+	for (int i = 1; i <= nArrangements; i++) {
+		if (methods[i - 1] == EU_EXACT) {
+			expectedUtilityTimePlanned += exactTimes[i - 1];
+		}
+		else if (methods[i - 1] == EU_MONTE_CARLO) {
+			expectedUtilityTimePlanned += monteCarloTimes[i - 1] * maximumScenarios[i - 1] / numberOfExpectedUtilityIterations;
+		}
+	}
+}
+
+void KPDMatchRun::getEdgeSuccess(int donorNodeID, int candidateNodeID, double & probSuccess, double & expectedUtility) {
+
+	// Transplant uses the successful donor with the highest utility
+	std::vector<std::pair<double, double> > edgeDonors;
+
+	int donorNodeIndex = indexOf(donorNodeID);
+
+	for (int k = 1; k <= matchRunNodes[donorNodeIndex]->getNumberOfDonors(); k++) {
+
+		KPDMatch * match = getMatch(donorNodeID, candidateNodeID, k - 1);
+
+		if (match != NULL && match->getAdjacency()) {
+
+			double util = 1;
+			if (utilityScheme != UTILITY_TRANSPLANTS) {
+				util = match->getUtility(utilityScheme);
+			}
+
+			edgeDonors.push_back(std::pair<double, double>(util, match->getAssumedSuccessProbability()));
+		}
+	}
+
+	std::sort(edgeDonors.begin(), edgeDonors.end(), std::greater<std::pair<double, double> >());
+
+	double probAllFail = 1;
+	expectedUtility = 0;
+
+	for (std::vector<std::pair<double, double> >::iterator it = edgeDonors.begin(); it != edgeDonors.end(); it++) {
+		expectedUtility += it->first * it->second * probAllFail;
+		probAllFail = probAllFail * (1 - it->second);
+	}
+
+	probSuccess = 1 - probAllFail;
+}
+
+double KPDMatchRun::calculateClosedFormExpectedUtility(std::vector<int> & arrangement) {
+
+	int N = (int)arrangement.size();
+
+	bool chain = (matchRunNodeTypes[indexOf(arrangement[0])] != PAIR);
+
+	// Cycle: utility is realized only if every pair is available and every transplant succeeds
+	if (!chain) {
+
+		double probAvailable = std::pow(pairAssumedProbability, N);
+
+		std::vector<double> probSuccess(N, 0.0);
+		std::vector<double> expectedUtility(N, 0.0); // E[utility * 1{success}]
+
+		for (int i = 1; i <= N; i++) {
+			getEdgeSuccess(arrangement[i - 1], arrangement[i % N], probSuccess[i - 1], expectedUtility[i - 1]);
+		}
+
+		double eu = 0;
+
+		for (int i = 1; i <= N; i++) {
+
+			double term = expectedUtility[i - 1];
+
+			for (int j = 1; j <= N; j++) {
+				if (j != i) {
+					term = term * probSuccess[j - 1];
+				}
+			}
+
+			eu += term;
+		}
+
+		return probAvailable * eu;
+	}
+
+	// Chain: realized up to the first unavailable pair or failed transplant, and cut back to the last valid bridge donor
+	std::vector<double> probPrefix(N, 1.0); // Probability that the first j transplants are realized
+	std::vector<double> utilityPrefix(N, 0.0); // Expected utility of the first j transplants, given they are realized
+	std::vector<bool> validBridge(N, false);
+
+	for (int j = 1; j < N; j++) {
+
+		double probSuccess = 0;
+		double expectedUtility = 0;
+
+		getEdgeSuccess(arrangement[j - 1], arrangement[j], probSuccess, expectedUtility);
+
+		probPrefix[j] = probPrefix[j - 1] * pairAssumedProbability * probSuccess;
+		utilityPrefix[j] = utilityPrefix[j - 1] + (probSuccess > 0 ? expectedUtility / probSuccess : 0);
+
+		if (allowABBridgeDonors) {
+			validBridge[j] = true;
+		}
+		else {
+			int bridgeNodeIndex = indexOf(arrangement[j]);
+
+			for (int k = 1; k <= matchRunNodes[bridgeNodeIndex]->getNumberOfDonors(); k++) {
+				if (matchRunNodes[bridgeNodeIndex]->getDonorBT(k - 1) != BT_AB) {
+					validBridge[j] = true;
+					break;
+				}
+			}
+		}
+	}
+
+	// The chain ends at valid bridge j when prefix j is realized but the next valid prefix is not
+	double eu = 0;
+	double probNextValidPrefix = 0;
+
+	for (int j = N - 1; j >= 1; j--) {
+
+		if (validBridge[j]) {
+			eu += (probPrefix[j] - probNextValidPrefix) * utilityPrefix[j];
+			probNextValidPrefix = probPrefix[j];
+		}
+	}
+
+	return eu;
+}
+
 int KPDMatchRun::getChild(int lower, int current, std::vector<int> & visitedVector, std::vector<std::vector<bool> > & adjacency) {
 
 	int nV = (int)visitedVector.size() - 1;
@@ -572,17 +1180,6 @@ int KPDMatchRun::getChild(int lower, int current, std::vector<int> & visitedVect
 }
 
 double KPDMatchRun::calculateExpectedUtility(std::vector<int> & arrangement) {
-	
-	double pairAssumedProbability = 0;
-
-	int days = timeBetweenSelectionAndTransplantation;
-	double p = probPairActiveToInactive + probPairAttrition;
-
-	for (int k = 1; k <= days; k++) {
-		pairAssumedProbability += (p * std::pow(1 - p, k - 1));
-	}
-	
-	pairAssumedProbability = 1 - pairAssumedProbability;
 
 	int N = (int)arrangement.size();
 	double utility = 0;
@@ -607,7 +1204,8 @@ double KPDMatchRun::calculateExpectedUtility(std::vector<int> & arrangement) {
 
 				double probNode = 1;
 				
-				if (matchRunNodeTypes[nodeIndex] != PAIR) {
+				// Pairs may become unavailable before transplantation; NDDs and bridge donors remain available
+				if (matchRunNodeTypes[nodeIndex] == PAIR) {
 					if (availabilityFlags[arrangementIndex]) {
 						probNode = probNode * pairAssumedProbability;
 					}
@@ -615,6 +1213,9 @@ double KPDMatchRun::calculateExpectedUtility(std::vector<int> & arrangement) {
 						probNode = probNode * (1 - pairAssumedProbability);
 					}
 				}
+				else if (!availabilityFlags[arrangementIndex]) {
+					probNode = 0;
+				}
 
 				probSubset = probSubset * probNode;
 			}
@@ -642,15 +1243,17 @@ double KPDMatchRun::calculateExpectedUtility(std::vector<int> & arrangement) {
 
 						if (i != j) {							
 
-							if (matchRunAdjacencyMatrix[i][j] && matchRunNodeTypes[subsetCandidateIndex] == PAIR) {
+							if (matchRunAdjacencyMatrix[subsetDonorIndex + 1][subsetCandidateIndex + 1] && matchRunNodeTypes[subsetCandidateIndex] == PAIR) {
 
 								for (int k = 1; k <= matchRunNodes[subsetDonorIndex]->getNumberOfDonors(); k++) {
 
 									int donorIndex = k - 1;
 
+									KPDMatch * match = getMatch(subsetDonorID, subsetCandidateID, donorIndex);
+
 									if (availabilityFlags[arrangementSubsetDonorIndex] && 
 										availabilityFlags[arrangementSubsetCandidateIndex] && 
-										matchRunMatches[subsetDonorID][subsetCandidateID][donorIndex]->getAdjacency()) {
+										match != NULL && match->getAdjacency()) {
 
 										edgeSubsetDonorNodeIndices.push_back(arrangementSubsetDonorIndex);
 										edgeSubsetCandidateNodeIndices.push_back(arrangementSubsetCandidateIndex);
@@ -724,10 +1327,12 @@ double KPDMatchRun::calculateExpectedUtility(std::vector<int> & arrangement) {
 
 						int edgeSubsetDonorNodeID = arrangement[edgeSubsetDonorNodeIndex];
 						int edgeSubsetCandidateNodeID = arrangement[edgeSubsetCandidateNodeIndex];
+
+						KPDMatch * edgeMatch = getMatch(edgeSubsetDonorNodeID, edgeSubsetCandidateNodeID, edgeSubsetDonorIndex);
 						
 						if (edgeFlags[edgeIndex] != 0) {
 
-							probEdgeSubset = probEdgeSubset * matchRunMatches[edgeSubsetDonorNodeID][edgeSubsetCandidateNodeID][edgeSubsetDonorIndex]->getAssumedSuccessProbability();
+							probEdgeSubset = probEdgeSubset * edgeMatch->getAssumedSuccessProbability();
 														
 							reducedAdjacencyMatrix[edgeSubsetDonorNodeIndex + 1][edgeSubsetCandidateNodeIndex + 1] = true;
 
@@ -737,12 +1342,12 @@ double KPDMatchRun::calculateExpectedUtility(std::vector<int> & arrangement) {
 								}
 							}
 							else {
-								reducedUtilityMatrix[edgeSubsetDonorNodeIndex][edgeSubsetCandidateNodeIndex][edgeSubsetDonorIndex] = matchRunMatches[edgeSubsetDonorNodeID][edgeSubsetCandidateNodeID][edgeSubsetDonorIndex]->getUtility(utilityScheme);
+								reducedUtilityMatrix[edgeSubsetDonorNodeIndex][edgeSubsetCandidateNodeIndex][edgeSubsetDonorIndex] = edgeMatch->getUtility(utilityScheme);
 							}
 
 						}
 						else {
-							probEdgeSubset = probEdgeSubset * (1 - matchRunMatches[edgeSubsetDonorNodeID][edgeSubsetCandidateNodeID][edgeSubsetDonorIndex]->getAssumedSuccessProbability());
+							probEdgeSubset = probEdgeSubset * (1 - edgeMatch->getAssumedSuccessProbability());
 						}
 					}
 
@@ -762,140 +1367,377 @@ double KPDMatchRun::calculateExpectedUtility(std::vector<int> & arrangement) {
 	return utility;
 }
 
-double KPDMatchRun::estimateExpectedUtility(std::vector<int> & arrangement) {
+double KPDMatchRun::estimateExpectedUtility(std::vector<int> & arrangement, CounterRNG & rngExpectedUtility, int maximumScenarios, int & numberOfScenarios) {
 
-	double pairAssumedProbability = 0;
+	// Scenarios are simulated 64 at a time: bit l of each mask records the outcome in scenario l of the current batch
 
-	int days = timeBetweenSelectionAndTransplantation;
-	double p = probPairActiveToInactive + probPairAttrition;
+	int N = (int)arrangement.size();
 
-	for (int k = 1; k <= days; k++) {
-		pairAssumedProbability += (p * std::pow(1 - p, k - 1));
+	std::vector<KPDNodeType> nodeTypes(N, PAIR);
+	std::vector<std::vector<KPDBloodType> > donorBloodTypes(N);
+	std::vector<std::vector<bool> > possibleAdjacency(1 + N, std::vector<bool>(1 + N, false));
+
+	// Possible edges (with at least one matching donor) between arrangement nodes; donors of an edge are stored by decreasing utility
+	std::vector<std::vector<int> > edgeIndices(N, std::vector<int>(N, -1));
+	std::vector<int> edgeDonorStart(1, 0);
+	std::vector<double> donorProbabilities;
+	std::vector<double> donorUtilities;
+	std::vector<unsigned long long> donorStreamKeys;
+
+	for (int i = 1; i <= N; i++) {
+
+		int arrangementIndex = i - 1;
+		int nodeIndex = indexOf(arrangement[arrangementIndex]);
+
+		nodeTypes[arrangementIndex] = matchRunNodeTypes[nodeIndex];
+
+		for (int k = 1; k <= matchRunNodes[nodeIndex]->getNumberOfDonors(); k++) {
+			donorBloodTypes[arrangementIndex].push_back(matchRunNodes[nodeIndex]->getDonorBT(k - 1));
+		}
 	}
 
-	pairAssumedProbability = 1 - pairAssumedProbability;
+	for (int i = 1; i <= N; i++) {
 
-	int N = (int)arrangement.size();
-	double expUtility = 0;
+		int arrangementDonorIndex = i - 1;
+		int donorNodeID = arrangement[arrangementDonorIndex];
+		int numDonors = (int)donorBloodTypes[arrangementDonorIndex].size();
 
-	for (int sims = 1; sims <= numberOfExpectedUtilityIterations; sims++) {
+		for (int j = 1; j <= N; j++) {
 
-		//Initialize random matrices
-		std::vector<std::vector<bool> > randomAdjacencyMatrix(1 + N, std::vector<bool>(1 + N, false));
+			int arrangementCandidateIndex = j - 1;
+			int candidateNodeID = arrangement[arrangementCandidateIndex];
 
-		std::vector<std::vector<std::vector<double> > > randomUtilityMatrix(N, std::vector<std::vector<double> >(N, std::vector<double>(1, 0.0)));
+			if (i == j) {
+				continue;
+			}
 
-		std::vector<bool> randomAvailabilities(N, false);
+			//Implicit backward edges from PAIRs toward the NDD/BRIDGE node always exist when both nodes are available
+			if (nodeTypes[arrangementDonorIndex] == PAIR && nodeTypes[arrangementCandidateIndex] != PAIR) {
+				possibleAdjacency[i][j] = true;
+			}
+			else if (nodeTypes[arrangementCandidateIndex] == PAIR) {
 
-		std::vector<KPDNodeType> randomNodeTypes(N, PAIR);
-		std::vector<std::vector<KPDBloodType> > randomDonorBloodTypes(N, std::vector<KPDBloodType>(1, BT_AB));
-		
-		//Simulate pair availabilities, retrive donor information
-		for (int i = 1; i <= N; i++) {
+				// (Utility, (Probability, Donor Index))
+				std::vector<std::pair<double, std::pair<double, int> > > edgeDonors;
+
+				for (int k = 1; k <= numDonors; k++) {
+
+					KPDMatch * match = getMatch(donorNodeID, candidateNodeID, k - 1);
+
+					if (match != NULL && match->getAdjacency()) {
+
+						double util = 1;
+						if (utilityScheme != UTILITY_TRANSPLANTS) {
+							util = match->getUtility(utilityScheme);
+						}
+
+						edgeDonors.push_back(std::make_pair(util, std::make_pair(match->getAssumedSuccessProbability(), k - 1)));
+					}
+				}
+
+				if (!edgeDonors.empty()) {
 
-			int arrangementIndex = i - 1;
-			int nodeID = arrangement[arrangementIndex];
-			int nodeIndex = indexOf(nodeID);
+					std::sort(edgeDonors.begin(), edgeDonors.end(), std::greater<std::pair<double, std::pair<double, int> > >());
 
-			int numDonors = matchRunNodes[nodeIndex]->getNumberOfDonors();
+					for (std::vector<std::pair<double, std::pair<double, int> > >::iterator it = edgeDonors.begin(); it != edgeDonors.end(); it++) {
+						donorUtilities.push_back(it->first);
+						donorProbabilities.push_back(it->second.first);
+						donorStreamKeys.push_back(CounterRNG::entityKey(matchRunTime, donorNodeID, candidateNodeID, it->second.second));
+					}
 
-			//Store node type
-			randomNodeTypes[arrangementIndex] = matchRunNodeTypes[nodeIndex];
-			randomDonorBloodTypes[arrangementIndex].assign(numDonors, BT_AB);
+					edgeIndices[arrangementDonorIndex][arrangementCandidateIndex] = (int)edgeDonorStart.size() - 1;
+					edgeDonorStart.push_back((int)donorUtilities.size());
 
-			//Randomly generate candidate availability for PAIRs
-			if (matchRunNodeTypes[nodeIndex] == PAIR) {
-				if (rngExpectedUtility.runif() < pairAssumedProbability) {
-					randomAvailabilities[arrangementIndex] = true;
+					possibleAdjacency[i][j] = true;
 				}
 			}
-			else {
-				randomAvailabilities[arrangementIndex] = true;
+		}
+	}
+
+	// Every cycle/chain that can be realized is a sub-cycle/chain of the possible graph
+	std::vector<std::vector<int> > possibleCyclesOrChains;
+	collectPartialCyclesAndChains(N, possibleAdjacency, nodeTypes, donorBloodTypes, possibleCyclesOrChains);
+
+	int nStructures = (int)possibleCyclesOrChains.size();
+	if (nStructures == 0) {
+		numberOfScenarios = 0;
+		return 0;
+	}
+
+	// Node masks of cycles/chains, used when competing ones are packed; words per cycle/chain cover every arrangement node
+	int words = (N + 63) / 64;
+
+	std::vector<unsigned long long> structureNodes(nStructures * words, 0);
+	std::vector<int> structureEdgeStart(1, 0);
+	std::vector<int> structureEdges;
+
+	for (int q = 1; q <= nStructures; q++) {
+
+		std::vector<int> & cycleOrChain = possibleCyclesOrChains[q - 1];
+		int length = (int)cycleOrChain.size();
+
+		for (int i = 1; i <= length; i++) {
+
+			int donorNode = cycleOrChain[i - 1];
+			int candidateNode = cycleOrChain[i % length];
+
+			structureNodes[(q - 1) * words + donorNode / 64] |= (1ULL << (donorNode % 64));
+
+			// Implicit backward edges (end of chain) carry no randomness and no utility
+			if (edgeIndices[donorNode][candidateNode] != -1) {
+				structureEdges.push_back(edgeIndices[donorNode][candidateNode]);
 			}
 		}
 
-		//Iterate through donor-candidate combinations and randomly generate realized transplants
+		structureEdgeStart.push_back((int)structureEdges.size());
+	}
+
+	int nEdges = (int)edgeDonorStart.size() - 1;
+	int nDonors = (int)donorUtilities.size();
+
+	// Working masks are allocated once and reused for every batch
+	std::vector<unsigned long long> nodeMasks(N, 0);
+	std::vector<unsigned long long> edgeMasks(nEdges, 0);
+	std::vector<unsigned long long> bestDonorMasks(nDonors, 0);
+	std::vector<unsigned long long> structureMasks(nStructures, 0);
+
+	std::vector<unsigned long long> laneStructureNodes(nStructures * words, 0);
+	std::vector<double> laneStructureUtilities(nStructures, 0.0);
+	std::vector<double> laneRemainingUtilities(nStructures, 0.0);
+
+	// By default every draw comes from the arrangement's stream; with common random numbers, each node and donor
+	// has its own stream, so overlapping arrangements see the same outcomes in the same scenarios
+	std::vector<CounterRNG> entityStreams;
+	std::vector<CounterRNG *> nodeStreams(N, &rngExpectedUtility);
+	std::vector<CounterRNG *> donorStreams(nDonors, &rngExpectedUtility);
+
+	if (commonRandomNumbers) {
+
+		entityStreams.resize(N + nDonors);
+
+		for (int i = 1; i <= N; i++) {
+			entityStreams[i - 1].setStream(rngSeedExpectedUtility, STREAM_NODE_AVAILABILITY, currentIteration, CounterRNG::entityKey(matchRunTime, arrangement[i - 1]));
+			nodeStreams[i - 1] = &entityStreams[i - 1];
+		}
+
+		for (int d = 1; d <= nDonors; d++) {
+			entityStreams[N + d - 1].setStream(rngSeedExpectedUtility, STREAM_DONOR_SUCCESS, currentIteration, donorStreamKeys[d - 1]);
+			donorStreams[d - 1] = &entityStreams[N + d - 1];
+		}
+	}
+
+	double expUtility = 0;
+
+	// Batch means give the variance of the estimate (antithetic pairs never straddle batches)
+	int scenarios = 0;
+	int batches = 0;
+	double sumBatchMeans = 0;
+	double sumSquaredBatchMeans = 0;
+
+	while (scenarios < maximumScenarios) {
+
+		int lanes = std::min(64, maximumScenarios - scenarios);
+		unsigned long long laneMask = (lanes == 64) ? ~0ULL : ((1ULL << lanes) - 1);
+
+		double batchUtility = 0;
+
+		//Simulate pair availabilities
 		for (int i = 1; i <= N; i++) {
+			if (nodeTypes[i - 1] == PAIR) {
+				nodeMasks[i - 1] = nodeStreams[i - 1]->bernoulliMask(pairAssumedProbability, lanes, antitheticSampling);
+			}
+			else {
+				nodeMasks[i - 1] = laneMask;
+			}
+		}
 
-			int arrangementDonorIndex = i - 1;
-			int arrangementDonorNodeID = arrangement[i - 1];
-			int arrangementDonorNodeIndex = indexOf(arrangementDonorNodeID);
+		//Simulate transplants; in each scenario the selected donor is the successful donor with the highest utility
+		for (int e = 1; e <= nEdges; e++) {
 
-			int numDonors = matchRunNodes[arrangementDonorNodeIndex]->getNumberOfDonors();
+			unsigned long long covered = 0;
 
-			for (int j = 1; j <= N; j++) {
+			for (int d = edgeDonorStart[e - 1]; d < edgeDonorStart[e]; d++) {
 
-				int arrangementCandidateIndex = j - 1;
-				int arrangementCandidateNodeID = arrangement[j - 1];
-				int arrangementCandidateNodeIndex = indexOf(arrangementCandidateNodeID);
+				unsigned long long success = donorStreams[d]->bernoulliMask(donorProbabilities[d], lanes, antitheticSampling);
 
-				randomUtilityMatrix[arrangementDonorIndex][arrangementCandidateIndex].assign(numDonors, 0.0);
+				bestDonorMasks[d] = success & ~covered;
+				covered |= success;
+			}
 
-				if (i != j) {
+			edgeMasks[e - 1] = covered;
+		}
 
-					//If both nodes are available
-					if (randomAvailabilities[arrangementDonorIndex] && randomAvailabilities[arrangementCandidateIndex]) {
+		//A cycle/chain is realized when all of its nodes are available and all of its edges succeed
+		unsigned long long realizedOnce = 0;
+		unsigned long long realizedTwice = 0;
 
-						//If donor node is a PAIR and candidate node is a NDD or BRIDGE_DONOR, 
-						//insert implicit backward edges from all available donors toward the NDD/BRIDGE node, and set the adjacency matrix to true
-						if (randomNodeTypes[arrangementDonorIndex] == PAIR && randomNodeTypes[arrangementCandidateIndex] != PAIR) {
-							randomAdjacencyMatrix[i][j] = true;
-						}
-						//If candidate node is a PAIR, generate random matches
-						else if (randomNodeTypes[arrangementCandidateIndex] == PAIR) {
+		for (int q = 1; q <= nStructures; q++) {
 
-							//Iterate through donors
-							for (int k = 1; k <= numDonors; k++) {
+			unsigned long long realized = laneMask;
 
-								int donorIndex = k - 1;
+			for (std::vector<int>::iterator it = possibleCyclesOrChains[q - 1].begin(); it != possibleCyclesOrChains[q - 1].end(); it++) {
+				realized &= nodeMasks[*it];
+			}
 
-								// For existing original matches, and for donors that are available, randomly generate matches
-								if (matchRunMatches[arrangementDonorNodeID][arrangementCandidateNodeID][donorIndex]->getAdjacency()) {
-
-									if (rngExpectedUtility.runif() < matchRunMatches[arrangementDonorNodeID][arrangementCandidateNodeID][donorIndex]->getAssumedSuccessProbability()) {
-										
-										if (utilityScheme == UTILITY_TRANSPLANTS) {
-											if (matchRunNodeTypes[arrangementCandidateNodeIndex] == PAIR) {
-												randomUtilityMatrix[arrangementDonorNodeIndex][arrangementCandidateNodeIndex][donorIndex] = 1;
-											}
-										}
-										else {
-											randomUtilityMatrix[arrangementDonorNodeIndex][arrangementCandidateNodeIndex][donorIndex] = matchRunMatches[arrangementDonorNodeID][arrangementCandidateNodeID][donorIndex]->getUtility(utilityScheme);
-										}
-
-										// Set adjacency matrix to true
-										randomAdjacencyMatrix[i][j] = true;
-									}
-								}
+			for (int l = structureEdgeStart[q - 1]; l < structureEdgeStart[q]; l++) {
+				realized &= edgeMasks[structureEdges[l]];
+			}
+
+			structureMasks[q - 1] = realized;
+
+			realizedTwice |= realizedOnce & realized;
+			realizedOnce |= realized;
+		}
+
+		//Scenarios with a single realized cycle/chain are summed across lanes
+		unsigned long long singleLanes = realizedOnce & ~realizedTwice;
+
+		for (int q = 1; q <= nStructures; q++) {
+
+			unsigned long long realized = structureMasks[q - 1] & singleLanes;
+
+			if (realized != 0) {
+				for (int l = structureEdgeStart[q - 1]; l < structureEdgeStart[q]; l++) {
+
+					int e = structureEdges[l];
+
+					for (int d = edgeDonorStart[e]; d < edgeDonorStart[e + 1]; d++) {
+						batchUtility += donorUtilities[d] * KPDFunctions::countBits(realized & bestDonorMasks[d]);
+					}
+				}
+			}
+		}
+
+		//Scenarios with competing cycles/chains are resolved one lane at a time
+		unsigned long long competingLanes = realizedTwice;
+
+		while (competingLanes != 0) {
+
+			unsigned long long lane = competingLanes & (~competingLanes + 1);
+			competingLanes ^= lane;
+
+			int nRealized = 0;
+
+			for (int q = 1; q <= nStructures; q++) {
+
+				if (structureMasks[q - 1] & lane) {
+
+					double util = 0;
+
+					for (int l = structureEdgeStart[q - 1]; l < structureEdgeStart[q]; l++) {
+
+						int e = structureEdges[l];
+
+						for (int d = edgeDonorStart[e]; d < edgeDonorStart[e + 1]; d++) {
+							if (bestDonorMasks[d] & lane) {
+								util += donorUtilities[d];
 							}
 						}
 					}
+
+					for (int w = 0; w < words; w++) {
+						laneStructureNodes[nRealized * words + w] = structureNodes[(q - 1) * words + w];
+					}
+					laneStructureUtilities[nRealized] = util;
+					nRealized++;
 				}
 			}
+
+			batchUtility += packCyclesAndChains(nRealized, words, laneStructureNodes, laneStructureUtilities, laneRemainingUtilities);
 		}
 
-		//After generating matrices, calculate utility
-		double partialUtil = calculatePartialUtility(N, randomAdjacencyMatrix, randomUtilityMatrix, randomNodeTypes, randomDonorBloodTypes);
-		expUtility += partialUtil;
+		expUtility += batchUtility;
+		scenarios += lanes;
+		batches++;
+
+		double batchMean = batchUtility / lanes;
+		sumBatchMeans += batchMean;
+		sumSquaredBatchMeans += batchMean * batchMean;
 
+		// Stop early once the 95% confidence interval is narrow enough (at least 4 batches are needed for a variance estimate)
+		if (expectedUtilityHalfWidth > 0 && batches >= 4) {
+
+			double variance = std::max(0.0, (sumSquaredBatchMeans - sumBatchMeans * sumBatchMeans / batches) / (batches - 1));
+
+			if (1.96 * sqrt(variance / batches) <= expectedUtilityHalfWidth) {
+				break;
+			}
+		}
 	}
 
-	//Expected utility is the average of the calculated utility values over the number of iterations
-	return expUtility / numberOfExpectedUtilityIterations;
+	numberOfScenarios = scenarios;
+
+	//Expected utility is the average of the calculated utility values over the simulated scenarios
+	return expUtility / scenarios;
 
 }
 
-double KPDMatchRun::calculatePartialUtility(int nV, std::vector<std::vector<bool> > & adjacency, 
-	std::vector<std::vector<std::vector<double> > > & utility,
-	std::vector<KPDNodeType> & nodeTypes, 
-	std::vector<std::vector<KPDBloodType> > & donorBloodTypes) {
+double KPDMatchRun::packCyclesAndChains(int n, int words, std::vector<unsigned long long> & nodeMasks, std::vector<double> & utilities, std::vector<double> & remainingUtilities) {
 
-	std::vector<std::vector<int> > possibleCyclesOrChains;
-	std::vector<double> utilityOfPossibleCyclesOrChains;
+	// Best total utility over disjoint subsets of the first n cycles/chains (remainingUtilities is working space of size >= n)
+	// Cycle/chain q covers the nodes set in nodeMasks[q * words], ..., nodeMasks[q * words + words - 1], so any number of nodes fits
+	double remaining = 0;
 
-	int maximum = std::max(maxChainLength + 1, maxCycleSize);
+	for (int q = n; q >= 1; q--) {
+		remaining += utilities[q - 1];
+		remainingUtilities[q - 1] = remaining;
+	}
 
-	double utilityValue = 0;
+	double bestUtility = 0;
+	std::vector<unsigned long long> usedNodes(words, 0);
+
+	branchAndBoundPacking(n, words, nodeMasks, utilities, remainingUtilities, 0, usedNodes, 0, bestUtility);
+
+	return bestUtility;
+}
+
+void KPDMatchRun::branchAndBoundPacking(int n, int words, std::vector<unsigned long long> & nodeMasks, std::vector<double> & utilities, std::vector<double> & remainingUtilities, 
+	int next, std::vector<unsigned long long> & usedNodes, double currentUtility, double & bestUtility) {
+
+	if (currentUtility > bestUtility) {
+		bestUtility = currentUtility;
+	}
+
+	// Choose the next cycle/chain to add from next, ..., n - 1
+	for (int q = next; q < n; q++) {
+
+		// Prune once even adding every remaining cycle/chain cannot improve on the best packing
+		if (currentUtility + remainingUtilities[q] <= bestUtility) {
+			return;
+		}
+
+		// Skip cycles/chains that share a node with the current packing
+		bool disjoint = true;
+
+		for (int w = 0; w < words; w++) {
+			if (nodeMasks[q * words + w] & usedNodes[w]) {
+				disjoint = false;
+				break;
+			}
+		}
+
+		if (disjoint) {
+
+			for (int w = 0; w < words; w++) {
+				usedNodes[w] |= nodeMasks[q * words + w];
+			}
+
+			branchAndBoundPacking(n, words, nodeMasks, utilities, remainingUtilities, q + 1, usedNodes, currentUtility + utilities[q], bestUtility);
+
+			// Nodes of a disjoint cycle/chain were all unused before it was added
+			for (int w = 0; w < words; w++) {
+				usedNodes[w] ^= nodeMasks[q * words + w];
+			}
+		}
+	}
+}
+
+void KPDMatchRun::collectPartialCyclesAndChains(int nV, std::vector<std::vector<bool> > & adjacency,
+	std::vector<KPDNodeType> & nodeTypes,
+	std::vector<std::vector<KPDBloodType> > & donorBloodTypes,
+	std::vector<std::vector<int> > & possibleCyclesOrChains) {
+
+	int maximum = std::max(maxChainLength + 1, maxCycleSize);
 
 	int start = 1;
 	std::vector<int> visitedVec(nV + 1, 0);
@@ -938,8 +1780,6 @@ double KPDMatchRun::calculatePartialUtility(int nV, std::vector<std::vector<bool
 						}
 					}
 
-					double tempUtil = 0;
-
 					if (multipleNDDCheck == 1 && (int)potentialCycleOrChain.size() <= maxChainLength + 1) {
 
 						while (index > 0) {
@@ -955,7 +1795,7 @@ double KPDMatchRun::calculatePartialUtility(int nV, std::vector<std::vector<bool
 
 							int bridgeDonorNodeIndex = *(potentialCycleOrChain.end() - 1);
 
-							for (int k = 1; k < donorBloodTypes[bridgeDonorNodeIndex].size(); k++) {
+							for (int k = 1; k <= (int)donorBloodTypes[bridgeDonorNodeIndex].size(); k++) {
 
 								int donorIndex = k - 1;
 
@@ -967,127 +1807,104 @@ double KPDMatchRun::calculatePartialUtility(int nV, std::vector<std::vector<bool
 						}
 
 						if (allowABBridgeDonors || nonABBridgeDonor) {
-							
-							for (std::vector<int>::iterator it = potentialCycleOrChain.begin(); it != potentialCycleOrChain.end() - 1; it++) {
-								double selectedDonorUtility = 0;
-
-								int donorNodeIndex = *it;
-								int candidateNodeIndex = *(it + 1);
-
-								for (int k = 1; k < utility[donorNodeIndex][candidateNodeIndex].size(); k++) {
-
-									int donorIndex = k - 1;
-
-									if (utility[donorNodeIndex][candidateNodeIndex][donorIndex] > selectedDonorUtility) {
-										selectedDonorUtility = utility[donorNodeIndex][candidateNodeIndex][donorIndex];
-									}
-								}
-								tempUtil += selectedDonorUtility;
-							}
-
-							possibleCyclesOrChains.push_back(std::vector<int>(potentialCycleOrChain));
-							utilityOfPossibleCyclesOrChains.push_back(tempUtil);
+							possibleCyclesOrChains.push_back(potentialCycleOrChain);
 						}
 					}
 
 					else if ((int)potentialCycleOrChain.size() <= maxCycleSize) {
+						possibleCyclesOrChains.push_back(potentialCycleOrChain);
+					}
+				}
 
-						for (std::vector<int>::iterator it = potentialCycleOrChain.begin(); it != potentialCycleOrChain.end() - 1; it++) {
-							
-							double selectedDonorUtility = 0;
+				if ((int)stack_vec.size() >= maximum)
+					v = -1;
+				else
+					v = getChild(start, v, visitedVec, adjacency);
 
-							int donorNodeIndex = *it;
-							int candidateNodeIndex = *(it + 1);
+			}
+		}
+		start++;
+	}
+}
 
-							for (int k = 1; k < utility[donorNodeIndex][candidateNodeIndex].size(); k++) {
+double KPDMatchRun::calculatePartialUtility(int nV, std::vector<std::vector<bool> > & adjacency, 
+	std::vector<std::vector<std::vector<double> > > & utility,
+	std::vector<KPDNodeType> & nodeTypes, 
+	std::vector<std::vector<KPDBloodType> > & donorBloodTypes) {
 
-								int donorIndex = k - 1;
+	std::vector<std::vector<int> > possibleCyclesOrChains;
+	std::vector<double> utilityOfPossibleCyclesOrChains;
 
-								if (utility[donorNodeIndex][candidateNodeIndex][donorIndex] > selectedDonorUtility) {
-									selectedDonorUtility = utility[donorNodeIndex][candidateNodeIndex][donorIndex];
-								}
-							}
-							tempUtil += selectedDonorUtility;
-						}
+	double utilityValue = 0;
 
-						double selectedDonorUtility = 0;
+	collectPartialCyclesAndChains(nV, adjacency, nodeTypes, donorBloodTypes, possibleCyclesOrChains);
 
-						int donorNodeIndex = *(potentialCycleOrChain.end() - 1);
-						int candidateNodeIndex = *(potentialCycleOrChain.begin());
+	for (std::vector<std::vector<int> >::iterator itCycleOrChain = possibleCyclesOrChains.begin(); itCycleOrChain != possibleCyclesOrChains.end(); itCycleOrChain++) {
 
-						for (int k = 1; k < utility[donorNodeIndex][candidateNodeIndex].size(); k++) {
+		double tempUtil = 0;
 
-							int donorIndex = k - 1;
+		int length = (int)itCycleOrChain->size();
+		bool chain = (nodeTypes[*(itCycleOrChain->begin())] != PAIR);
 
-							if (utility[donorNodeIndex][candidateNodeIndex][donorIndex] > selectedDonorUtility) {
-								selectedDonorUtility = utility[donorNodeIndex][candidateNodeIndex][donorIndex];
-							}
-						}
-						tempUtil += selectedDonorUtility;
+		// Sum over transplants (the backward edge that closes a chain is not a transplant)
+		for (int i = 1; i <= length; i++) {
 
-						possibleCyclesOrChains.push_back(std::vector<int>(potentialCycleOrChain));
-						utilityOfPossibleCyclesOrChains.push_back(tempUtil);
+			if (chain && i == length) {
+				break;
+			}
 
-					}
-				}
+			double selectedDonorUtility = 0;
 
-				if ((int)stack_vec.size() >= maximum)
-					v = -1;
-				else
-					v = getChild(start, v, visitedVec, adjacency);
+			int donorNodeIndex = (*itCycleOrChain)[i - 1];
+			int candidateNodeIndex = (*itCycleOrChain)[i % length];
+
+			for (int k = 1; k <= (int)utility[donorNodeIndex][candidateNodeIndex].size(); k++) {
 
+				int donorIndex = k - 1;
+
+				if (utility[donorNodeIndex][candidateNodeIndex][donorIndex] > selectedDonorUtility) {
+					selectedDonorUtility = utility[donorNodeIndex][candidateNodeIndex][donorIndex];
+				}
 			}
+			tempUtil += selectedDonorUtility;
 		}
-		start++;
+
+		utilityOfPossibleCyclesOrChains.push_back(tempUtil);
 	}
 
-	if (possibleCyclesOrChains.size() == 1) {
+	int nPossibleCycles = (int)possibleCyclesOrChains.size();
+
+	if (nPossibleCycles == 1) {
 		utilityValue = utilityOfPossibleCyclesOrChains.at(0);
 	}
 
-	else if (possibleCyclesOrChains.size() > 1) {
+	else if (nPossibleCycles > 1) {
 
-		int nPossibleCycles = (int)possibleCyclesOrChains.size();
+		// Order cycles/chains by decreasing utility so that good packings are found early and bounds prune more
+		std::vector<std::pair<double, int> > order;
+		for (int q = 1; q <= nPossibleCycles; q++) {
+			order.push_back(std::pair<double, int>(utilityOfPossibleCyclesOrChains[q - 1], q - 1));
+		}
+		std::sort(order.begin(), order.end(), std::greater<std::pair<double, int> >());
 
-		// Iterate through all possible combinations of cycles/chains
-		for (int c = 1; c < pow((double)2, nPossibleCycles); c++) {
-			
-			double tempU = 0;
+		int words = (nV + 63) / 64;
 
-			std::vector<int> cycleFlags(nPossibleCycles, 0);
-			std::vector<int> checkUniqueness(nV, 0);
+		std::vector<unsigned long long> nodeMasks(nPossibleCycles * words, 0);
+		std::vector<double> utilities(nPossibleCycles, 0.0);
+		std::vector<double> remainingUtilities(nPossibleCycles, 0.0);
 
-			int numberOfCyclesInPossibleSolutions = KPDFunctions::setFlags(c, 0, cycleFlags);
+		for (int q = 1; q <= nPossibleCycles; q++) {
 
-			bool validSolution = true;
+			int cycleIndex = order[q - 1].second;
 
-			// Iterate through all possible cycles
-			for (int q = 0; q < nPossibleCycles; q++) {
-				
-				// If cycle appears in combination
-				if (cycleFlags[q] == 1) {
-					
-					tempU += utilityOfPossibleCyclesOrChains[q];
-					
-					// Iterate through the nodes
-					for (std::vector<int>::iterator it = possibleCyclesOrChains.at(q).begin(); it != possibleCyclesOrChains.at(q).end(); ++it) {
-						checkUniqueness[*it]++;
-						if (checkUniqueness[*it] > 1) {
-							validSolution = false;
-							break;
-						}
-					}
-
-					if (!validSolution) {
-						break;
-					}
-				}
+			for (std::vector<int>::iterator it = possibleCyclesOrChains[cycleIndex].begin(); it != possibleCyclesOrChains[cycleIndex].end(); it++) {
+				nodeMasks[(q - 1) * words + *it / 64] |= (1ULL << (*it % 64));
 			}
 
-			if (validSolution && tempU > utilityValue) {
-				utilityValue = tempU;
-			}
+			utilities[q - 1] = order[q - 1].first;
 		}
+
+		utilityValue = packCyclesAndChains(nPossibleCycles, words, nodeMasks, utilities, remainingUtilities);
 	}
 
 	return utilityValue;
@@ -19,6 +19,7 @@ private:
 
 	int nodeID;
 
+	// Donor and candidate profiles are not changed once formed, so they are shared by all copies of a node (and not owned by the node)
 	std::vector<KPDDonor *> nodeDonors;
 	KPDCandidate * nodeCandidate;
 
@@ -70,20 +71,22 @@ public:
 	std::string getCandidateString();
 	std::string getDonorString(int donorIndex);
 
-	//Copy Constructor
+	//Copy Constructor (shallow; the copy shares the donor and candidate profiles)
 	KPDNode * copy();
 	
 };
 
 KPDNode::KPDNode(){
 
+	nodeCandidate = NULL;
 }
 
 KPDNode::KPDNode(int id, int arrivalTime, KPDDonor * donor){
 
 	nodeID = id;	
 		
-	nodeDonors.push_back(donor->copy());
+	nodeDonors.push_back(donor);
+	nodeCandidate = NULL;
 
 	nodeArrivalTime = arrivalTime;
 	nodeType = NDD;
@@ -94,11 +97,8 @@ KPDNode::KPDNode(int id, int arrivalTime, std::vector<KPDDonor *> donors, KPDCan
 
 	nodeID = id;
 
-	for (std::vector<KPDDonor *>::iterator it = donors.begin(); it != donors.end(); it++) {
-		nodeDonors.push_back((*it)->copy());
-	}
-
-	nodeCandidate = candidate->copy();
+	nodeDonors = donors;
+	nodeCandidate = candidate;
 
 	nodeArrivalTime = arrivalTime;
 	nodeType = PAIR;
@@ -107,7 +107,6 @@ KPDNode::KPDNode(int id, int arrivalTime, std::vector<KPDDonor *> donors, KPDCan
 KPDNode::~KPDNode(){
 
 	nodeDonors.clear();
-	delete nodeCandidate;
 }
 
 int KPDNode::getID() {
@@ -119,7 +118,7 @@ void KPDNode::setID(int id){
 }
 
 KPDCandidate * KPDNode::getCandidate() {
-	return nodeCandidate->copy();
+	return nodeCandidate;
 }
 
 KPDBloodType KPDNode::getCandidateBT() {
@@ -135,18 +134,11 @@ void KPDNode::setCandidate(KPDCandidate * candidate) {
 }
 
 KPDDonor * KPDNode::getDonor(int donorIndex) {	
-	return nodeDonors.at(donorIndex)->copy();
+	return nodeDonors.at(donorIndex);
 }
 
 std::vector<KPDDonor *> KPDNode::getDonors() {
-
-	std::vector<KPDDonor *> donors;
-
-	for (std::vector<KPDDonor *>::iterator it = nodeDonors.begin(); it != nodeDonors.end(); it++) {
-		donors.push_back((*it)->copy());
-	}
-
-	return donors;
+	return nodeDonors;
 }
 
 int KPDNode::getNumberOfDonors() {
@@ -159,11 +151,7 @@ KPDBloodType KPDNode::getDonorBT(int donorIndex) {
 
 void KPDNode::setDonors(std::vector<KPDDonor *> donors) {
 
-	nodeDonors.clear();
-
-	for (std::vector<KPDDonor *>::iterator it = donors.begin(); it != donors.end(); it++) {
-		nodeDonors.push_back(*it);
-	}
+	nodeDonors = donors;
 }
 
 KPDNodeType KPDNode::getType() {
@@ -200,18 +188,12 @@ KPDNode * KPDNode::copy(){
 
 	KPDNode * copyNode;
 
+	// Copies share the donor and candidate profiles
 	if (nodeType == NDD){
-		copyNode = new KPDNode(nodeID, nodeArrivalTime, nodeDonors.front()->copy());
+		copyNode = new KPDNode(nodeID, nodeArrivalTime, nodeDonors.front());
 	}
 	else {
-
-		std::vector<KPDDonor *> copiedDonors;
-
-		for (std::vector<KPDDonor*>::iterator it = nodeDonors.begin(); it != nodeDonors.end(); it++) {
-			copiedDonors.push_back((*it)->copy());
-		}
-
-		copyNode = new KPDNode(nodeID, nodeArrivalTime, copiedDonors, nodeCandidate->copy());
+		copyNode = new KPDNode(nodeID, nodeArrivalTime, nodeDonors, nodeCandidate);
 	}
 
 	return copyNode;
@@ -54,8 +54,17 @@ private:
 	int praEligibilityMax;
 
 	//Additional Options
+	bool closedFormExpectedUtility;
 	bool estimateExpectedUtility;
 	int numberOfExpectedUtilityIterations;
+	double expectedUtilityHalfWidth;
+	bool antitheticSampling;
+	bool commonRandomNumbers;
+	bool selectExpectedUtilityMethod;
+	double expectedUtilityTimeBudget;
+	bool lazyExpectedUtility;
+	bool cacheExpectedUtility;
+	int numberOfThreads;
 
 	bool reserveODonorsForOCandidates;	
 	bool allowABBridgeDonors;
@@ -68,6 +77,9 @@ private:
 	std::string fileSurvivalParameters;
 	std::string fileDeceasedDonors;
 	std::string fileWaitingListCandidates;
+	bool useDataCache;
+	std::string fileDataCache;
+	bool streamDeceasedDonorsAndWaitlist;
 	
 	//Random Number Generator Seeds
 	int rngSeedSelection;
@@ -130,8 +142,17 @@ public:
 	double getPRAEligibilityMax();
 	
 	//Additional Options
+	bool getClosedFormExpectedUtility();
 	bool getEstimateExpectedUtility();
 	int getNumberOfExpectedUtilityIterations();
+	double getExpectedUtilityHalfWidth();
+	bool getAntitheticSampling();
+	bool getCommonRandomNumbers();
+	bool getSelectExpectedUtilityMethod();
+	double getExpectedUtilityTimeBudget();
+	bool getLazyExpectedUtility();
+	bool getCacheExpectedUtility();
+	int getNumberOfThreads();
 
 	bool getReserveODonorsForOCandidates();
 	bool getAllowABBridgeDonors();	
@@ -144,6 +165,9 @@ public:
 	std::string getFileSurvivalParameters();
 	std::string getFileDeceasedDonors();
 	std::string getFileWaitingListCandidates();
+	bool getUseDataCache();
+	std::string getFileDataCache();
+	bool getStreamDeceasedDonorsAndWaitlist();
 
 	//Random Number Generator Seeds
 	int getRNGSeedSelection();
@@ -203,8 +227,17 @@ KPDParameters::KPDParameters(){
 	praEligibilityMax = 98;
 	
 	//Additional Options
+	closedFormExpectedUtility = true;
 	estimateExpectedUtility = false;
 	numberOfExpectedUtilityIterations = 100;
+	expectedUtilityHalfWidth = 0.0; // 0 always uses the full number of iterations
+	antitheticSampling = false;
+	commonRandomNumbers = false;
+	selectExpectedUtilityMethod = false;
+	expectedUtilityTimeBudget = 0.0; // Seconds per match run; 0 places no limit
+	lazyExpectedUtility = false;
+	cacheExpectedUtility = true;
+	numberOfThreads = 0; // 0 uses all available hardware threads
 
 	reserveODonorsForOCandidates = false;
 	allowABBridgeDonors = false;
@@ -217,6 +250,9 @@ KPDParameters::KPDParameters(){
 	fileSurvivalParameters = "SurvivalParameters.csv";
 	fileDeceasedDonors = "DeceasedDonors.csv";
 	fileWaitingListCandidates = "CandidateWaitlist.csv";
+	useDataCache = true;
+	fileDataCache = ".ddcache";
+	streamDeceasedDonorsAndWaitlist = false;
 	
 	//Random Number Generators Seeds
 	rngSeedSelection = 9007900;
@@ -302,11 +338,38 @@ bool KPDParameters::processParameters(std::string & fileName){
 			if (tokenOne.compare("#praeligibilitymax") == 0) { praEligibilityMax = atoi(tokenTwo.c_str()); }
 
 			//Additional Options
+			if (tokenOne.compare("#closedformexpectedutility") == 0) {
+				if (tokenTwo.compare("TRUE") == 0) { closedFormExpectedUtility = true; }
+				else if (tokenTwo.compare("FALSE") == 0) { closedFormExpectedUtility = false; }
+			}
 			if (tokenOne.compare("#estimateexpectedutility") == 0){
 				if (tokenTwo.compare("TRUE") == 0){ estimateExpectedUtility = true; }
 				else if (tokenTwo.compare("FALSE") == 0){ estimateExpectedUtility = false; }
 			}
 			if (tokenOne.compare("#numberofexpectedutilityiterations") == 0){ numberOfExpectedUtilityIterations = atoi(tokenTwo.c_str()); }
+			if (tokenOne.compare("#expectedutilityhalfwidth") == 0) { expectedUtilityHalfWidth = atof(tokenTwo.c_str()); }
+			if (tokenOne.compare("#antitheticsampling") == 0) {
+				if (tokenTwo.compare("TRUE") == 0) { antitheticSampling = true; }
+				else if (tokenTwo.compare("FALSE") == 0) { antitheticSampling = false; }
+			}
+			if (tokenOne.compare("#commonrandomnumbers") == 0) {
+				if (tokenTwo.compare("TRUE") == 0) { commonRandomNumbers = true; }
+				else if (tokenTwo.compare("FALSE") == 0) { commonRandomNumbers = false; }
+			}
+			if (tokenOne.compare("#selectexpectedutilitymethod") == 0) {
+				if (tokenTwo.compare("TRUE") == 0) { selectExpectedUtilityMethod = true; }
+				else if (tokenTwo.compare("FALSE") == 0) { selectExpectedUtilityMethod = false; }
+			}
+			if (tokenOne.compare("#expectedutilitytimebudget") == 0) { expectedUtilityTimeBudget = atof(tokenTwo.c_str()); }
+			if (tokenOne.compare("#lazyexpectedutility") == 0) {
+				if (tokenTwo.compare("TRUE") == 0) { lazyExpectedUtility = true; }
+				else if (tokenTwo.compare("FALSE") == 0) { lazyExpectedUtility = false; }
+			}
+			if (tokenOne.compare("#cacheexpectedutility") == 0) {
+				if (tokenTwo.compare("TRUE") == 0) { cacheExpectedUtility = true; }
+				else if (tokenTwo.compare("FALSE") == 0) { cacheExpectedUtility = false; }
+			}
+			if (tokenOne.compare("#numberofthreads") == 0) { numberOfThreads = atoi(tokenTwo.c_str()); }
 			
 			if (tokenOne.compare("#reserveodonorsforocandidates") == 0){
 				if (tokenTwo.compare("TRUE") == 0){ reserveODonorsForOCandidates = true; }
@@ -328,6 +391,15 @@ bool KPDParameters::processParameters(std::string & fileName){
 			if (tokenOne.compare("#filesurvivalparameters") == 0) { fileSurvivalParameters = tokenTwo; }
 			if (tokenOne.compare("#filedeceaseddonors") == 0) { fileDeceasedDonors = tokenTwo; }
 			if (tokenOne.compare("#filewaitinglistcandidates") == 0) { fileWaitingListCandidates = tokenTwo; }
+			if (tokenOne.compare("#usedatacache") == 0) {
+				if (tokenTwo.compare("TRUE") == 0) { useDataCache = true; }
+				else if (tokenTwo.compare("FALSE") == 0) { useDataCache = false; }
+			}
+			if (tokenOne.compare("#filedatacache") == 0) { fileDataCache = tokenTwo; }
+			if (tokenOne.compare("#streamdeceaseddonorsandwaitlist") == 0) {
+				if (tokenTwo.compare("TRUE") == 0) { streamDeceasedDonorsAndWaitlist = true; }
+				else if (tokenTwo.compare("FALSE") == 0) { streamDeceasedDonorsAndWaitlist = false; }
+			}
 
 			//Random Number Generator Seeds
 			if (tokenOne.compare("#rngseedselection") == 0) { rngSeedSelection = atoi(tokenTwo.c_str()); }
@@ -427,9 +499,57 @@ void KPDParameters::printLog(){
 	parametersLog << "Additional Options" << std::endl;
 	parametersLog << "------------------" << std::endl << std::endl;
 	
-	if (estimateExpectedUtility == true){
-		parametersLog << "Number of Expected Utility Iterations: " << numberOfExpectedUtilityIterations << std::endl;
+	if (closedFormExpectedUtility == false) {
+		parametersLog << "Do Not ";
+	}
+	parametersLog << "Use Closed-Form Expected Utility for Cycles and Chains Without Fallback Options" << std::endl;
+
+	if (selectExpectedUtilityMethod == true) {
+		parametersLog << "Select Between Exact and Monte Carlo Expected Utility Per Arrangement" << std::endl;
+
+		if (expectedUtilityTimeBudget > 0) {
+			parametersLog << "Expected Utility Time Budget Per Match Run (Seconds): " << expectedUtilityTimeBudget << std::endl;
+		}
+	}
+
+	if (estimateExpectedUtility == true || selectExpectedUtilityMethod == true){
+		if (expectedUtilityHalfWidth > 0) {
+			parametersLog << "Maximum Number of Expected Utility Iterations: " << numberOfExpectedUtilityIterations << std::endl;
+			parametersLog << "Stop When 95% Confidence Interval Half-Width Is Below: " << expectedUtilityHalfWidth << std::endl;
+		}
+		else {
+			parametersLog << "Number of Expected Utility Iterations: " << numberOfExpectedUtilityIterations << std::endl;
+		}
+
+		if (antitheticSampling == false) {
+			parametersLog << "Do Not ";
+		}
+		parametersLog << "Use Antithetic Sampling" << std::endl;
+
+		if (commonRandomNumbers == false) {
+			parametersLog << "Do Not ";
+		}
+		parametersLog << "Use Common Random Numbers Across Arrangements" << std::endl;
+	}
+
+	if (lazyExpectedUtility == false) {
+		parametersLog << "Do Not ";
+	}
+	parametersLog << "Evaluate Expected Utilities Only for Arrangements That Could Be Selected" << std::endl;
+
+	if (cacheExpectedUtility == false) {
+		parametersLog << "Do Not ";
+	}
+	parametersLog << "Reuse Expected Utilities of Unchanged Arrangements Across Match Runs" << std::endl;
+
+	parametersLog << "Threads Used for Expected Utility Calculations: ";
+	if (numberOfThreads <= 0) {
+		parametersLog << "All Available";
 	}
+	else {
+		parametersLog << numberOfThreads;
+	}
+	parametersLog << std::endl;
 	
 	if (reserveODonorsForOCandidates == false){
 		parametersLog << "Do Not ";
@@ -459,6 +579,15 @@ void KPDParameters::printLog(){
 	parametersLog << "Survival Parameters File Name: " << fileSurvivalParameters << std::endl;
 	parametersLog << "Deceased Donors File Name: " << fileDeceasedDonors << std::endl;
 	parametersLog << "Waiting List Candidates File Name: " << fileWaitingListCandidates << std::endl;
+	if (useDataCache) {
+		parametersLog << "Data Cache File Name: " << fileDataCache << std::endl;
+	}
+	else {
+		parametersLog << "Data Cache: Not Used" << std::endl;
+	}
+	if (streamDeceasedDonorsAndWaitlist) {
+		parametersLog << "Deceased Donors and Waitlist Candidates: Streamed in Time Order" << std::endl;
+	}
 
 	parametersLog << std::endl;
 
@@ -592,6 +721,10 @@ double KPDParameters::getPRAEligibilityMax(){
 	return praEligibilityMax;
 }
 
+bool KPDParameters::getClosedFormExpectedUtility() {
+	return closedFormExpectedUtility;
+}
+
 bool KPDParameters::getEstimateExpectedUtility(){
 	return estimateExpectedUtility;
 }
@@ -600,6 +733,38 @@ int KPDParameters::getNumberOfExpectedUtilityIterations(){
 	return numberOfExpectedUtilityIterations;
 }
 
+double KPDParameters::getExpectedUtilityHalfWidth() {
+	return expectedUtilityHalfWidth;
+}
+
+bool KPDParameters::getAntitheticSampling() {
+	return antitheticSampling;
+}
+
+bool KPDParameters::getCommonRandomNumbers() {
+	return commonRandomNumbers;
+}
+
+bool KPDParameters::getSelectExpectedUtilityMethod() {
+	return selectExpectedUtilityMethod;
+}
+
+double KPDParameters::getExpectedUtilityTimeBudget() {
+	return expectedUtilityTimeBudget;
+}
+
+bool KPDParameters::getLazyExpectedUtility() {
+	return lazyExpectedUtility;
+}
+
+bool KPDParameters::getCacheExpectedUtility() {
+	return cacheExpectedUtility;
+}
+
+int KPDParameters::getNumberOfThreads() {
+	return numberOfThreads;
+}
+
 bool KPDParameters::getReserveODonorsForOCandidates(){
 	return reserveODonorsForOCandidates;
 }
@@ -636,6 +801,18 @@ std::string KPDParameters::getFileWaitingListCandidates() {
 	return fileWaitingListCandidates;
 }
 
+bool KPDParameters::getUseDataCache() {
+	return useDataCache;
+}
+
+std::string KPDParameters::getFileDataCache() {
+	return fileDataCache;
+}
+
+bool KPDParameters::getStreamDeceasedDonorsAndWaitlist() {
+	return streamDeceasedDonorsAndWaitlist;
+}
+
 int KPDParameters::getRNGSeedSelection() {
 	return rngSeedSelection;
 }
@@ -6,7 +6,12 @@ Defines a Random-Number Generator for Simulations
 #ifndef RNG_H
 #define RNG_H
 
+#include "DD-Enums-Functions.h"
+
 #include <math.h>
+#include <string.h>
+
+#include <vector>
 
 /* This uses a portable implementation for generating U(0,1) due to Schrage */
 #define RAND_A 16807
@@ -15,11 +20,17 @@ Defines a Random-Number Generator for Simulations
 #define RAND_R 2836
 #define RAND_SCALE (1.0 / RAND_M)
 
+/* Batched draws use xoshiro256**, seeded from the same seed but independent of the U(0,1) sequence above */
+#define RAND_BATCH 64
+
 class RNG {
 
 private:
 	int seed; //Default seed is 1, which will be initialized in the constructor function;
 
+	unsigned long long batchState[4];
+	unsigned long long nextBatchBits();
+
 public:
 	RNG();
 	~RNG();
@@ -29,6 +40,71 @@ public:
 	double runif(double l, double u);	// This will return an exponentially distributed random variable with hazard rate lambda;
 	double rexp(double lambda);
 
+	// Batched draws: n U(0,1) values, n exponential values with hazard rate lambda,
+	// and a mask whose bit l (l < lanes) is set with probability prob (with antithetic, bit l + 1 uses 1 - U of bit l)
+	void fill(double * values, int n);
+	void fillExp(double * values, int n, double lambda);
+	unsigned long long bernoulliMask(double prob, int lanes, bool antithetic = false);
+
+	// Converts random bits to U(0,1) values, never 0 or 1 (a branch-free loop the compiler can vectorize)
+	static void bitsToUniform(const unsigned long long * bits, double * values, int n);
+};
+
+/* Counter-based generator (Philox4x32-10): the n-th draw of a stream is a fixed function of
+(seed, stream, iteration, entity, n), so draws do not depend on execution order or thread count */
+class CounterRNG {
+
+private:
+	unsigned int key[2];		// (Seed, Stream)
+	unsigned int counter[4];	// (Iteration, Entity (Low), Entity (High), Block of 4 Draws)
+
+	unsigned int block[4];
+	int blockPosition;
+
+	void generateBlock();
+
+public:
+	CounterRNG();
+	CounterRNG(int seed, KPDRandomStream stream, int iteration, unsigned long long entity);
+	~CounterRNG();
+
+	void setStream(int seed, KPDRandomStream stream, int iteration, unsigned long long entity);
+
+	unsigned int nextUInt();
+	double runif();
+	double runif(double l, double u);
+	double rexp(double lambda);
+
+	// Batched draws, consuming the stream exactly as the same number of calls to runif() would
+	void fill(double * values, int n);
+	void fillExp(double * values, int n, double lambda);
+	unsigned long long bernoulliMask(double prob, int lanes, bool antithetic = false);
+
+	// Combines identifiers (e.g., match run time, donor node, candidate node, donor index) into one entity key
+	static unsigned long long entityKey(int a, int b, int c = 0, int d = 0);
+};
+
+/* Walker alias table for drawing from a discrete distribution with one U(0,1) value in constant time.
+Outcomes have the same probabilities as KPDFunctions::retrieveDiscreteSampleIndex (the last outcome takes any
+probability left over), but a given U(0,1) value generally maps to a different outcome */
+class KPDAliasTable {
+
+private:
+	std::vector<double> keepProbability;	// Probability of keeping the outcome of column i, rather than its alias
+	std::vector<int> alias;
+
+public:
+	KPDAliasTable();
+	KPDAliasTable(const std::vector<double> & probs);
+	~KPDAliasTable();
+
+	void setProbabilities(const std::vector<double> & probs);
+
+	int size() const;
+	int sample(double u) const;
+
+	// Probabilities of the outcomes drawn from the given probabilities (with the leftover probability given to the last outcome)
+	static std::vector<double> impliedProbabilities(const std::vector<double> & probs);
 };
 
 RNG::RNG() {
@@ -46,6 +122,17 @@ void RNG::setSeed(int s) {
 		seed = 1;
 	else
 		seed = s;
+
+	// SplitMix64 expands the seed into the batch state (which is never all zero)
+	unsigned long long z = (unsigned int)seed;
+
+	for (int i = 0; i < 4; i++) {
+		z += 0x9E3779B97F4A7C15ULL;
+		unsigned long long x = z;
+		x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+		x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+		batchState[i] = x ^ (x >> 31);
+	}
 }
 
 int RNG::getSeed() {
@@ -75,4 +162,332 @@ double RNG::rexp(double lambda) {
 	return -log(runif()) / lambda;
 }
 
+unsigned long long RNG::nextBatchBits() {
+
+	unsigned long long x = batchState[1] * 5;
+	unsigned long long result = ((x << 7) | (x >> 57)) * 9;
+	unsigned long long t = batchState[1] << 17;
+
+	batchState[2] ^= batchState[0];
+	batchState[3] ^= batchState[1];
+	batchState[1] ^= batchState[2];
+	batchState[0] ^= batchState[3];
+	batchState[2] ^= t;
+	batchState[3] = (batchState[3] << 45) | (batchState[3] >> 19);
+
+	return result;
+}
+
+void RNG::fill(double * values, int n) {
+
+	unsigned long long bits[RAND_BATCH];
+
+	for (int start = 0; start < n; start += RAND_BATCH) {
+
+		int m = (n - start < RAND_BATCH) ? n - start : RAND_BATCH;
+
+		for (int i = 0; i < m; i++) {
+			bits[i] = nextBatchBits();
+		}
+
+		bitsToUniform(bits, values + start, m);
+	}
+}
+
+void RNG::fillExp(double * values, int n, double lambda) {
+
+	fill(values, n);
+
+	for (int i = 0; i < n; i++) {
+		values[i] = -log(values[i]) / lambda;
+	}
+}
+
+unsigned long long RNG::bernoulliMask(double prob, int lanes, bool antithetic) {
+
+	if (prob <= 0) {
+		return 0;
+	}
+
+	unsigned long long all = (lanes >= 64) ? ~0ULL : ((1ULL << lanes) - 1);
+
+	if (prob >= 1) {
+		return all;
+	}
+
+	// Compare the top 53 bits against the threshold, so no conversion to double is needed
+	unsigned long long threshold = (unsigned long long)(prob * 9007199254740992.0);
+
+	unsigned long long mask = 0;
+
+	for (int l = 0; l < lanes; l++) {
+
+		unsigned long long u = nextBatchBits() >> 11;
+
+		mask |= (unsigned long long)(u < threshold) << l;
+
+		// 1 - U corresponds to the complement of the bits
+		if (antithetic && l + 1 < lanes) {
+			l++;
+			mask |= (unsigned long long)((9007199254740991ULL - u) < threshold) << l;
+		}
+	}
+
+	return mask;
+}
+
+void RNG::bitsToUniform(const unsigned long long * bits, double * values, int n) {
+
+	for (int i = 0; i < n; i++) {
+
+		// Top 52 bits as the mantissa of a double in [1, 2), shifted to the midpoint of its interval
+		unsigned long long pattern = 0x3FF0000000000000ULL | (bits[i] >> 12);
+
+		double d;
+		memcpy(&d, &pattern, sizeof(double));
+
+		values[i] = (d - 1.0) + 1.1102230246251565e-16;
+	}
+}
+
+CounterRNG::CounterRNG() {
+
+	setStream(1, STREAM_EXPECTED_UTILITY, 0, 0);
+}
+
+CounterRNG::CounterRNG(int seed, KPDRandomStream stream, int iteration, unsigned long long entity) {
+
+	setStream(seed, stream, iteration, entity);
+}
+
+CounterRNG::~CounterRNG() {
+
+}
+
+void CounterRNG::setStream(int seed, KPDRandomStream stream, int iteration, unsigned long long entity) {
+
+	key[0] = (unsigned int)seed;
+	key[1] = (unsigned int)stream;
+
+	counter[0] = (unsigned int)iteration;
+	counter[1] = (unsigned int)entity;
+	counter[2] = (unsigned int)(entity >> 32);
+	counter[3] = 0;
+
+	blockPosition = 4; // Generate on first draw
+}
+
+void CounterRNG::generateBlock() {
+
+	unsigned int c[4] = { counter[0], counter[1], counter[2], counter[3] };
+	unsigned int k[2] = { key[0], key[1] };
+
+	for (int round = 1; round <= 10; round++) {
+
+		unsigned long long product0 = 0xD2511F53ULL * c[0];
+		unsigned long long product1 = 0xCD9E8D57ULL * c[2];
+
+		unsigned int next[4] = {
+			(unsigned int)(product1 >> 32) ^ c[1] ^ k[0], (unsigned int)product1,
+			(unsigned int)(product0 >> 32) ^ c[3] ^ k[1], (unsigned int)product0 };
+
+		c[0] = next[0]; c[1] = next[1]; c[2] = next[2]; c[3] = next[3];
+
+		k[0] += 0x9E3779B9u;
+		k[1] += 0xBB67AE85u;
+	}
+
+	block[0] = c[0]; block[1] = c[1]; block[2] = c[2]; block[3] = c[3];
+	blockPosition = 0;
+
+	counter[3]++;
+}
+
+unsigned int CounterRNG::nextUInt() {
+
+	if (blockPosition == 4) {
+		generateBlock();
+	}
+
+	return block[blockPosition++];
+}
+
+double CounterRNG::runif() {
+
+	// Midpoint of one of 2^32 equal intervals; never 0 or 1
+	return (nextUInt() + 0.5) * (1.0 / 4294967296.0);
+}
+
+double CounterRNG::runif(double l, double u) {
+
+	return l + (u - l)*runif();
+}
+
+double CounterRNG::rexp(double lambda) {
+
+	return -log(runif()) / lambda;
+}
+
+void CounterRNG::fill(double * values, int n) {
+
+	for (int i = 0; i < n; i++) {
+		values[i] = (nextUInt() + 0.5) * (1.0 / 4294967296.0);
+	}
+}
+
+void CounterRNG::fillExp(double * values, int n, double lambda) {
+
+	fill(values, n);
+
+	for (int i = 0; i < n; i++) {
+		values[i] = -log(values[i]) / lambda;
+	}
+}
+
+unsigned long long CounterRNG::bernoulliMask(double prob, int lanes, bool antithetic) {
+
+	// runif() < prob exactly when the raw draw is below prob * 2^32 - 0.5 (and 1 - runif() < prob when above (1 - prob) * 2^32 - 0.5)
+	double lower = prob * 4294967296.0 - 0.5;
+	double upper = (1 - prob) * 4294967296.0 - 0.5;
+
+	unsigned long long mask = 0;
+
+	for (int l = 0; l < lanes; l++) {
+
+		double x = (double)nextUInt();
+
+		mask |= (unsigned long long)(x < lower) << l;
+
+		if (antithetic && l + 1 < lanes) {
+			l++;
+			mask |= (unsigned long long)(x > upper) << l;
+		}
+	}
+
+	return mask;
+}
+
+unsigned long long CounterRNG::entityKey(int a, int b, int c, int d) {
+
+	unsigned long long values[4] = { (unsigned int)a, (unsigned int)b, (unsigned int)c, (unsigned int)d };
+	unsigned long long z = 0;
+
+	// SplitMix64 finalizer applied to each value in turn
+	for (int i = 0; i < 4; i++) {
+		z += values[i] + 0x9E3779B97F4A7C15ULL;
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+		z = z ^ (z >> 31);
+	}
+
+	return z;
+}
+
+KPDAliasTable::KPDAliasTable() {
+
+}
+
+KPDAliasTable::KPDAliasTable(const std::vector<double> & probs) {
+
+	setProbabilities(probs);
+}
+
+KPDAliasTable::~KPDAliasTable() {
+
+}
+
+void KPDAliasTable::setProbabilities(const std::vector<double> & probs) {
+
+	int n = (int)probs.size();
+
+	keepProbability.assign(n, 1.0);
+	alias.resize(n);
+
+	// Implied probabilities, scaled by n
+	std::vector<double> scaled = impliedProbabilities(probs);
+
+	for (int i = 0; i < n; i++) {
+		scaled[i] *= n;
+		alias[i] = i;
+	}
+
+	// Vose's method: pair each column below 1 with a column above 1, which gives it the remainder
+	std::vector<int> small;
+	std::vector<int> large;
+
+	for (int i = 0; i < n; i++) {
+		if (scaled[i] < 1.0) {
+			small.push_back(i);
+		}
+		else {
+			large.push_back(i);
+		}
+	}
+
+	while (!small.empty() && !large.empty()) {
+
+		int s = small.back();
+		small.pop_back();
+		int l = large.back();
+
+		keepProbability[s] = scaled[s];
+		alias[s] = l;
+
+		scaled[l] = (scaled[l] + scaled[s]) - 1.0;
+
+		if (scaled[l] < 1.0) {
+			large.pop_back();
+			small.push_back(l);
+		}
+	}
+
+	// Columns left over (only from rounding) are kept with probability 1
+}
+
+int KPDAliasTable::size() const {
+
+	return (int)alias.size();
+}
+
+int KPDAliasTable::sample(double u) const {
+
+	int n = (int)alias.size();
+
+	if (n == 0) {
+		return 0;
+	}
+
+	double x = u * n;
+	int column = (int)x;
+
+	if (column >= n) {
+		column = n - 1;
+	}
+
+	return (x - column < keepProbability[column]) ? column : alias[column];
+}
+
+std::vector<double> KPDAliasTable::impliedProbabilities(const std::vector<double> & probs) {
+
+	int n = (int)probs.size();
+
+	// Probabilities implied by a linear scan over the cumulative probabilities
+	std::vector<double> implied(n);
+	double cumulative = 0.0;
+
+	for (int i = 0; i < n; i++) {
+
+		double next = 1.0;
+		if (i + 1 < n) {
+			next = cumulative + (probs[i] > 0 ? probs[i] : 0.0);
+			next = (next < 1.0) ? next : 1.0;
+		}
+
+		implied[i] = next - cumulative;
+		cumulative = next;
+	}
+
+	return implied;
+}
+
 #endif
\ No newline at end of file
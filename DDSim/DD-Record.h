@@ -17,13 +17,19 @@ Elements are copied to simulation at beginning of each iteration
 #include "DD-Match.h"
 #include "DD-MatchRun.h"
 #include "DD-RNG.h"
+#include "DD-ThreadPool.h"
 
 #include <vector>
 #include <string>
 #include <deque>
+#include <set>
 #include <iostream>
 #include <sstream>
 #include <fstream>
+#include <algorithm>
+
+// Matches are generated serially when there are fewer (donor node, candidate node) pairs than this (e.g., on a day with one arrival)
+#define MATCH_GENERATION_MIN_PARALLEL_PAIRS 2048
 
 class KPDRecord {
 
@@ -41,53 +47,52 @@ private:
 
 	// Pool Information	
 	std::vector<KPDNode *> kpdNodes;	
+	std::vector<KPDDonor *> iterationDonors; // Donors generated for the current iteration (shared by the nodes and their copies)
 	std::vector<std::deque<KPDStatus> > kpdNodeStateTransitionMatrix;
 	std::vector<std::deque<int> > kpdNodeStateTransitionTimeMatrix;
-	
-	std::map<int, std::map<int, std::vector<KPDMatch *> > > kpdMatches;
-
-	std::vector<std::vector<bool> > kpdAdjacencyMatrix;
-	std::vector<std::vector<bool> > kpdAdjacencyMatrixReduced;
 
 	// Random Number Generators
 	RNG rngSelection;
 	RNG rngAttrition;
 	RNG rngArrival;
-	RNG rngMatch;
 	RNG rngDonor;
 	RNG rngStatus;
 
+	KPDThreadPool * threadPool; // Owned by the simulation and kept between calls, as matches are generated every day with arrivals
+
 	// Helper Functions 
 	void clearRecord();
+	void clearIterationDonors();
 	void generateInitialKPD();
 	void assembleKPD(std::vector<int> matchRunTimes);		
 	void assignStateTransitions();
-	void assignMatchProperties();
+
+	KPDMatch * formMatch(KPDCandidate * candidate, KPDDonor * donor, KPDCrossmatch virtualCrossmatchResult, double fiveYearSurvival, double tenYearSurvival, bool waitlist, double uUtility, double uSuccess);
 	
 	std::stringstream kpdRecordLog;
 
 
 public:
 
-	KPDRecord(KPDData * data, KPDParameters * params);
+	KPDRecord(KPDData * data, KPDParameters * params, KPDThreadPool * pool);
 	~KPDRecord();
 	
 	KPDDonor * generateDonor();
 	void generateDonors(std::vector<KPDDonor *> & donors, int numberOfDonors, KPDCandidate * candidate);
-	KPDMatch * generateMatch(KPDCandidate * candidate, KPDDonor * donor, KPDCrossmatch virtualCrossmatchResult, bool waitlist);
+	KPDMatch * generateMatch(KPDCandidate * candidate, KPDDonor * donor, KPDCrossmatch virtualCrossmatchResult, double fiveYearSurvival, double tenYearSurvival, bool waitlist, CounterRNG & rngMatchProperties); // Draws from the given stream (and is safe to call from worker threads)
 
 	void generateSimulationData(int iteration, std::vector<int> matchRunTimes);
 
+	// Generates the matches (and adjacencies) from the given donor nodes to the given candidate nodes (e.g., as nodes arrive); match properties only depend on the iteration and the nodes
+	// Adjacencies map each donor node index to the indices of the candidate nodes it has an edge to
+	void generateMatches(const std::vector<int> & donorNodeIndices, const std::vector<int> & candidateNodeIndices, std::map<int, std::map<int, std::vector<KPDMatch *> > > & matches,
+		std::map<int, std::set<int> > & adjacency, std::map<int, std::set<int> > & adjacencyReduced);
+
 	// Cloning Functions
 	std::vector<KPDNode *> getNodes();
 	std::vector<KPDNodeType> getNodeTypes();
 	std::vector<std::deque<KPDStatus> > getKPDNodeStateTransitionMatrix();
 	std::vector<std::deque<int> > getKPDNodeStateTransitionTimeMatrix();
-
-	std::map<int, std::map<int, std::vector<KPDMatch *> > > getKPDMatches();
-
-	std::vector<std::vector<bool> > getAdjacencyMatrix();
-	std::vector<std::vector<bool> > getAdjacencyMatrixReduced();
 	
 	std::string getPopulationList();
 
@@ -95,14 +100,17 @@ public:
 	
 };
 
-KPDRecord::KPDRecord(KPDData * data, KPDParameters * params){
+KPDRecord::KPDRecord(KPDData * data, KPDParameters * params, KPDThreadPool * pool) {
 
 	kpdData = data;
 	kpdParameters = params;
+	threadPool = pool;
 }
 
 KPDRecord::~KPDRecord(){
 	printLog();
+
+	clearIterationDonors();
 }
 
 
@@ -115,14 +123,18 @@ void KPDRecord::clearRecord(){
 	nNDDsTotal = 0;
 
 	kpdNodes.clear();
+	clearIterationDonors(); // Nodes from the previous iteration are no longer used
 	kpdNodeStateTransitionMatrix.clear();
 	kpdNodeStateTransitionTimeMatrix.clear();
+}
 
-	kpdMatches.clear();
+void KPDRecord::clearIterationDonors() {
 
-	kpdAdjacencyMatrix.clear();
-	kpdAdjacencyMatrixReduced.clear();
+	for (std::vector<KPDDonor *>::iterator it = iterationDonors.begin(); it != iterationDonors.end(); it++) {
+		delete *it;
+	}
 
+	iterationDonors.clear();
 }
 
 void KPDRecord::generateInitialKPD(){
@@ -143,6 +155,7 @@ void KPDRecord::generateInitialKPD(){
 		int nPairs = 0;
 
 		KPDDonor * newNDD = generateDonor();
+		iterationDonors.push_back(newNDD);
 
 		KPDNode * newNDDNode = new KPDNode(nodeIDAssignment, 0, newNDD);
 		initialNodes.push_back(newNDDNode);
@@ -173,6 +186,19 @@ void KPDRecord::generateInitialKPD(){
 		std::map<int, std::map<int, std::vector<KPDMatch *> > > initialMatches;
 
 		int N = (int) initialNodes.size();
+
+		//Candidates of pair nodes (crossmatched as a panel against each donor)
+		std::vector<KPDCandidate *> pairCandidates;
+		std::vector<int> pairPosition(N, -1);
+
+		for (int j = 1; j <= N; j++) {
+			if (initialNodes[j - 1]->getType() == PAIR) {
+				pairPosition[j - 1] = (int)pairCandidates.size();
+				pairCandidates.push_back(initialNodes[j - 1]->getCandidate());
+			}
+		}
+
+		KPDCrossmatchPanel pairPanel(pairCandidates, false);
 		
 		for (int i = 1; i <= N; i++) {
 
@@ -185,6 +211,12 @@ void KPDRecord::generateInitialKPD(){
 			std::vector<KPDDonor *> donors = donorNode->getDonors();
 			int numDonors = donorNode->getNumberOfDonors();
 
+			//Perform virtual crossmatches
+			std::vector<std::vector<KPDCrossmatch> > virtualCrossmatchResults(numDonors);
+			for (int k = 1; k <= numDonors; k++) {
+				kpdData->performCrossmatchBatch(donors[k - 1], pairPanel, virtualCrossmatchResults[k - 1]);
+			}
+
 			//Iterate through candidate nodes
 			for (int j = 1; j <= N; j++) {
 
@@ -203,8 +235,7 @@ void KPDRecord::generateInitialKPD(){
 
 						int donorIndex = k - 1;
 
-						//Perform virtual crossmatch
-						KPDCrossmatch virtualCrossmatchResult = kpdData->performCrossmatch(candidateNode->getCandidate(), donors[donorIndex], false);
+						KPDCrossmatch virtualCrossmatchResult = virtualCrossmatchResults[donorIndex][pairPosition[candidateNodeIndex]];
 
 						if (kpdData->allowableMatch(virtualCrossmatchResult)) {
 
@@ -240,7 +271,7 @@ void KPDRecord::generateInitialKPD(){
 			initialNodeTypes.push_back((*it)->getType());
 		}
 
-		KPDMatchRun * initialMatchRun = new KPDMatchRun(kpdParameters, 0, 0, initialNodes, initialNodeTypes, initialStatuses, initialTransplanted, initialMatches);
+		KPDMatchRun * initialMatchRun = new KPDMatchRun(kpdParameters, 0, 0, initialNodes, initialNodeTypes, initialStatuses, initialTransplanted, initialMatches, threadPool);
 
 		std::vector<std::vector<int> > cyclesAndChains;
 		std::vector<double> utilities;
@@ -351,6 +382,7 @@ void KPDRecord::assembleKPD(std::vector<int> matchRunTimes){
 			while (nddTimeTracker <= time) { // Generate NDDs
 
 				KPDDonor * newNDD = generateDonor(); // Randomly generate NDD
+				iterationDonors.push_back(newNDD);
 
 				KPDNode * newNDDNode = new KPDNode(nodeIDAssignment, time, newNDD);
 				kpdNodes.push_back(newNDDNode);
@@ -458,39 +490,48 @@ void KPDRecord::assignStateTransitions() {
 
 			kpdRecordLog << nodeID << ": " << time << " (" << KPDFunctions::statusToString(status) << ") ";
 					
-			while (time < (timeSimulation + timeBetweenSelectionAndTransplantation) && status != STATUS_WITHDRAWN) {
-				
-				time++;
-				
-				double w = rngStatus.runif(); // Withdrawal
-				double u = rngStatus.runif(); // Active to Inactive or Inactive to Active
+			int horizon = timeSimulation + timeBetweenSelectionAndTransplantation;
 
-				if (w < probPairAttrition) {
-					status = STATUS_WITHDRAWN;
+			// Each day a pair withdraws with probability probPairAttrition, and otherwise may switch between active and inactive;
+			// rather than drawing every day, draw the number of days until the next event and then which event occurs
+			while (time < horizon && status != STATUS_WITHDRAWN) {
 
-					kpdNodeStateTransitions.push_back(status);
-					kpdNodeStateTransitionTimes.push_back(time);
+				double probSwitch = (status == STATUS_ACTIVE) ? probPairActiveToInactive : probPairInactiveToActive;
+				double probEvent = probPairAttrition + (1 - probPairAttrition) * probSwitch;
 
-					kpdRecordLog << time << " (" << KPDFunctions::statusToString(status) << ") ";
+				if (probEvent <= 0) {
+					break;
 				}
 
-				else if (status == STATUS_ACTIVE && u < probPairActiveToInactive) {
-					status = STATUS_INACTIVE;
+				double u[2];
+				rngStatus.fill(u, 2);
 
-					kpdNodeStateTransitions.push_back(status);
-					kpdNodeStateTransitionTimes.push_back(time);
+				// Geometric waiting time (at least one day)
+				double wait = 1;
+				if (probEvent < 1) {
+					wait = std::max(1.0, ceil(log(u[0]) / log(1 - probEvent)));
+				}
 
-					kpdRecordLog << time << " (" << KPDFunctions::statusToString(status) << ") ";
+				if (wait > horizon - time) {
+					break;
 				}
 
-				else if (status == STATUS_INACTIVE && u < probPairInactiveToActive) {
+				time += (int)wait;
+
+				if (u[1] * probEvent < probPairAttrition) { // Withdrawal
+					status = STATUS_WITHDRAWN;
+				}
+				else if (status == STATUS_ACTIVE) { // Active to Inactive
+					status = STATUS_INACTIVE;
+				}
+				else { // Inactive to Active
 					status = STATUS_ACTIVE;
+				}
 
-					kpdNodeStateTransitions.push_back(status);
-					kpdNodeStateTransitionTimes.push_back(time);
+				kpdNodeStateTransitions.push_back(status);
+				kpdNodeStateTransitionTimes.push_back(time);
 
-					kpdRecordLog << time << " (" << KPDFunctions::statusToString(status) << ") ";
-				}
+				kpdRecordLog << time << " (" << KPDFunctions::statusToString(status) << ") ";
 			}
 
 			kpdRecordLog << std::endl;
@@ -513,20 +554,47 @@ void KPDRecord::assignStateTransitions() {
 	}
 }
 
-void KPDRecord::assignMatchProperties() {
-	
-	kpdRecordLog << "Generating Match Properties:" << std::endl;
-	std::cout << "Generating Match Properties..." << std::endl;
+void KPDRecord::generateMatches(const std::vector<int> & donorNodeIndices, const std::vector<int> & candidateNodeIndices, std::map<int, std::map<int, std::vector<KPDMatch *> > > & matches,
+	std::map<int, std::set<int> > & adjacency, std::map<int, std::set<int> > & adjacencyReduced) {
+
+	int nDonorNodes = (int)donorNodeIndices.size();
+	int nCandidateNodes = (int)candidateNodeIndices.size();
+
+	if (nDonorNodes == 0 || nCandidateNodes == 0) {
+		return;
+	}
+
+	//Candidates of pair nodes (crossmatched as a panel against each donor)
+	std::vector<KPDCandidate *> pairCandidates;
+	std::vector<int> pairPosition(nCandidateNodes, -1);
 
-	int N = (int) kpdNodes.size();
+	for (int c = 0; c < nCandidateNodes; c++) {
+		if (kpdNodes[candidateNodeIndices[c]]->getType() == PAIR) {
+			pairPosition[c] = (int)pairCandidates.size();
+			pairCandidates.push_back(kpdNodes[candidateNodeIndices[c]]->getCandidate());
+		}
+	}
 
-	kpdAdjacencyMatrix.assign(1 + N, std::vector<bool>(1 + N, false));
-	kpdAdjacencyMatrixReduced.assign(1 + N, std::vector<bool>(1 + N, false));
+	KPDCrossmatchPanel pairPanel(pairCandidates, false);
 
-	//Iterate through donor nodes
-	for (int i = 1; i <= N; i++) {
+	//Donor nodes are independent: each collects its matches and log in its own buffer, and draws match properties from a stream
+	//for each (donor node, candidate node, donor), so the results do not depend on the number of threads or on when the edge is generated
+	std::vector<std::vector<std::pair<int, std::vector<KPDMatch *> > > > nodeMatches(nDonorNodes);
+	std::vector<std::string> nodeLogs(nDonorNodes);
+
+	//Adjacencies of the donor nodes are looked up here, so each task only writes to its own
+	std::vector<std::set<int> *> nodeAdjacency(nDonorNodes);
+	std::vector<std::set<int> *> nodeAdjacencyReduced(nDonorNodes);
+
+	for (int d = 0; d < nDonorNodes; d++) {
+		nodeAdjacency[d] = &adjacency[donorNodeIndices[d]];
+		nodeAdjacencyReduced[d] = &adjacencyReduced[donorNodeIndices[d]];
+	}
 
-		int donorNodeIndex = i - 1;
+	std::function<void(int)> generateDonorNodeMatches = [&](int d) {
+
+		int donorNodeIndex = donorNodeIndices[d];
+		int i = donorNodeIndex + 1;
 
 		KPDNode * donorNode = kpdNodes[donorNodeIndex];
 		int donorNodeID = donorNode->getID();
@@ -535,10 +603,40 @@ void KPDRecord::assignMatchProperties() {
 		std::vector<KPDDonor *> donors = donorNode->getDonors();
 		int numDonors = donorNode->getNumberOfDonors();
 
+		//Perform virtual crossmatches
+		std::vector<std::vector<KPDCrossmatch> > virtualCrossmatchResults(numDonors);
+		for (int k = 1; k <= numDonors; k++) {
+			kpdData->performCrossmatchBatch(donors[k - 1], pairPanel, virtualCrossmatchResults[k - 1]);
+		}
+
+		//Calculate survival for all allowable matches together (in the order the matches are generated below)
+		std::vector<KPDCandidate *> matchCandidates;
+		std::vector<KPDDonor *> matchDonors;
+
+		for (int c = 0; c < nCandidateNodes; c++) {
+			if (i != candidateNodeIndices[c] + 1 && pairPosition[c] != -1) {
+				for (int k = 1; k <= numDonors; k++) {
+					if (kpdData->allowableMatch(virtualCrossmatchResults[k - 1][pairPosition[c]])) {
+						matchCandidates.push_back(pairCandidates[pairPosition[c]]);
+						matchDonors.push_back(donors[k - 1]);
+					}
+				}
+			}
+		}
+
+		std::vector<double> fiveYearSurvival;
+		std::vector<double> tenYearSurvival;
+		kpdData->calculateSurvivalBatch(matchCandidates, matchDonors, fiveYearSurvival, tenYearSurvival);
+
+		int matchIndex = 0;
+
+		std::stringstream nodeLog;
+
 		//Iterate through candidate nodes
-		for (int j = 1; j <= N; j++) {
+		for (int c = 0; c < nCandidateNodes; c++) {
 
-			int candidateNodeIndex = j - 1;
+			int candidateNodeIndex = candidateNodeIndices[c];
+			int j = candidateNodeIndex + 1;
 
 			KPDNode * candidateNode = kpdNodes[candidateNodeIndex];
 			int candidateNodeID = candidateNode->getID();
@@ -546,35 +644,36 @@ void KPDRecord::assignMatchProperties() {
 			if (i != j) {
 				// Pair -> NDD (Implicit Backward Edge from all Donors to the NDD)
 				if (donorNode->getType() == PAIR && candidateNode->getType() == NDD) {
-					kpdAdjacencyMatrix[i][j] = true;
+					nodeAdjacency[d]->insert(candidateNodeIndex);
 				}
 
 				// Pair
 				else if (candidateNode->getType() == PAIR) {
 
-					double pra = candidateNode->getCandidatePRA();
+					KPDCandidate * candidate = pairCandidates[pairPosition[c]];
 					
-					bool allowableMatchExists = false;
-					std::vector<KPDMatch *> matches;
+					std::vector<KPDMatch *> candidateMatches;
 
 					//Iterate through associated donors
 					for (int k = 1; k <= numDonors; k++) {
 
 						int donorIndex = k - 1;
 
-						//Perform virtual crossmatch
-						KPDCrossmatch virtualCrossmatchResult = kpdData->performCrossmatch(candidateNode->getCandidate(), donors[donorIndex], false);
+						KPDCrossmatch virtualCrossmatchResult = virtualCrossmatchResults[donorIndex][pairPosition[c]];
 					
 						if (kpdData->allowableMatch(virtualCrossmatchResult)) {
 
-							kpdAdjacencyMatrix[i][j] = true;
-							kpdAdjacencyMatrixReduced[i][j] = true;
+							nodeAdjacency[d]->insert(candidateNodeIndex);
+							nodeAdjacencyReduced[d]->insert(candidateNodeIndex);
 
-							KPDMatch * newMatch = generateMatch(candidateNode->getCandidate(), donorNode->getDonor(donorIndex), virtualCrossmatchResult, false);
+							CounterRNG rngMatchProperties(kpdParameters->getRNGSeedMatch(), STREAM_MATCH_PROPERTIES, currentIteration, CounterRNG::entityKey(donorNodeID, candidateNodeID, k));
+
+							KPDMatch * newMatch = generateMatch(candidate, donors[donorIndex], virtualCrossmatchResult, fiveYearSurvival[matchIndex], tenYearSurvival[matchIndex], false, rngMatchProperties);
+							matchIndex++;
 							
-							matches.push_back(newMatch);
+							candidateMatches.push_back(newMatch);
 							
-							kpdRecordLog << "   " << donorNodeID << "[" << k << "] -> " << candidateNodeID << " " << newMatch->matchShortOutput() << std::endl;
+							nodeLog << "   " << donorNodeID << "[" << k << "] -> " << candidateNodeID << " " << newMatch->matchShortOutput() << std::endl;
 						}
 
 						else {
@@ -582,24 +681,44 @@ void KPDRecord::assignMatchProperties() {
 							KPDMatch * noMatch = new KPDMatch();
 							noMatch->setVirtualCrossmatchResult(virtualCrossmatchResult);
 
-							matches.push_back(noMatch);
+							candidateMatches.push_back(noMatch);
 						}
 					}
 
-					//std::cout << donorNodeID << "->" << candidateNodeID << std::endl;
-					kpdMatches[donorNodeID][candidateNodeID] = matches;
+					nodeMatches[d].push_back(std::pair<int, std::vector<KPDMatch *> >(candidateNodeID, candidateMatches));
 				}
 			}
 		}
+
+		nodeLogs[d] = nodeLog.str();
+	};
+
+	if ((long long)nDonorNodes * nCandidateNodes < MATCH_GENERATION_MIN_PARALLEL_PAIRS) {
+		for (int d = 0; d < nDonorNodes; d++) {
+			generateDonorNodeMatches(d);
+		}
+	}
+	else {
+		threadPool->parallelFor(nDonorNodes, generateDonorNodeMatches);
+	}
+
+	//Collect matches and logs in donor node order
+	for (int d = 0; d < nDonorNodes; d++) {
+
+		int donorNodeID = kpdNodes[donorNodeIndices[d]]->getID();
+
+		for (std::vector<std::pair<int, std::vector<KPDMatch *> > >::iterator it = nodeMatches[d].begin(); it != nodeMatches[d].end(); it++) {
+			matches[donorNodeID][it->first] = it->second;
+		}
+
+		kpdRecordLog << nodeLogs[d];
 	}
 }
 
 KPDDonor * KPDRecord::generateDonor() {
 
-	std::vector<double> u;
-	for (int i = 1; i <= 5; i++) {
-		u.push_back(rngDonor.runif());
-	}
+	std::vector<double> u(5, 0.0);
+	rngDonor.fill(&u[0], 5);
 
 	KPDDonor * newDonor = kpdData->generateDonor(u);
 
@@ -609,30 +728,38 @@ KPDDonor * KPDRecord::generateDonor() {
 
 void KPDRecord::generateDonors(std::vector<KPDDonor *> & donors, int numberOfDonors, KPDCandidate * candidate) {
 
-	int generatedDonors = 0;
-	int attempts = 0;
-	
-	while (attempts < 2 * numberOfDonors && generatedDonors < numberOfDonors) { // This could take a while...
-		
-		KPDDonor * donor = generateDonor();
-		
-		KPDCrossmatch crossmatch = kpdData->performCrossmatch(candidate, donor, false);
+	// Donors are drawn directly from those who fail the crossmatch with the candidate, so each draw gives a donor
+	// (unless no donor can fail it, in which case the candidate gets fewer donors than needed and is not used)
+	std::vector<double> u(9, 0.0);
+
+	int samplerIndex = kpdData->indexOfIncompatibleDonorSampler(candidate);
+
+	for (int k = 0; k < numberOfDonors; k++) {
 
-		if (!kpdData->allowableMatch(crossmatch)) {
-			donors.push_back(donor);
-			generatedDonors++;
+		rngDonor.fill(&u[0], 9);
+
+		KPDDonor * newDonor = kpdData->generateIncompatibleDonor(samplerIndex, candidate, u, rngDonor);
+
+		if (newDonor == NULL) {
+			break;
 		}
 
-		attempts++;
+		donors.push_back(newDonor);
+		iterationDonors.push_back(newDonor);
 	}
 }
 
-KPDMatch * KPDRecord::generateMatch(KPDCandidate * candidate, KPDDonor * donor, KPDCrossmatch virtualCrossmatchResult, bool waitlist) {
+KPDMatch * KPDRecord::generateMatch(KPDCandidate * candidate, KPDDonor * donor, KPDCrossmatch virtualCrossmatchResult, double fiveYearSurvival, double tenYearSurvival, bool waitlist, CounterRNG & rngMatchProperties) {
 
-	//Assign utility values
-	double fiveYearSurvival = kpdData->calculateSurvival(candidate, donor, 1);
-	double tenYearSurvival = kpdData->calculateSurvival(candidate, donor, 0);
+	double uUtility = rngMatchProperties.runif();
+	double uSuccess = rngMatchProperties.runif();
+
+	return formMatch(candidate, donor, virtualCrossmatchResult, fiveYearSurvival, tenYearSurvival, waitlist, uUtility, uSuccess);
+}
+
+KPDMatch * KPDRecord::formMatch(KPDCandidate * candidate, KPDDonor * donor, KPDCrossmatch virtualCrossmatchResult, double fiveYearSurvival, double tenYearSurvival, bool waitlist, double uUtility, double uSuccess) {
 
+	//Assign utility values
 	double kdpi = donor->getKDPI();
 	int pra = candidate->getPRA();
 	double epts = candidate->getEPTS();
@@ -642,7 +769,10 @@ KPDMatch * KPDRecord::generateMatch(KPDCandidate * candidate, KPDDonor * donor,
 		transplantDifficultyScore = 1.0;
 	}
 
-	double assignedUtility = rngMatch.runif(kpdParameters->getMatchUtilityLowerBound(), kpdParameters->getMatchUtilityUpperBound());
+	double lowerBound = kpdParameters->getMatchUtilityLowerBound();
+	double upperBound = kpdParameters->getMatchUtilityUpperBound();
+
+	double assignedUtility = lowerBound + (upperBound - lowerBound) * uUtility;
 
 	//Generate probability values
 
@@ -712,7 +842,7 @@ KPDMatch * KPDRecord::generateMatch(KPDCandidate * candidate, KPDDonor * donor,
 		}
 	}
 
-	bool successfulMatch = rngMatch.runif() < actualMatchSuccessProbability;
+	bool successfulMatch = uSuccess < actualMatchSuccessProbability;
 
 	KPDMatch * newMatch = new KPDMatch(true, fiveYearSurvival, tenYearSurvival, transplantDifficultyScore, assignedUtility, 
 		assumedMatchSuccessProbability, actualMatchSuccessProbability, virtualCrossmatchResult, successfulMatch);
@@ -738,15 +868,13 @@ void KPDRecord::generateSimulationData(int iteration, std::vector<int> matchRunT
 	rngSelection.setSeed(kpdParameters->getRNGSeedSelection() * iteration);
 	rngAttrition.setSeed(kpdParameters->getRNGSeedAttrition() * iteration);
 	rngArrival.setSeed(kpdParameters->getRNGSeedArrival() * iteration);
-	rngMatch.setSeed(kpdParameters->getRNGSeedMatch() * iteration);
 	rngDonor.setSeed(kpdParameters->getRNGSeedDonor() * iteration);
 	rngStatus.setSeed(kpdParameters->getRNGSeedStatus() * iteration);
 
 	//Select new simulation data, assign node and match properties
 	generateInitialKPD();
 	assembleKPD(matchRunTimes);
-	assignStateTransitions();
-	assignMatchProperties();
+	assignStateTransitions(); // Matches are generated by the simulation as nodes arrive
 
 	kpdRecordLog << "Simulation Data for Iteration " << iteration << " Generated!" << std::endl << std::endl;
 	std::cout << "Simulation Data for Iteration " << iteration << " Generated!" << std::endl << std::endl;
@@ -774,20 +902,6 @@ std::vector<KPDNodeType> KPDRecord::getNodeTypes() {
 	return nodeTypes;
 }
 
-std::vector<std::vector<bool> > KPDRecord::getAdjacencyMatrix() {
-
-	std::vector<std::vector<bool> > adjacencyMatrixClone(kpdAdjacencyMatrix);
-
-	return adjacencyMatrixClone;
-}
-
-std::vector<std::vector<bool> > KPDRecord::getAdjacencyMatrixReduced() {
-
-	std::vector<std::vector<bool> > adjacencyMatrixReducedClone(kpdAdjacencyMatrixReduced);
-
-	return adjacencyMatrixReducedClone;
-}
-
 std::vector<std::deque<KPDStatus> > KPDRecord::getKPDNodeStateTransitionMatrix() {
 
 	std::vector<std::deque<KPDStatus> > kpdNodeStateTransitionMatrixClone(kpdNodeStateTransitionMatrix);
@@ -802,35 +916,6 @@ std::vector<std::deque<int> > KPDRecord::getKPDNodeStateTransitionTimeMatrix() {
 	return kpdNodeStateTransitionTimeMatrixClone;
 }
 
-std::map<int, std::map<int, std::vector<KPDMatch*> > > KPDRecord::getKPDMatches() {
-
-	std::map<int, std::map<int, std::vector<KPDMatch*> > > kpdMatchesCopy;
-
-	for (std::map<int, std::map<int, std::vector<KPDMatch*> > >::iterator itDonor = kpdMatches.begin(); itDonor != kpdMatches.end(); itDonor++) {
-
-		int donorNodeID = itDonor->first;
-
-		std::map<int, std::vector<KPDMatch*> > donorMatches = itDonor->second;
-		
-		for (std::map<int, std::vector<KPDMatch *> >::iterator itCandidate = donorMatches.begin(); itCandidate != donorMatches.end(); itCandidate++) {
-
-			int candidateNodeID = itCandidate->first;
-
-			std::vector<KPDMatch*> matches = itCandidate->second;
-
-			std::vector<KPDMatch *> matchCopy;
-
-			for (std::vector<KPDMatch *>::iterator itMatch = matches.begin(); itMatch != matches.end(); itMatch++) {
-				matchCopy.push_back((*itMatch)->copy());
-			}
-
-			kpdMatchesCopy[donorNodeID][candidateNodeID] = matchCopy;
-		}
-	}
-
-	return kpdMatchesCopy;
-}
-
 std::string KPDRecord::getPopulationList() {
 
 	std::stringstream population;
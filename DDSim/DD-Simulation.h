@@ -17,10 +17,15 @@ Organizes the steps of the simulation
 #include <vector>
 #include <string>
 #include <deque>
+#include <set>
+#include <algorithm>
 #include <iostream>
 #include <sstream>
 #include <fstream>
 
+// Waitlist candidates are crossmatched against an allocated donor in chunks of this size, stopping at the first chunk with an allowable match
+#define ALLOCATION_CROSSMATCH_CHUNK_SIZE 64
+
 class KPDSimulation {
 
 private:
@@ -29,6 +34,8 @@ private:
 	KPDData * kpdData;
 	KPDRecord * kpdRecord;
 
+	KPDThreadPool * threadPool; // Shared by the record and the match runs, so worker threads are kept for the whole simulation
+
 	// Simulation Progress
 	int currentIteration;
 	int currentTime;
@@ -37,18 +44,28 @@ private:
 
 	std::deque<KPDArrangement *> transplantQueue;
 
+	// Deceased donors and waitlisted candidates are streamed from the data in time order (and owned by the simulation)
+	bool streamDeceasedDonorsAndWaitlist;
+
 	// Deceased Donors Information
 	std::deque<KPDDonor *> deceasedDonors;
 	std::deque<int> deceasedDonorArrivalTimes;
 
-	// Candidate Waitlist Information
-	std::vector<KPDCandidate *> waitlistedCandidates;
+	// Candidate Waitlist Information (candidates keep their index while on the waitlist; indices of released candidates are reused)
+	std::vector<KPDCandidate *> waitlistedCandidates; // NULL at unused indices
+	std::vector<int> waitlistedCandidatePositions;
 
 	std::vector<KPDStatus> waitlistedCandidateStatus;
 	std::vector<KPDTransplant> waitlistedCandidateTransplanted;
 
 	std::vector<std::deque<KPDStatus> > waitlistedCandidateStateTransitions;
 	std::vector<std::deque<int> > waitlistedCandidateStateTransitionTimes;
+
+	std::map<int, int> waitlistOrder; // Position on Waitlist -> Index
+	std::map<int, int> waitlistedCandidateIndices; // Candidate ID -> Index
+	std::vector<int> unusedWaitlistIndices;
+
+	std::set<int> transplantedWaitlistCandidateIDs; // Streamed candidates transplanted while not on the waitlist (already released, or not yet streamed)
 	
 	// KPD Information
 	std::vector<KPDNode *> kpdNodes;
@@ -56,34 +73,56 @@ private:
 
 	std::vector<KPDStatus> kpdNodeStatus;
 	std::vector<KPDTransplant> kpdNodeTransplanted;
+	std::set<int> kpdPoolNodes; // Nodes that have arrived and not yet left the pool (only these nodes have matches and adjacencies)
+	std::vector<std::pair<int, int> > kpdNodeArrivals; // (Arrival Time, Node), in order of arrival
+	int nextArrivingKPDNode;
 
 	std::vector<std::deque<KPDStatus> > kpdNodeStateTransitions;
 	std::vector<std::deque<int> > kpdNodeStateTransitionTimes;
 
+	// Expected Utility Cache
+	std::vector<int> kpdNodeVersions; // Incremented whenever a node's status, type, or incident edges change
+	std::map<std::vector<int>, std::pair<std::vector<int>, double> > expectedUtilityCache; // Arrangement -> (Node Versions, Expected Utility)
+
 	// Crossmatch Information
 	std::map<int, std::map<int, KPDMatch *> > deceasedDonorMatches;
-	std::map<int, std::map<int, std::vector<KPDMatch*> > > waitlistedCandidateMatches;
+	std::map<int, std::map<int, std::vector<KPDMatch*> > > waitlistedCandidateMatches; // Candidate ID -> Donor Node ID -> Matches
 	std::map<int, std::map<int, std::vector<KPDMatch*> > > kpdMatches;
 
-	// Crossmatch Matrices
-	std::vector<std::vector<bool> > kpdAdjacencyMatrix;
-	std::vector<std::vector<bool> > kpdAdjacencyMatrixReduced; // No implicit edges back to NDDs
-
-	std::vector<std::vector<bool> > kpdToWaitlistAdjacencyMatrix;
+	// Adjacency of Nodes in the Pool (Donor Node Index -> Candidate Node Indices)
+	std::map<int, std::set<int> > kpdAdjacency;
+	std::map<int, std::set<int> > kpdAdjacencyReduced; // No implicit edges back to NDDs
 	
 	// Helper Functions	
 	int indexOfWaitlistedCandidate(int id);
 	int indexOfKPDNode(int id);
 	int getChild(int lower, int current, std::vector<int> &visitedVector, std::vector<std::vector<bool> > &adjacency);
 
+	std::vector<int> getArrangementVersions(std::vector<int> &arrangement);
+
+	bool getAdjacency(std::map<int, std::set<int> > &adjacency, int donorNodeIndex, int candidateNodeIndex);
+	void setAdjacency(std::map<int, std::set<int> > &adjacency, int donorNodeIndex, int candidateNodeIndex, bool adjacent);
+
 	void updateStatus(int id, KPDStatus newState, bool waitlist);
 	void updateFailedMatch(int donorNodeID, int candidateNodeID, int donorIndex, bool waitlist);
 
 	void findDeceasedDonorMatches();
 	void findWaitlistedCandidateMatches();
+	void findDeceasedDonorMatches(KPDDonor * deceasedDonor);
+	void findWaitlistedCandidateMatches(KPDCandidate * waitlistCandidate);
+
+	void admitWaitlistedCandidate(KPDCandidate * waitlistCandidate, int position);
+	void releaseWaitlistedCandidates();
+	void releaseDeceasedDonor(KPDDonor * deceasedDonor);
+	void clearStreamedData();
+
+	void admitKPDNodes();
+	void releaseKPDNodes();
+	void clearKPDMatches();
 
 	int allocateDonor(KPDDonor * donor);
 
+	void runStreamingStage();
 	void runStateTransitionStage();
 	void runMatchRunStage();
 	void runDeceasedDonorAllocationStage();
@@ -128,8 +167,12 @@ KPDSimulation::KPDSimulation(KPDParameters * parameters) {
 	std::cout << "Collecting Data..." << std::endl;
 	kpdData = new KPDData(kpdParameters);
 	
+	threadPool = new KPDThreadPool(kpdParameters->getNumberOfThreads());
+
 	std::cout << "Preparing Record for Simulation..." << std::endl;
-	kpdRecord = new KPDRecord(kpdData, kpdParameters);
+	kpdRecord = new KPDRecord(kpdData, kpdParameters, threadPool);
+
+	streamDeceasedDonorsAndWaitlist = kpdData->getStreamDeceasedDonorsAndWaitlist();
 		
 	kpdSimulationLog << "Match Runs Occur at Times: ";
 
@@ -161,16 +204,24 @@ KPDSimulation::~KPDSimulation() {
 
 	printLog();
 
+	if (streamDeceasedDonorsAndWaitlist) {
+		clearStreamedData();
+	}
+
+	clearKPDMatches();
+
 	delete kpdRecord;
 	delete kpdData;
+
+	delete threadPool;
 }
 
 int KPDSimulation::indexOfWaitlistedCandidate(int id) {
 
-	for (int i = 0; i < (int)waitlistedCandidates.size(); i++) {
-		if (waitlistedCandidates[i]->getCandidateID() == id) {
-			return i;
-		}
+	std::map<int, int>::iterator it = waitlistedCandidateIndices.find(id);
+
+	if (it != waitlistedCandidateIndices.end()) {
+		return it->second;
 	}
 
 	return -1;
@@ -199,6 +250,39 @@ int KPDSimulation::getChild(int lower, int current, std::vector<int> & visitedVe
 	return -1;
 }
 
+std::vector<int> KPDSimulation::getArrangementVersions(std::vector<int> & arrangement) {
+
+	std::vector<int> versions;
+
+	for (std::vector<int>::iterator it = arrangement.begin(); it != arrangement.end(); it++) {
+		versions.push_back(kpdNodeVersions[indexOfKPDNode(*it)]);
+	}
+
+	return versions;
+}
+
+bool KPDSimulation::getAdjacency(std::map<int, std::set<int> > & adjacency, int donorNodeIndex, int candidateNodeIndex) {
+
+	std::map<int, std::set<int> >::iterator it = adjacency.find(donorNodeIndex);
+
+	return it != adjacency.end() && it->second.count(candidateNodeIndex) > 0;
+}
+
+void KPDSimulation::setAdjacency(std::map<int, std::set<int> > & adjacency, int donorNodeIndex, int candidateNodeIndex, bool adjacent) {
+
+	if (adjacent) {
+		adjacency[donorNodeIndex].insert(candidateNodeIndex);
+	}
+	else {
+
+		std::map<int, std::set<int> >::iterator it = adjacency.find(donorNodeIndex);
+
+		if (it != adjacency.end()) {
+			it->second.erase(candidateNodeIndex);
+		}
+	}
+}
+
 void KPDSimulation::updateStatus(int index, KPDStatus newState, bool waitlist) {
 
 	// Waitlist Candidates
@@ -244,36 +328,18 @@ void KPDSimulation::updateStatus(int index, KPDStatus newState, bool waitlist) {
 
 			// Update status
 			kpdNodeStatus[index] = newState;
+			kpdNodeVersions[index]++;
 		}
 	}	
 }
 
 void KPDSimulation::updateFailedMatch(int donorNodeID, int candidateNodeID, int donorIndex, bool waitlist) {
 			
-	// KPD -> Waitlist
+	// KPD -> Waitlist (adjacency is kept by the matches)
 	if (waitlist) {
 
-		// Get indices
-		int donorNodeIndex = indexOfKPDNode(donorNodeID);
-		int candidateNodeIndex = indexOfWaitlistedCandidate(candidateNodeID);
-
 		// Update match adjacency
-		waitlistedCandidateMatches[donorNodeID][candidateNodeID][donorIndex]->setAdjacency(false);
-
-		// Check if adjacency matrix needs to be updated...
-		bool noAssociatedDonors = true;
-
-		for (std::vector<KPDMatch*>::iterator it = waitlistedCandidateMatches[donorNodeID][candidateNodeID].begin(); it != waitlistedCandidateMatches[donorNodeID][candidateNodeID].end(); it++){
-
-			if ((*it)->getAdjacency()) {
-				noAssociatedDonors = false;
-				break;
-			}
-		}
-		//... if no donors associated with donor node match with candidate, update adjacency matrix to false
-		if (noAssociatedDonors) {
-			kpdToWaitlistAdjacencyMatrix[donorNodeIndex + 1][candidateNodeIndex + 1] = false;
-		}
+		waitlistedCandidateMatches[candidateNodeID][donorNodeID][donorIndex]->setAdjacency(false);
 	}
 	
 	// KPD -> KPD
@@ -286,6 +352,9 @@ void KPDSimulation::updateFailedMatch(int donorNodeID, int candidateNodeID, int
 		// Update match adjacency
 		kpdMatches[donorNodeID][candidateNodeID][donorIndex]->setAdjacency(false);
 
+		kpdNodeVersions[donorNodeIndex]++;
+		kpdNodeVersions[candidateNodeIndex]++;
+
 		// Check if adjacency matrix needs to be updated...
 		bool noAssociatedDonors = true;
 
@@ -295,10 +364,10 @@ void KPDSimulation::updateFailedMatch(int donorNodeID, int candidateNodeID, int
 				break;
 			}
 		}
-		//...if no donors associated with donor node match with candidate, update adjacency matrices to false
+		//...if no donors associated with donor node match with candidate, remove the adjacencies
 		if (noAssociatedDonors) {
-			kpdAdjacencyMatrix[donorNodeIndex + 1][candidateNodeIndex + 1] = false;
-			kpdAdjacencyMatrixReduced[donorNodeIndex + 1][candidateNodeIndex + 1] = false;
+			setAdjacency(kpdAdjacency, donorNodeIndex, candidateNodeIndex, false);
+			setAdjacency(kpdAdjacencyReduced, donorNodeIndex, candidateNodeIndex, false);
 		}
 	}	
 }
@@ -312,126 +381,480 @@ void KPDSimulation::findDeceasedDonorMatches() {
 	// Iterate through deceased donors
 	for (std::deque<KPDDonor *>::iterator itDonor = deceasedDonors.begin(); itDonor != deceasedDonors.end(); itDonor++) {
 
-		KPDDonor * deceasedDonor = *itDonor;
+		findDeceasedDonorMatches(*itDonor);
+	}
+}
+
+void KPDSimulation::findWaitlistedCandidateMatches() {
+
+	std::cout << "Assigning Waitlist Candidate Matches..." << std::endl;
+
+	// Iterate through waitlist candidates
+	for (std::vector<KPDCandidate *>::iterator itCandidate = waitlistedCandidates.begin(); itCandidate != waitlistedCandidates.end(); itCandidate++) {
+
+		findWaitlistedCandidateMatches(*itCandidate);
+	}
+}
+
+void KPDSimulation::findDeceasedDonorMatches(KPDDonor * deceasedDonor) {
+	
+	int deceasedDonorID = deceasedDonor->getDonorID();
+
+	// Only concerned with candidate nodes
+	std::vector<KPDCandidate *> nodeCandidates;
+	std::vector<int> candidateNodeIDs;
+
+	for (std::vector<KPDNode *>::iterator itNode = kpdNodes.begin(); itNode != kpdNodes.end(); itNode++) {
+
+		if ((*itNode)->getType() == PAIR) {
+			nodeCandidates.push_back((*itNode)->getCandidate());
+			candidateNodeIDs.push_back((*itNode)->getID());
+		}
+	}
+
+	// Crossmatch with each KPD pair
+	std::vector<KPDCrossmatch> crossmatches;
+	kpdData->performCrossmatchBatch(deceasedDonor, nodeCandidates, false, crossmatches);
+
+	// Calculate survival for all viable matches together
+	std::vector<KPDCandidate *> matchCandidates;
+	for (int i = 0; i < (int)nodeCandidates.size(); i++) {
+		if (kpdData->allowableMatch(crossmatches[i])) {
+			matchCandidates.push_back(nodeCandidates[i]);
+		}
+	}
+
+	std::vector<KPDDonor *> matchDonors(matchCandidates.size(), deceasedDonor);
+	std::vector<double> fiveYearSurvival;
+	std::vector<double> tenYearSurvival;
+	kpdData->calculateSurvivalBatch(matchCandidates, matchDonors, fiveYearSurvival, tenYearSurvival);
+
+	int matchIndex = 0;
+
+	for (int i = 0; i < (int)nodeCandidates.size(); i++) {
+
+		// If the crossmatch is viable...
+		if (kpdData->allowableMatch(crossmatches[i])) {
+
+			// Generate the match properties associated with the match (from a stream for the match, so they do not depend on when the donor is read) and store it
+			CounterRNG rngMatchProperties(kpdParameters->getRNGSeedMatch(), STREAM_DECEASED_DONOR_MATCH_PROPERTIES, currentIteration, CounterRNG::entityKey(deceasedDonorID, candidateNodeIDs[i]));
+
+			KPDMatch * match = kpdRecord->generateMatch(nodeCandidates[i], deceasedDonor, crossmatches[i], fiveYearSurvival[matchIndex], tenYearSurvival[matchIndex], false, rngMatchProperties);
+			matchIndex++;
+
+			deceasedDonorMatches[deceasedDonorID][candidateNodeIDs[i]] = match;
+		}
+	}
+}
+
+void KPDSimulation::findWaitlistedCandidateMatches(KPDCandidate * waitlistCandidate) {
+
+	int waitlistCandidateID = waitlistCandidate->getCandidateID();
+
+	// Donors of all KPD nodes (donors of node n are nodeDonors[firstDonor[n]], ..., nodeDonors[firstDonor[n + 1] - 1])
+	std::vector<KPDDonor *> nodeDonors;
+	std::vector<int> firstDonor;
+
+	for (std::vector<KPDNode *>::iterator itNode = kpdNodes.begin(); itNode != kpdNodes.end(); itNode++) {
+
+		firstDonor.push_back((int)nodeDonors.size());
+
+		std::vector<KPDDonor *> donors = (*itNode)->getDonors();
+		nodeDonors.insert(nodeDonors.end(), donors.begin(), donors.end());
+	}
+	firstDonor.push_back((int)nodeDonors.size());
+
+	// Perform crossmatches
+	std::vector<KPDCrossmatch> crossmatches;
+	kpdData->performCrossmatchBatch(waitlistCandidate, nodeDonors, true, crossmatches);
+
+	// Calculate survival for all viable matches together
+	std::vector<KPDDonor *> matchDonors;
+	for (int i = 0; i < (int)nodeDonors.size(); i++) {
+		if (kpdData->allowableMatch(crossmatches[i])) {
+			matchDonors.push_back(nodeDonors[i]);
+		}
+	}
+
+	std::vector<double> fiveYearSurvival;
+	std::vector<double> tenYearSurvival;
+	kpdData->calculateSurvivalBatch(waitlistCandidate, matchDonors, fiveYearSurvival, tenYearSurvival);
+
+	int matchIndex = 0;
+
+	// Crossmatch with each KPD node
+	for (int n = 0; n < (int)kpdNodes.size(); n++) {
+
+		KPDNode * node = kpdNodes[n];
+
+		int donorNodeID = node->getID();
+
+		int numberOfDonors = node->getNumberOfDonors();
+
+		std::vector<KPDMatch *> matches;
+		bool allowableMatchExists = false;
+
+		// Iterate through donors
+		for (int k = 1; k <= numberOfDonors; k++) {
+			
+			int donorIndex = k - 1;
+
+			KPDDonor * donor = nodeDonors[firstDonor[n] + donorIndex];
+
+			KPDCrossmatch crossmatch = crossmatches[firstDonor[n] + donorIndex];
+			
+			// If the crossmatch is viable
+			if (kpdData->allowableMatch(crossmatch)) {
+
+				// Generate the match properties (from a stream for the match, so they do not depend on when the candidate is read) and add match to list
+				CounterRNG rngMatchProperties(kpdParameters->getRNGSeedMatch(), STREAM_WAITLIST_MATCH_PROPERTIES, currentIteration, CounterRNG::entityKey(donorNodeID, waitlistCandidateID, k));
+
+				KPDMatch * match = kpdRecord->generateMatch(waitlistCandidate, donor, crossmatch, fiveYearSurvival[matchIndex], tenYearSurvival[matchIndex], true, rngMatchProperties);
+				matchIndex++;
+				allowableMatchExists = true;
+				
+				matches.push_back(match);
+
+			}
+			else {
+
+				// Generate blank match and add match to list
+				KPDMatch *noMatch = new KPDMatch();
+				noMatch->setVirtualCrossmatchResult(crossmatch);
+
+				matches.push_back(noMatch);
+
+			}
+		}
 		
-		int deceasedDonorID = deceasedDonor->getDonorID();
+		// If a match exists between the donor and waitlist candidate...
+		if (allowableMatchExists) {
+			// then store the list of matches
+			
+			//std::cout << donorNodeID << "->" << waitlistCandidateID << std::endl;
+
+			waitlistedCandidateMatches[waitlistCandidateID][donorNodeID] = matches;
+		}
+	}
+}
+
+void KPDSimulation::admitWaitlistedCandidate(KPDCandidate * waitlistCandidate, int position) {
+
+	int candidateIndex;
+
+	// Reuse the index of a released candidate if there is one
+	if (unusedWaitlistIndices.empty()) {
 
-		// Crossmatch with each KPD pair
-		for (std::vector<KPDNode *>::iterator itNode = kpdNodes.begin(); itNode != kpdNodes.end(); itNode++) {
+		candidateIndex = (int)waitlistedCandidates.size();
 
-			KPDNode * node = *itNode;
+		waitlistedCandidates.push_back(NULL);
+		waitlistedCandidatePositions.push_back(-1);
+
+		waitlistedCandidateStatus.push_back(STATUS_INACTIVE);
+		waitlistedCandidateTransplanted.push_back(TRANSPLANT_NO);
+
+		waitlistedCandidateStateTransitions.push_back(std::deque<KPDStatus>());
+		waitlistedCandidateStateTransitionTimes.push_back(std::deque<int>());
+	}
+	else {
+		candidateIndex = unusedWaitlistIndices.back();
+		unusedWaitlistIndices.pop_back();
+	}
 
-			// Only concerned with candidate nodes
-			if (node->getType() == PAIR) {
+	int waitlistCandidateID = waitlistCandidate->getCandidateID();
+
+	// Candidates are placed on the waitlist in the order they appear in the data (as when all candidates are loaded)
+	waitlistedCandidates[candidateIndex] = waitlistCandidate;
+	waitlistedCandidatePositions[candidateIndex] = position;
+
+	// Candidates may have received the kidney of their real donor before they are streamed
+	waitlistedCandidateStatus[candidateIndex] = STATUS_INACTIVE;
+	waitlistedCandidateTransplanted[candidateIndex] = transplantedWaitlistCandidateIDs.count(waitlistCandidateID) > 0 ? TRANSPLANT_YES : TRANSPLANT_NO;
+
+	waitlistedCandidateStateTransitions[candidateIndex] = waitlistCandidate->getStatuses();
+	waitlistedCandidateStateTransitionTimes[candidateIndex] = waitlistCandidate->getStatusChangeTimes();
+
+	waitlistOrder[position] = candidateIndex;
+	waitlistedCandidateIndices[waitlistCandidateID] = candidateIndex;
+
+	findWaitlistedCandidateMatches(waitlistCandidate);
+}
+
+void KPDSimulation::releaseWaitlistedCandidates() {
+
+	// Candidates who are transplanted, or who are withdrawn with no further state transitions, leave the waitlist (their indices are reused)
+	for (int i = 1; i <= (int)waitlistedCandidates.size(); i++) {
+
+		int candidateIndex = i - 1;
 
-				KPDCandidate * nodeCandidate = node->getCandidate();
+		if (waitlistedCandidates[candidateIndex] == NULL) {
+			continue;
+		}
 
-				int candidateNodeID = node->getID();
+		bool released = waitlistedCandidateTransplanted[candidateIndex] == TRANSPLANT_YES ||
+			(waitlistedCandidateStatus[candidateIndex] == STATUS_WITHDRAWN && waitlistedCandidateStateTransitions[candidateIndex].empty());
 
-				// Perform crossmatch
-				KPDCrossmatch crossmatch = kpdData->performCrossmatch(nodeCandidate, deceasedDonor, false);
+		if (!released) {
+			continue;
+		}
 
-				// If the crossmatch is viable...
-				if (kpdData->allowableMatch(crossmatch)) {
+		int waitlistCandidateID = waitlistedCandidates[candidateIndex]->getCandidateID();
 
-					// Generate the match properties associated with the match and store it
-					KPDMatch * match = kpdRecord->generateMatch(nodeCandidate, deceasedDonor, crossmatch, false);
+		if (waitlistedCandidateTransplanted[candidateIndex] == TRANSPLANT_YES) {
+			transplantedWaitlistCandidateIDs.insert(waitlistCandidateID);
+		}
 
-					deceasedDonorMatches[deceasedDonorID][candidateNodeID] = match;
+		std::map<int, std::map<int, std::vector<KPDMatch *> > >::iterator itCandidate = waitlistedCandidateMatches.find(waitlistCandidateID);
 
+		if (itCandidate != waitlistedCandidateMatches.end()) {
+			for (std::map<int, std::vector<KPDMatch *> >::iterator itMatches = itCandidate->second.begin(); itMatches != itCandidate->second.end(); itMatches++) {
+				for (std::vector<KPDMatch *>::iterator itMatch = itMatches->second.begin(); itMatch != itMatches->second.end(); itMatch++) {
+					delete *itMatch;
 				}
 			}
+			waitlistedCandidateMatches.erase(itCandidate);
 		}
+
+		delete waitlistedCandidates[candidateIndex];
+
+		waitlistedCandidates[candidateIndex] = NULL;
+
+		waitlistedCandidateStatus[candidateIndex] = STATUS_INACTIVE;
+		waitlistedCandidateTransplanted[candidateIndex] = TRANSPLANT_NO;
+
+		waitlistedCandidateStateTransitions[candidateIndex].clear();
+		waitlistedCandidateStateTransitionTimes[candidateIndex].clear();
+
+		waitlistOrder.erase(waitlistedCandidatePositions[candidateIndex]);
+		waitlistedCandidateIndices.erase(waitlistCandidateID);
+
+		unusedWaitlistIndices.push_back(candidateIndex);
 	}
 }
 
-void KPDSimulation::findWaitlistedCandidateMatches() {
+void KPDSimulation::releaseDeceasedDonor(KPDDonor * deceasedDonor) {
 
-	std::cout << "Assigning Waitlist Candidate Matches..." << std::endl;
+	std::map<int, std::map<int, KPDMatch *> >::iterator it = deceasedDonorMatches.find(deceasedDonor->getDonorID());
 
-	// Iterate through waitlist candidates
-	for (std::vector<KPDCandidate *>::iterator itCandidate = waitlistedCandidates.begin(); itCandidate != waitlistedCandidates.end(); itCandidate++) {
+	if (it != deceasedDonorMatches.end()) {
+		for (std::map<int, KPDMatch *>::iterator itMatch = it->second.begin(); itMatch != it->second.end(); itMatch++) {
+			delete itMatch->second;
+		}
+		deceasedDonorMatches.erase(it);
+	}
 
-		KPDCandidate * waitlistCandidate = *itCandidate;
+	delete deceasedDonor;
+}
 
-		int waitlistCandidateID = waitlistCandidate->getCandidateID();
+void KPDSimulation::clearStreamedData() {
 
-		// Crossmatch with each KPD node
-		for (std::vector<KPDNode *>::iterator itNode = kpdNodes.begin(); itNode != kpdNodes.end(); itNode++) {
+	for (std::deque<KPDDonor *>::iterator it = deceasedDonors.begin(); it != deceasedDonors.end(); it++) {
+		releaseDeceasedDonor(*it);
+	}
 
-			KPDNode * node = *itNode;
+	for (std::vector<KPDCandidate *>::iterator it = waitlistedCandidates.begin(); it != waitlistedCandidates.end(); it++) {
+		delete *it;
+	}
 
-			int donorNodeID = node->getID();
+	for (std::map<int, std::map<int, std::vector<KPDMatch *> > >::iterator it = waitlistedCandidateMatches.begin(); it != waitlistedCandidateMatches.end(); it++) {
+		for (std::map<int, std::vector<KPDMatch *> >::iterator itMatches = it->second.begin(); itMatches != it->second.end(); itMatches++) {
+			for (std::vector<KPDMatch *>::iterator itMatch = itMatches->second.begin(); itMatch != itMatches->second.end(); itMatch++) {
+				delete *itMatch;
+			}
+		}
+	}
 
-			int numberOfDonors = node->getNumberOfDonors();
+	deceasedDonors.clear();
+	deceasedDonorArrivalTimes.clear();
+	deceasedDonorMatches.clear();
 
-			std::vector<KPDMatch *> matches;
-			bool allowableMatchExists = false;
+	waitlistedCandidates.clear();
+	waitlistedCandidateMatches.clear();
 
-			// Iterate through donors
-			for (int k = 1; k <= numberOfDonors; k++) {
-				
-				int donorIndex = k - 1;
+	unusedWaitlistIndices.clear();
+	transplantedWaitlistCandidateIDs.clear();
+}
 
-				KPDDonor * donor = node->getDonor(donorIndex);
+void KPDSimulation::admitKPDNodes() {
 
-				// Perform crossmatch
-				KPDCrossmatch crossmatch = kpdData->performCrossmatch(waitlistCandidate, donor, true);
-				
-				// If the crossmatch is viable
-				if (kpdData->allowableMatch(crossmatch)) {
+	// Nodes arriving at the current time join the pool
+	std::vector<int> arrivingNodes;
+
+	while (nextArrivingKPDNode < (int)kpdNodeArrivals.size() && kpdNodeArrivals[nextArrivingKPDNode].first <= currentTime) {
+
+		if (kpdNodeArrivals[nextArrivingKPDNode].first == currentTime) {
+			arrivingNodes.push_back(kpdNodeArrivals[nextArrivingKPDNode].second);
+		}
+
+		nextArrivingKPDNode++;
+	}
+
+	if (arrivingNodes.size() == 0) {
+		return;
+	}
+
+	std::vector<int> presentNodes(kpdPoolNodes.begin(), kpdPoolNodes.end());
+
+	// Generate matches between the arriving nodes and the nodes in the pool (and among the arriving nodes)
+	std::vector<int> candidateNodes(presentNodes);
+	candidateNodes.insert(candidateNodes.end(), arrivingNodes.begin(), arrivingNodes.end());
+
+	kpdRecord->generateMatches(arrivingNodes, candidateNodes, kpdMatches, kpdAdjacency, kpdAdjacencyReduced);
+	kpdRecord->generateMatches(presentNodes, arrivingNodes, kpdMatches, kpdAdjacency, kpdAdjacencyReduced);
+
+	// Correct matches with bridge donors already in the pool (as when the bridge donors were formed)
+	for (std::vector<int>::iterator itBridge = presentNodes.begin(); itBridge != presentNodes.end(); itBridge++) {
+
+		int bridgeNodeIndex = *itBridge;
+
+		if (kpdNodeTypes[bridgeNodeIndex] != BRIDGE) {
+			continue;
+		}
+
+		int bridgeNodeID = kpdNodes[bridgeNodeIndex]->getID();
+
+		for (std::vector<int>::iterator itNode = arrivingNodes.begin(); itNode != arrivingNodes.end(); itNode++) {
 
-					// Generate the match properties and add match to list
-					KPDMatch * match = kpdRecord->generateMatch(waitlistCandidate, donor, crossmatch, true);
-					allowableMatchExists = true;
-					
-					matches.push_back(match);
+			int nodeIndex = *itNode;
+			int nodeID = kpdNodes[nodeIndex]->getID();
 
+			//Remove matches to the bridge donor node...
+			std::map<int, std::vector<KPDMatch *> >::iterator itMatches = kpdMatches[nodeID].find(bridgeNodeID);
+
+			if (itMatches != kpdMatches[nodeID].end()) {
+				for (std::vector<KPDMatch *>::iterator itMatch = itMatches->second.begin(); itMatch != itMatches->second.end(); itMatch++) {
+					(*itMatch)->setAdjacency(false);
 				}
-				else {
+			}
+
+			//...replaced by implicit matches from pairs
+			setAdjacency(kpdAdjacency, nodeIndex, bridgeNodeIndex, kpdNodeTypes[nodeIndex] == PAIR);
+			setAdjacency(kpdAdjacencyReduced, nodeIndex, bridgeNodeIndex, false);
+
+			//Remove implicit matches to altruistic donors
+			if (kpdNodeTypes[nodeIndex] != PAIR) {
+				setAdjacency(kpdAdjacency, bridgeNodeIndex, nodeIndex, false);
+				setAdjacency(kpdAdjacencyReduced, bridgeNodeIndex, nodeIndex, false);
+			}
+		}
+	}
+
+	kpdPoolNodes.insert(arrivingNodes.begin(), arrivingNodes.end());
+}
+
+void KPDSimulation::releaseKPDNodes() {
 
-					// Generate blank match and add match to list
-					KPDMatch *noMatch = new KPDMatch();
-					noMatch->setVirtualCrossmatchResult(crossmatch);
+	// Nodes that are transplanted, or that are withdrawn with no further state transitions, leave the pool (bridge donors remain)
+	std::vector<int> poolNodes(kpdPoolNodes.begin(), kpdPoolNodes.end());
 
-					matches.push_back(noMatch);
+	for (std::vector<int>::iterator itNode = poolNodes.begin(); itNode != poolNodes.end(); itNode++) {
 
+		int nodeIndex = *itNode;
+
+		if (kpdNodeTransplanted[nodeIndex] == TRANSPLANT_IN_PROGRESS) {
+			continue;
+		}
+
+		bool released = kpdNodeTransplanted[nodeIndex] == TRANSPLANT_YES ||
+			(kpdNodeTypes[nodeIndex] != BRIDGE && kpdNodeStatus[nodeIndex] == STATUS_WITHDRAWN && kpdNodeStateTransitions[nodeIndex].empty());
+
+		if (!released) {
+			continue;
+		}
+
+		int nodeID = kpdNodes[nodeIndex]->getID();
+
+		// Matches from the node
+		std::map<int, std::map<int, std::vector<KPDMatch *> > >::iterator itDonor = kpdMatches.find(nodeID);
+
+		if (itDonor != kpdMatches.end()) {
+			for (std::map<int, std::vector<KPDMatch *> >::iterator itMatches = itDonor->second.begin(); itMatches != itDonor->second.end(); itMatches++) {
+				for (std::vector<KPDMatch *>::iterator itMatch = itMatches->second.begin(); itMatch != itMatches->second.end(); itMatch++) {
+					delete *itMatch;
 				}
 			}
-			
-			// If a match exists between the donor and waitlist candidate...
-			if (allowableMatchExists) {
-				// then store the list of matches
-				
-				//std::cout << donorNodeID << "->" << waitlistCandidateID << std::endl;
+			kpdMatches.erase(itDonor);
+		}
+
+		// Matches to the node
+		for (std::map<int, std::map<int, std::vector<KPDMatch *> > >::iterator it = kpdMatches.begin(); it != kpdMatches.end(); it++) {
+
+			std::map<int, std::vector<KPDMatch *> >::iterator itMatches = it->second.find(nodeID);
 
-				waitlistedCandidateMatches[donorNodeID][waitlistCandidateID] = matches;
+			if (itMatches != it->second.end()) {
+				for (std::vector<KPDMatch *>::iterator itMatch = itMatches->second.begin(); itMatch != itMatches->second.end(); itMatch++) {
+					delete *itMatch;
+				}
+				it->second.erase(itMatches);
 			}
-		}		
+		}
+
+		// Adjacencies from and to the node
+		kpdAdjacency.erase(nodeIndex);
+		kpdAdjacencyReduced.erase(nodeIndex);
+
+		for (std::map<int, std::set<int> >::iterator it = kpdAdjacency.begin(); it != kpdAdjacency.end(); it++) {
+			it->second.erase(nodeIndex);
+		}
+		for (std::map<int, std::set<int> >::iterator it = kpdAdjacencyReduced.begin(); it != kpdAdjacencyReduced.end(); it++) {
+			it->second.erase(nodeIndex);
+		}
+
+		kpdPoolNodes.erase(nodeIndex);
 	}
 }
 
+void KPDSimulation::clearKPDMatches() {
+
+	for (std::map<int, std::map<int, std::vector<KPDMatch *> > >::iterator it = kpdMatches.begin(); it != kpdMatches.end(); it++) {
+		for (std::map<int, std::vector<KPDMatch *> >::iterator itMatches = it->second.begin(); itMatches != it->second.end(); itMatches++) {
+			for (std::vector<KPDMatch *>::iterator itMatch = itMatches->second.begin(); itMatch != itMatches->second.end(); itMatch++) {
+				delete *itMatch;
+			}
+		}
+	}
+
+	kpdMatches.clear();
+}
+
 int KPDSimulation::allocateDonor(KPDDonor * donor) {
 
 	// Function is called when a deceased donor is not allocated to their real-life candidate
 	// This will have to be enhanced in order to follow the allocation protocols listed in the files
 
-	// Iterate through candidates
-	for (int i = 1; i <= waitlistedCandidates.size(); i++) {
+	// Candidates who are active and not transplanted, in waitlist order
+	std::vector<KPDCandidate *> candidates;
+	std::vector<int> candidateIndices;
+	std::vector<KPDCrossmatch> crossmatches;
 
-		int candidateIndex = i - 1;
-		KPDCandidate * candidate = waitlistedCandidates[candidateIndex];
+	std::map<int, int>::iterator it = waitlistOrder.begin();
 
-		// If the candidate is active and not transplanted...
-		if (waitlistedCandidateStatus[candidateIndex] == STATUS_ACTIVE &&
-			waitlistedCandidateStatus[candidateIndex] == TRANSPLANT_NO) {
-				
-			// Perform a crossmatch			
-			KPDCrossmatch crossmatch = kpdData->performCrossmatch(candidate, donor, true);
+	while (it != waitlistOrder.end()) {
 
-			// If the crossmatch passes, return the index of the candidate as the allocation
-			if (kpdData->allowableMatch(crossmatch)) {
-				return candidateIndex;
+		candidates.clear();
+		candidateIndices.clear();
+
+		while (it != waitlistOrder.end() && (int)candidates.size() < ALLOCATION_CROSSMATCH_CHUNK_SIZE) {
+
+			int candidateIndex = it->second;
+
+			if (waitlistedCandidateStatus[candidateIndex] == STATUS_ACTIVE &&
+				waitlistedCandidateStatus[candidateIndex] == TRANSPLANT_NO) {
+
+				candidates.push_back(waitlistedCandidates[candidateIndex]);
+				candidateIndices.push_back(candidateIndex);
+			}
+
+			it++;
+		}
+
+		// Perform crossmatches
+		kpdData->performCrossmatchBatch(donor, candidates, true, crossmatches);
+
+		// The first candidate whose crossmatch passes is the allocation
+		for (int i = 0; i < (int)candidates.size(); i++) {
+			if (kpdData->allowableMatch(crossmatches[i])) {
+				return candidateIndices[i];
 			}
 		}
 	}
@@ -441,6 +864,33 @@ int KPDSimulation::allocateDonor(KPDDonor * donor) {
 }
 
 
+void KPDSimulation::runStreamingStage() {
+
+	// Candidates join the waitlist at their first status change
+	int position;
+	KPDCandidate * waitlistCandidate = kpdData->nextWaitlistedCandidate(currentTime, position);
+
+	while (waitlistCandidate != NULL) {
+
+		admitWaitlistedCandidate(waitlistCandidate, position);
+
+		waitlistCandidate = kpdData->nextWaitlistedCandidate(currentTime, position);
+	}
+
+	// Deceased donors are read as they are recovered
+	KPDDonor * deceasedDonor = kpdData->nextDeceasedDonor(currentTime);
+
+	while (deceasedDonor != NULL) {
+
+		deceasedDonors.push_back(deceasedDonor);
+		deceasedDonorArrivalTimes.push_back(deceasedDonor->getRecoveryTime());
+
+		findDeceasedDonorMatches(deceasedDonor);
+
+		deceasedDonor = kpdData->nextDeceasedDonor(currentTime);
+	}
+}
+
 void KPDSimulation::runStateTransitionStage() {
 
 	// Iterate through waitlist candidates
@@ -471,6 +921,9 @@ void KPDSimulation::runStateTransitionStage() {
 		}	
 	}
 	
+	// Generate matches for KPD nodes arriving at the current time
+	admitKPDNodes();
+
 	// Iterate through KPD nodes
 	for (int i = 1; i <= (int) kpdNodeStateTransitionTimes.size(); i++) {
 
@@ -509,7 +962,7 @@ void KPDSimulation::runMatchRunStage() {
 	std::vector<double> assignedValueOfMatchRunArrangements;
 
 	KPDMatchRun * matchRun = new KPDMatchRun(kpdParameters, currentIteration, currentTime,
-		kpdNodes, kpdNodeTypes, kpdNodeStatus, kpdNodeTransplanted, kpdMatches);
+		kpdNodes, kpdNodeTypes, kpdNodeStatus, kpdNodeTransplanted, kpdMatches, threadPool);
 	
 	// Find all the LRSs in the current pool
 	matchRun->collectCyclesAndChainsForCurrentMatchRun(matchRunArrangements);
@@ -519,13 +972,93 @@ void KPDSimulation::runMatchRunStage() {
 	if (matchRunArrangements.size() > 0) {
 		
 		// Assign the appropriate utility values to the LRSs
-		matchRun->assignExpectedUtilitiesForCurrentMatchRun(matchRunArrangements, assignedValueOfMatchRunArrangements); 
-		std::cout << "Utilities Assigned" << std::endl;
+		std::vector<int> uncachedArrangements;
+		std::vector<std::vector<int> > arrangementVersions;
+
+		assignedValueOfMatchRunArrangements.assign(matchRunArrangements.size(), 0.0);
+
+		for (int i = 1; i <= (int)matchRunArrangements.size(); i++) {
+
+			int arrangementIndex = i - 1;
+
+			// Reuse expected utilities of arrangements whose nodes are unchanged since they were last evaluated
+			if (kpdParameters->getCacheExpectedUtility()) {
+
+				arrangementVersions.push_back(getArrangementVersions(matchRunArrangements[arrangementIndex]));
+
+				std::map<std::vector<int>, std::pair<std::vector<int>, double> >::iterator itCache = expectedUtilityCache.find(matchRunArrangements[arrangementIndex]);
+
+				if (itCache != expectedUtilityCache.end() && itCache->second.first == arrangementVersions[arrangementIndex]) {
+					assignedValueOfMatchRunArrangements[arrangementIndex] = itCache->second.second;
+					continue;
+				}
+			}
+
+			uncachedArrangements.push_back(arrangementIndex);
+		}
 
-		// Select optimal set of LRSs
 		std::vector<int> optimalSolution;
+		std::vector<int> evaluatedArrangements;
+
+		if (kpdParameters->getLazyExpectedUtility()) {
+
+			// Start from upper bounds; an optimal solution whose arrangements all have expected utilities is optimal for the expected utilities
+			matchRun->assignUpperBoundUtilitiesForSelectedArrangements(matchRunArrangements, uncachedArrangements, assignedValueOfMatchRunArrangements);
+
+			std::vector<bool> evaluated(matchRunArrangements.size(), true);
+			for (std::vector<int>::iterator it = uncachedArrangements.begin(); it != uncachedArrangements.end(); it++) {
+				evaluated[*it] = false;
+			}
+
+			int rounds = 0;
+
+			while (true) {
 
-		matchRun->getOptimalSolutionForCurrentMatchRun(optimalSolution, matchRunArrangements, assignedValueOfMatchRunArrangements);
+				optimalSolution.clear();
+				matchRun->getOptimalSolutionForCurrentMatchRun(optimalSolution, matchRunArrangements, assignedValueOfMatchRunArrangements);
+				rounds++;
+
+				// Evaluate selected arrangements that only have upper bounds, and re-solve
+				std::vector<int> boundedArrangements;
+				for (std::vector<int>::iterator it = optimalSolution.begin(); it != optimalSolution.end(); it++) {
+					if (!evaluated[*it]) {
+						boundedArrangements.push_back(*it);
+						evaluated[*it] = true;
+					}
+				}
+
+				if (boundedArrangements.empty()) {
+					break;
+				}
+
+				matchRun->assignExpectedUtilitiesForSelectedArrangements(matchRunArrangements, boundedArrangements, assignedValueOfMatchRunArrangements);
+
+				evaluatedArrangements.insert(evaluatedArrangements.end(), boundedArrangements.begin(), boundedArrangements.end());
+			}
+
+			kpdSimulationLog << "Expected Utilities Evaluated Lazily: " << evaluatedArrangements.size() << " of " << uncachedArrangements.size() << " (" << rounds << " Optimization Rounds)" << std::endl;
+		}
+		else {
+			matchRun->assignExpectedUtilitiesForSelectedArrangements(matchRunArrangements, uncachedArrangements, assignedValueOfMatchRunArrangements);
+
+			evaluatedArrangements = uncachedArrangements;
+		}
+		std::cout << "Utilities Assigned" << std::endl;
+
+		// Only expected utilities are cached, never upper bounds
+		if (kpdParameters->getCacheExpectedUtility()) {
+
+			for (std::vector<int>::iterator it = evaluatedArrangements.begin(); it != evaluatedArrangements.end(); it++) {
+				expectedUtilityCache[matchRunArrangements[*it]] = std::make_pair(arrangementVersions[*it], assignedValueOfMatchRunArrangements[*it]);
+			}
+
+			kpdSimulationLog << "Expected Utilities Reused: " << matchRunArrangements.size() - uncachedArrangements.size() << " of " << matchRunArrangements.size() << std::endl;
+		}
+
+		// Select optimal set of LRSs
+		if (!kpdParameters->getLazyExpectedUtility()) {
+			matchRun->getOptimalSolutionForCurrentMatchRun(optimalSolution, matchRunArrangements, assignedValueOfMatchRunArrangements);
+		}
 
 		kpdSimulationLog << matchRun->printLog() << std::endl;
 
@@ -576,7 +1109,7 @@ void KPDSimulation::runMatchRunStage() {
 
 					KPDNode * node = kpdNodes[nodeIndex];
 
-					arrangementNodes.push_back(node->copy()); // Copy Arrangement Nodes				
+					arrangementNodes.push_back(node->copy()); // Copy Arrangement Nodes (sharing their profiles)				
 					arrangementNodeTypes.push_back(kpdNodeTypes[nodeIndex]);
 
 					kpdNodeTransplanted[nodeIndex] = TRANSPLANT_IN_PROGRESS; // Mark Nodes in Arrangement as TRANSPLANT_IN_PROGRESS
@@ -605,7 +1138,8 @@ void KPDSimulation::runMatchRunStage() {
 			}
 
 			outputKPDExchanges << "," << KPDFunctions::boolToYesNo(ndd) << "," << arrangementUtility << ",";
-			outputKPDExchanges << KPDFunctions::boolToYesNo(arrangementIsPartOfOptimalSolution) << std::endl;
+			outputKPDExchanges << KPDFunctions::boolToYesNo(arrangementIsPartOfOptimalSolution) << ",";
+			outputKPDExchanges << KPDFunctions::expectedUtilityMethodToString(matchRun->getExpectedUtilityMethod(arrangementIndex)) << "," << matchRun->getExpectedUtilityTime(arrangementIndex) << std::endl;
 
 			//i++;
 		}
@@ -621,7 +1155,7 @@ void KPDSimulation::runMatchRunStage() {
 
 void KPDSimulation::runDeceasedDonorAllocationStage() {
 
-	while (deceasedDonorArrivalTimes.front() == currentTime) {
+	while (!deceasedDonorArrivalTimes.empty() && deceasedDonorArrivalTimes.front() <= currentTime) {
 
 		// Deceased donor arrives
 
@@ -683,14 +1217,13 @@ void KPDSimulation::runDeceasedDonorAllocationStage() {
 					int deceasedDonorOPO = deceasedDonor->getOPO();
 					KPDBloodType deceasedDonorBT = deceasedDonor->getBT();
 
-					std::vector<std::string> deceasedDonorHLA = deceasedDonor->getHLA();
+					const KPDHLA & deceasedDonorHLA = deceasedDonor->getHLA();
 
 					// Iterate through waitlist to find eligible candidates
-					for (std::vector<KPDCandidate *>::iterator it = waitlistedCandidates.begin(); it != waitlistedCandidates.end(); it++) {
+					for (std::map<int, int>::iterator it = waitlistOrder.begin(); it != waitlistOrder.end(); it++) {
 
-						KPDCandidate * waitlistCandidate = *it;
-						int waitlistCandidateID = waitlistCandidate->getCandidateID();
-						int waitlistCandidateIndex = indexOfWaitlistedCandidate(waitlistCandidateID);
+						int waitlistCandidateIndex = it->second;
+						KPDCandidate * waitlistCandidate = waitlistedCandidates[waitlistCandidateIndex];
 
 						// Eligible and priority candidates need to be active, untransplanted...
 						if (waitlistedCandidateTransplanted[waitlistCandidateIndex] == TRANSPLANT_NO &&
@@ -714,21 +1247,7 @@ void KPDSimulation::runDeceasedDonorAllocationStage() {
 								//int waitlistCandidatePrevTrans = waitlistCandidate->getPrevTrans();
 								int waitlistCandidateAge = waitlistCandidate->getAge();
 
-								std::vector<std::string> waitlistCandidateHLA = waitlistCandidate->getHLA();
-
-								bool mismatch = false;
-								for (std::vector<std::string>::iterator dHLAIt = deceasedDonorHLA.begin(); dHLAIt != deceasedDonorHLA.end(); dHLAIt++) {
-									for (std::vector<std::string>::iterator cHLAIt = waitlistCandidateHLA.begin(); cHLAIt != waitlistCandidateHLA.end(); cHLAIt++) {
-										if (*dHLAIt == *cHLAIt) {
-											mismatch = true;
-											break;
-										}
-									}
-
-									if (mismatch) {
-										break;
-									}
-								}
+								bool mismatch = deceasedDonorHLA.countShared(waitlistCandidate->getHLA()) > 0;
 
 								if (waitlistCandidatePRA == 100 ||
 									waitlistCandidatePRA == 99 ||
@@ -837,7 +1356,7 @@ void KPDSimulation::runDeceasedDonorAllocationStage() {
 								KPDNode * kpdNode = kpdNodes[kpdNodeIndex];
 								int kpdNodeID = kpdNode->getID();
 
-								if (waitlistedCandidateMatches[kpdNodeID][candidateID].size() > 0) {
+								if (waitlistedCandidateMatches[candidateID][kpdNodeID].size() > 0) {
 
 									int numberOfDonors = kpdNode->getNumberOfDonors();
 
@@ -845,19 +1364,9 @@ void KPDSimulation::runDeceasedDonorAllocationStage() {
 
 										int donorIndex = k - 1;
 
-										if (waitlistedCandidateMatches[kpdNodeID][candidateID][donorIndex]->getAdjacency()) {
-
-											std::vector<std::string> donorHLA = kpdNode->getDonor(donorIndex)->getHLA();
-											std::vector<std::string> candidateHLA = candidate->getHLA();
+										if (waitlistedCandidateMatches[candidateID][kpdNodeID][donorIndex]->getAdjacency()) {
 
-											int mismatches = 0;
-											for (std::vector<std::string>::iterator dHLAIt = donorHLA.begin(); dHLAIt != donorHLA.end(); dHLAIt++) {
-												for (std::vector<std::string>::iterator cHLAIt = candidateHLA.begin(); cHLAIt != candidateHLA.end(); cHLAIt++) {
-													if (*dHLAIt == *cHLAIt) {
-														mismatches++;
-													}
-												}
-											}
+											int mismatches = kpdNode->getDonor(donorIndex)->getHLA().countShared(candidate->getHLA());
 											
 											double totalPoints = candidateBasePoints;
 
@@ -904,7 +1413,7 @@ void KPDSimulation::runDeceasedDonorAllocationStage() {
 
 							else {
 
-								KPDMatch * kpdToWaitlistMatch = waitlistedCandidateMatches[selectedKPDNodeID][selectedWaitlistCandidateID][selectedDonorIndex];
+								KPDMatch * kpdToWaitlistMatch = waitlistedCandidateMatches[selectedWaitlistCandidateID][selectedKPDNodeID][selectedDonorIndex];
 
 								kpdNodeTransplanted[indexOfKPDNode(selectedKPDNodeID)] = TRANSPLANT_YES;
 
@@ -914,7 +1423,9 @@ void KPDSimulation::runDeceasedDonorAllocationStage() {
 
 									int allocatedCandidateIndex = allocateDonor(kpdNodes[selectedKPDNodeIndex]->getDonor(selectedDonorIndex));
 
-									waitlistedCandidateTransplanted[allocatedCandidateIndex] = TRANSPLANT_YES;
+									if (allocatedCandidateIndex >= 0) {
+										waitlistedCandidateTransplanted[allocatedCandidateIndex] = TRANSPLANT_YES;
+									}
 
 								}
 
@@ -970,17 +1481,32 @@ void KPDSimulation::runDeceasedDonorAllocationStage() {
 
 				int realMatchedCandidateIndex = indexOfWaitlistedCandidate(*it);
 
-				if (waitlistedCandidateTransplanted[realMatchedCandidateIndex] == TRANSPLANT_NO) {
-					waitlistedCandidateTransplanted[realMatchedCandidateIndex] = TRANSPLANT_YES;
+				if (realMatchedCandidateIndex >= 0) {
+					if (waitlistedCandidateTransplanted[realMatchedCandidateIndex] == TRANSPLANT_NO) {
+						waitlistedCandidateTransplanted[realMatchedCandidateIndex] = TRANSPLANT_YES;
+						foundWaitlistCandidate = true;
+					}
+				}
+
+				// Streamed candidates who are withdrawn and released, or not yet streamed, still receive the kidney (as when all candidates are loaded)
+				else if (streamDeceasedDonorsAndWaitlist && transplantedWaitlistCandidateIDs.count(*it) == 0) {
+					transplantedWaitlistCandidateIDs.insert(*it);
 					foundWaitlistCandidate = true;
 				}
 			}
 
 			if (!foundWaitlistCandidate) {
 				int simulatedMatchedCandidateIndex = allocateDonor(deceasedDonor);
-				waitlistedCandidateTransplanted[simulatedMatchedCandidateIndex] = TRANSPLANT_YES;
+
+				if (simulatedMatchedCandidateIndex >= 0) {
+					waitlistedCandidateTransplanted[simulatedMatchedCandidateIndex] = TRANSPLANT_YES;
+				}
 			}
 		}
+
+		if (streamDeceasedDonorsAndWaitlist) {
+			releaseDeceasedDonor(deceasedDonor);
+		}
 	}
 
 }
@@ -1040,6 +1566,9 @@ void KPDSimulation::runTransplantationStage() {
 									kpdSimulationLog << "Match " << donorNodeID << "[" << k << "] -> " << candidateNodeID << " Successful (-> 1)" << std::endl;
 									if (kpdMatches[donorNodeID][candidateNodeID][donorIndex]->getAssumedSuccessProbability() != 1.0) {
 										kpdMatches[donorNodeID][candidateNodeID][donorIndex]->setAssumedSuccessProbability(1.0); // Probability updated to reflect successful crossmatch
+
+										kpdNodeVersions[donorNodeIndex]++;
+										kpdNodeVersions[candidateNodeIndex]++;
 									}
 								}
 								else {
@@ -1092,15 +1621,17 @@ void KPDSimulation::runTransplantationStage() {
 
 						kpdNodeTypes[bridgeNodeIndex] = BRIDGE;
 						kpdNodeTransplanted[bridgeNodeIndex] = TRANSPLANT_NO;
+						kpdNodeVersions[bridgeNodeIndex]++;
 						
-						//Correct bridge donor
-						for (int i = 1; i <= (int)kpdNodes.size(); i++) {
+						//Correct bridge donor (only nodes in the pool have matches)
+						for (std::set<int>::iterator itPool = kpdPoolNodes.begin(); itPool != kpdPoolNodes.end(); itPool++) {
 							
-							int nodeIndex = i - 1;
+							int nodeIndex = *itPool;
+							int i = nodeIndex + 1;
 
 							if (nodeIndex != bridgeNodeIndex) {
 								//Remove matches to new bridge donor node
-								if (kpdAdjacencyMatrix[i][bridgeNodeIndex + 1]) {
+								if (getAdjacency(kpdAdjacency, nodeIndex, bridgeNodeIndex)) {
 									for (int k = 1; k <= kpdNodes[i]->getNumberOfDonors(); k++) {
 
 										int donorIndex = k - 1;
@@ -1109,7 +1640,7 @@ void KPDSimulation::runTransplantationStage() {
 								}
 
 								//Remove implict matches to all altruistic or bridge donors
-								if (kpdAdjacencyMatrix[bridgeNodeIndex + 1][i] && kpdNodeTypes[nodeIndex] != PAIR) {
+								if (getAdjacency(kpdAdjacency, bridgeNodeIndex, nodeIndex) && kpdNodeTypes[nodeIndex] != PAIR) {
 									for (int k = 1; k <= kpdNodes[bridgeNodeIndex]->getNumberOfDonors(); k++) { /// CHECK THIS AGAIN!
 
 										int donorIndex = k - 1;
@@ -1119,7 +1650,7 @@ void KPDSimulation::runTransplantationStage() {
 
 								//Add (implicit) matches from all pairs to new bridge donor node
 								if (kpdNodeTypes[nodeIndex] == PAIR) {
-									kpdAdjacencyMatrix[i][bridgeNodeIndex + 1] = true;
+									setAdjacency(kpdAdjacency, nodeIndex, bridgeNodeIndex, true);
 								}
 							}
 						}
@@ -1202,10 +1733,19 @@ void KPDSimulation::runIteration(int iteration) {
 
 	transplantQueue.clear();
 
-	deceasedDonors = kpdData->getDeceasedDonors();
-	deceasedDonorArrivalTimes = kpdData->getDeceasedDonorArrivalTimes();
+	if (streamDeceasedDonorsAndWaitlist) {
 
-	waitlistedCandidates = kpdData->getWaitlistedCandidates();
+		// Deceased donors and waitlisted candidates are added as the simulation reaches them
+		clearStreamedData();
+		kpdData->restartStreams();
+	}
+
+	else {
+		deceasedDonors = kpdData->getDeceasedDonors();
+		deceasedDonorArrivalTimes = kpdData->getDeceasedDonorArrivalTimes();
+
+		waitlistedCandidates = kpdData->getWaitlistedCandidates();
+	}
 
 	waitlistedCandidateStatus.assign(waitlistedCandidates.size(), STATUS_INACTIVE);
 	waitlistedCandidateTransplanted.assign(waitlistedCandidates.size(), TRANSPLANT_NO);
@@ -1213,12 +1753,28 @@ void KPDSimulation::runIteration(int iteration) {
 	waitlistedCandidateStateTransitions = kpdData->getWaitlistCandidatesStateTransitionMatrix();
 	waitlistedCandidateStateTransitionTimes = kpdData->getWaitlistCandidatesStateTransitionTimeMatrix();
 
+	waitlistedCandidatePositions.clear();
+	waitlistOrder.clear();
+	waitlistedCandidateIndices.clear();
+
+	for (int i = 1; i <= (int)waitlistedCandidates.size(); i++) {
+
+		int candidateIndex = i - 1;
+
+		waitlistedCandidatePositions.push_back(candidateIndex);
+		waitlistOrder[candidateIndex] = candidateIndex;
+		waitlistedCandidateIndices[waitlistedCandidates[candidateIndex]->getCandidateID()] = candidateIndex;
+	}
+
 	kpdNodes = kpdRecord->getNodes();
 	kpdNodeTypes = kpdRecord->getNodeTypes();
 
 	kpdNodeStatus.assign(kpdNodes.size(), STATUS_INACTIVE);
 	kpdNodeTransplanted.assign(kpdNodes.size(), TRANSPLANT_NO);
 
+	kpdNodeVersions.assign(kpdNodes.size(), 0);
+	expectedUtilityCache.clear();
+
 	kpdNodeStateTransitions = kpdRecord->getKPDNodeStateTransitionMatrix();
 	kpdNodeStateTransitionTimes = kpdRecord->getKPDNodeStateTransitionTimeMatrix();
 
@@ -1228,12 +1784,21 @@ void KPDSimulation::runIteration(int iteration) {
 	waitlistedCandidateMatches.clear();
 	findWaitlistedCandidateMatches(); // Collect the matches between the KPD and waitlist candidates
 
-	kpdMatches = kpdRecord->getKPDMatches();
+	// Matches are generated as nodes arrive, and released as nodes leave the pool
+	clearKPDMatches();
 
-	kpdAdjacencyMatrix = kpdRecord->getAdjacencyMatrix();
-	kpdAdjacencyMatrixReduced = kpdRecord->getAdjacencyMatrixReduced();
+	kpdPoolNodes.clear();
 
-	kpdToWaitlistAdjacencyMatrix.assign(1 + (int)kpdNodes.size(), std::vector<bool>(1 + (int)waitlistedCandidates.size(), false)); // Blank matrix
+	kpdNodeArrivals.clear();
+	for (int i = 1; i <= (int)kpdNodes.size(); i++) {
+		kpdNodeArrivals.push_back(std::pair<int, int>(kpdNodes[i - 1]->getArrivalTime(), i - 1));
+	}
+	std::sort(kpdNodeArrivals.begin(), kpdNodeArrivals.end()); // Nodes arriving together stay in index order
+
+	nextArrivingKPDNode = 0;
+
+	kpdAdjacency.clear();
+	kpdAdjacencyReduced.clear();
 	
 
 	// Clear output streams
@@ -1254,12 +1819,21 @@ void KPDSimulation::runIteration(int iteration) {
 	int matchRunTime = *it;
 	it++;
 
+	if (streamDeceasedDonorsAndWaitlist) {
+		runStreamingStage();
+	}
+
 	runStateTransitionStage(); // For initial KPD
 
 	while (currentTime < timeSimulation) {
 
 		currentTime++;
 
+		// Read deceased donors and waitlisted candidates arriving at new time
+		if (streamDeceasedDonorsAndWaitlist) {
+			runStreamingStage();
+		}
+
 		// Update all state changes at new time
 		runStateTransitionStage();
 
@@ -1278,6 +1852,14 @@ void KPDSimulation::runIteration(int iteration) {
 
 		// Perform transplantations
 		runTransplantationStage();
+
+		// Release KPD nodes that have left the pool
+		releaseKPDNodes();
+
+		// Release waitlisted candidates who are no longer active
+		if (streamDeceasedDonorsAndWaitlist) {
+			releaseWaitlistedCandidates();
+		}
 	}
 
 	// Remaining state transitions and final transplantation stage
@@ -1287,6 +1869,7 @@ void KPDSimulation::runIteration(int iteration) {
 
 		runStateTransitionStage();
 		runTransplantationStage();
+		releaseKPDNodes();
 	}
 }
 
@@ -0,0 +1,519 @@
+/* ---------------------------------------------
+DD-Survival.h
+Defines the Graft Survival Model, Compiled from the Survival Parameters
+---------------------------------------------- */
+
+#ifndef SURVIVAL_H
+#define SURVIVAL_H
+
+#include "DD-Enums-Functions.h"
+#include "DD-Candidate.h"
+#include "DD-Donor.h"
+
+#include <math.h>
+
+#include <vector>
+#include <string>
+#include <map>
+#include <iostream>
+
+/* Coefficients are indexed by horizon first: 5-year survival, then 10-year survival */
+#define SURVIVAL_5_YEAR 0
+#define SURVIVAL_10_YEAR 1
+#define SURVIVAL_HORIZONS 2
+
+#define SURVIVAL_AGE_GROUPS 7
+
+/* The linear predictor splits into candidate-only terms, donor-only terms (both computed once per person),
+and pair terms (recipient age group by donor age, sex, weight ratio and height ratio) */
+class KPDSurvivalModel {
+
+private:
+
+	double baseline[SURVIVAL_HORIZONS];
+	double logBaseline[SURVIVAL_HORIZONS]; // Survival is baseline^exp(lp), evaluated as exp(exp(lp) * log(baseline))
+	double constant[SURVIVAL_HORIZONS]; // HLA-ABDR mismatch and transplant year
+
+	//Candidate Terms
+	double recipientAge[SURVIVAL_HORIZONS][SURVIVAL_AGE_GROUPS]; // 40-49 is the reference group
+	double recipientBMI[SURVIVAL_HORIZONS];
+	double recipientRace[SURVIVAL_HORIZONS][4];
+	double pra[SURVIVAL_HORIZONS][3];
+	double recipientDiabetes[SURVIVAL_HORIZONS];
+	double previousTransplant[SURVIVAL_HORIZONS];
+	double timeOnDialysis[SURVIVAL_HORIZONS][5];
+	double recipientHepC[SURVIVAL_HORIZONS];
+	double recipientInsurance[SURVIVAL_HORIZONS][3];
+
+	//Donor Terms
+	double donorBMI[SURVIVAL_HORIZONS];
+	double donorRace[SURVIVAL_HORIZONS][3];
+	double donorCigaretteUse[SURVIVAL_HORIZONS];
+
+	//Pair Terms
+	double donorAge[SURVIVAL_HORIZONS][SURVIVAL_AGE_GROUPS][4]; // Donor age change points, by recipient age group
+	double sex[SURVIVAL_HORIZONS][4];
+	double weightRatio[SURVIVAL_HORIZONS][4];
+	double heightRatio[SURVIVAL_HORIZONS][3];
+
+	bool compiled;
+
+	// Copies the levels of a characteristic (missing parameters are reported and left at 0)
+	void compileParameter(const std::map<std::string, std::vector<double> > & parameters, const std::string & characteristic, double * coefficients, int levels, int firstLevel = 0);
+
+	static int recipientAgeGroup(int age);
+
+	// Stored terms of the candidate or donor, or (when not set) the terms calculated into the buffer
+	const double * getCandidateTerms(KPDCandidate * candidate, double buffer[SURVIVAL_HORIZONS]);
+	const double * getDonorTerms(KPDDonor * donor, double buffer[SURVIVAL_HORIZONS]);
+
+	void calculateLinearPredictors(KPDCandidate * candidate, const double candidateTerms[SURVIVAL_HORIZONS], KPDDonor * donor, const double donorTerms[SURVIVAL_HORIZONS], double linearPredictors[SURVIVAL_HORIZONS]);
+
+public:
+
+	KPDSurvivalModel();
+	~KPDSurvivalModel();
+
+	// Compiles the parameters read from the survival parameter file (keyed by "5 Year ..." and "10 Year ...")
+	void compile(const std::map<std::string, std::vector<double> > & parameters);
+	bool isCompiled();
+
+	void calculateCandidateTerms(KPDCandidate * candidate, double terms[SURVIVAL_HORIZONS]);
+	void calculateDonorTerms(KPDDonor * donor, double terms[SURVIVAL_HORIZONS]);
+
+	// Both horizons in one pass
+	void calculateSurvival(KPDCandidate * candidate, KPDDonor * donor, double survival[SURVIVAL_HORIZONS]);
+
+	// Pairs (candidates[i], donors[i]) in parallel arrays, or one candidate against many donors: linear predictors are
+	// gathered pair by pair, then survival is evaluated over contiguous arrays (a loop the compiler can vectorize)
+	void calculateSurvivalBatch(const std::vector<KPDCandidate *> & candidates, const std::vector<KPDDonor *> & donors, std::vector<double> & fiveYearSurvival, std::vector<double> & tenYearSurvival);
+	void calculateSurvivalBatch(KPDCandidate * candidate, const std::vector<KPDDonor *> & donors, std::vector<double> & fiveYearSurvival, std::vector<double> & tenYearSurvival);
+};
+
+KPDSurvivalModel::KPDSurvivalModel() {
+
+	compiled = false;
+
+	// Zero all coefficients, without reporting them as missing
+	for (int h = 0; h < SURVIVAL_HORIZONS; h++) {
+
+		baseline[h] = 0.0;
+		logBaseline[h] = log(0.0);
+		constant[h] = 0.0;
+
+		for (int i = 0; i < SURVIVAL_AGE_GROUPS; i++) {
+			recipientAge[h][i] = 0.0;
+			for (int j = 0; j < 4; j++) {
+				donorAge[h][i][j] = 0.0;
+			}
+		}
+		for (int i = 0; i < 5; i++) {
+			timeOnDialysis[h][i] = 0.0;
+		}
+		for (int i = 0; i < 4; i++) {
+			recipientRace[h][i] = 0.0;
+			sex[h][i] = 0.0;
+			weightRatio[h][i] = 0.0;
+		}
+		for (int i = 0; i < 3; i++) {
+			pra[h][i] = 0.0;
+			recipientInsurance[h][i] = 0.0;
+			donorRace[h][i] = 0.0;
+			heightRatio[h][i] = 0.0;
+		}
+
+		recipientBMI[h] = 0.0;
+		recipientDiabetes[h] = 0.0;
+		previousTransplant[h] = 0.0;
+		recipientHepC[h] = 0.0;
+		donorBMI[h] = 0.0;
+		donorCigaretteUse[h] = 0.0;
+	}
+}
+
+KPDSurvivalModel::~KPDSurvivalModel() {
+
+}
+
+void KPDSurvivalModel::compileParameter(const std::map<std::string, std::vector<double> > & parameters, const std::string & characteristic, double * coefficients, int levels, int firstLevel) {
+
+	std::string horizons[SURVIVAL_HORIZONS] = { "5 Year ", "10 Year " };
+
+	for (int h = 0; h < SURVIVAL_HORIZONS; h++) {
+
+		std::map<std::string, std::vector<double> >::const_iterator it = parameters.find(horizons[h] + characteristic);
+
+		if (it == parameters.end() || (int)it->second.size() < firstLevel + levels) {
+			std::cerr << "Missing survival parameter: " << horizons[h] << characteristic << std::endl;
+		}
+
+		for (int l = 0; l < levels; l++) {
+
+			if (it != parameters.end() && firstLevel + l < (int)it->second.size()) {
+				coefficients[h * levels + l] = it->second[firstLevel + l];
+			}
+			else {
+				coefficients[h * levels + l] = 0.0;
+			}
+		}
+	}
+}
+
+int KPDSurvivalModel::recipientAgeGroup(int age) {
+
+	if (age < 13) {
+		return 0;
+	}
+	else if (age <= 17) {
+		return 1;
+	}
+	else if (age <= 29) {
+		return 2;
+	}
+	else if (age <= 39) {
+		return 3;
+	}
+	else if (age <= 49) {
+		return 4;
+	}
+	else if (age <= 59) {
+		return 5;
+	}
+
+	return 6;
+}
+
+void KPDSurvivalModel::compile(const std::map<std::string, std::vector<double> > & parameters) {
+
+	compileParameter(parameters, "Baseline", baseline, 1);
+
+	compileParameter(parameters, "Recipient Age", &recipientAge[0][0], SURVIVAL_AGE_GROUPS);
+	compileParameter(parameters, "Recipient BMI", recipientBMI, 1, 1);
+	compileParameter(parameters, "Recipient Race", &recipientRace[0][0], 4);
+	compileParameter(parameters, "PRA", &pra[0][0], 3);
+	compileParameter(parameters, "Recipient Diabetes Status", recipientDiabetes, 1, 1);
+	compileParameter(parameters, "Previous Transplant", previousTransplant, 1, 1);
+	compileParameter(parameters, "Time on Dialysis", &timeOnDialysis[0][0], 5);
+	compileParameter(parameters, "Recipient Hepatitis C Seriology", recipientHepC, 1, 1);
+	compileParameter(parameters, "Recipient Insurance", &recipientInsurance[0][0], 3);
+
+	compileParameter(parameters, "Donor BMI", donorBMI, 1, 1);
+	compileParameter(parameters, "Donor Race", &donorRace[0][0], 3);
+	compileParameter(parameters, "Donor Cigarette Use", donorCigaretteUse, 1, 1);
+
+	compileParameter(parameters, "Donor-Recipient Sex", &sex[0][0], 4);
+	compileParameter(parameters, "Donor-Recipient Weight Ratio", &weightRatio[0][0], 4);
+	compileParameter(parameters, "Donor-Recipient Height Ratio", &heightRatio[0][0], 3);
+
+	// Donor age coefficients are stored by recipient age group, so are copied one group at a time
+	std::string recipientAgeGroups[SURVIVAL_AGE_GROUPS] = { "Age < 12", "13-17", "18-29", "30-39", "40-49", "50-59", "60+" };
+
+	for (int group = 0; group < SURVIVAL_AGE_GROUPS; group++) {
+
+		double coefficients[SURVIVAL_HORIZONS][4];
+		compileParameter(parameters, "Among Recipients " + recipientAgeGroups[group], &coefficients[0][0], 4);
+
+		for (int h = 0; h < SURVIVAL_HORIZONS; h++) {
+			for (int changePoint = 0; changePoint < 4; changePoint++) {
+				donorAge[h][group][changePoint] = coefficients[h][changePoint];
+			}
+		}
+	}
+
+	double noMismatch[SURVIVAL_HORIZONS];
+	double transplantYear[SURVIVAL_HORIZONS];
+	compileParameter(parameters, "HLA ABDR Mismatch", noMismatch, 1);
+	compileParameter(parameters, "Transplant Year", transplantYear, 1, 2);
+
+	for (int h = 0; h < SURVIVAL_HORIZONS; h++) {
+		constant[h] = noMismatch[h] + transplantYear[h];
+
+		recipientAge[h][4] = 0.0; // Reference group
+
+		logBaseline[h] = log(baseline[h]);
+	}
+
+	compiled = true;
+}
+
+bool KPDSurvivalModel::isCompiled() {
+
+	return compiled;
+}
+
+void KPDSurvivalModel::calculateCandidateTerms(KPDCandidate * candidate, double terms[SURVIVAL_HORIZONS]) {
+
+	int ageGroup = recipientAgeGroup(candidate->getAge());
+
+	int race = 3;
+	if (candidate->getRace() == RACE_WHITE) {
+		race = 0;
+	}
+	else if (candidate->getRace() == RACE_BLACK) {
+		race = 1;
+	}
+	else if (candidate->getRace() == RACE_HISPANIC) {
+		race = 2;
+	}
+
+	int candidatePRA = candidate->getPRA();
+	int praLevel = 0;
+	if (candidatePRA >= 10 && candidatePRA <= 79) {
+		praLevel = 1;
+	}
+	else if (candidatePRA >= 80 && candidatePRA <= 100) {
+		praLevel = 2;
+	}
+
+	double tod = candidate->getTOD();
+	int todLevel = -1;
+	if (tod == 0) {
+		todLevel = 0;
+	}
+	else if (tod > 0 && tod <= 1) {
+		todLevel = 1;
+	}
+	else if (tod > 1 && tod <= 2) {
+		todLevel = 2;
+	}
+	else if (tod > 2 && tod <= 3) {
+		todLevel = 3;
+	}
+	else if (tod > 3) {
+		todLevel = 4;
+	}
+
+	KPDInsurance insurance = candidate->getInsurance();
+	int insuranceLevel = -1;
+	if (insurance == INSURANCE_PUBLIC || insurance == INSURANCE_MEDICARE || insurance == INSURANCE_MEDICARE_PLUS || insurance == INSURANCE_MEDICAID) {
+		insuranceLevel = 0;
+	}
+	else if (insurance == INSURANCE_PRIVATE || insurance == INSURANCE_PRIVATE_PLUS) {
+		insuranceLevel = 1;
+	}
+	else if (insurance == INSURANCE_OTHER) {
+		insuranceLevel = 2;
+	}
+
+	bool bmi = candidate->getBMI() > 30;
+	bool diabetes = candidate->getDiabetes();
+	bool prevTrans = candidate->getPrevTrans();
+	bool hepC = candidate->getHepC();
+
+	for (int h = 0; h < SURVIVAL_HORIZONS; h++) {
+
+		double term = recipientAge[h][ageGroup] + recipientRace[h][race];
+
+		if (bmi) {
+			term += recipientBMI[h];
+		}
+		if (praLevel > 0) {
+			term += pra[h][praLevel];
+		}
+		if (diabetes) {
+			term += recipientDiabetes[h];
+		}
+		if (prevTrans) {
+			term += previousTransplant[h];
+		}
+		if (todLevel >= 0) {
+			term += timeOnDialysis[h][todLevel];
+		}
+		if (hepC) {
+			term += recipientHepC[h];
+		}
+		if (insuranceLevel >= 0) {
+			term += recipientInsurance[h][insuranceLevel];
+		}
+
+		terms[h] = term;
+	}
+}
+
+void KPDSurvivalModel::calculateDonorTerms(KPDDonor * donor, double terms[SURVIVAL_HORIZONS]) {
+
+	int race = 0;
+	if (donor->getRace() == RACE_BLACK) {
+		race = 1;
+	}
+	else if (donor->getRace() == RACE_HISPANIC) {
+		race = 2;
+	}
+
+	bool bmi = donor->getBMI() > 30;
+	bool cigaretteUse = donor->getCigaretteUse();
+
+	for (int h = 0; h < SURVIVAL_HORIZONS; h++) {
+
+		double term = donorRace[h][race];
+
+		if (bmi) {
+			term += donorBMI[h];
+		}
+		if (cigaretteUse) {
+			term += donorCigaretteUse[h];
+		}
+
+		terms[h] = term;
+	}
+}
+
+const double * KPDSurvivalModel::getCandidateTerms(KPDCandidate * candidate, double buffer[SURVIVAL_HORIZONS]) {
+
+	if (candidate->getSurvivalTermsSet()) {
+		return candidate->getSurvivalTerms();
+	}
+
+	calculateCandidateTerms(candidate, buffer);
+
+	return buffer;
+}
+
+const double * KPDSurvivalModel::getDonorTerms(KPDDonor * donor, double buffer[SURVIVAL_HORIZONS]) {
+
+	if (donor->getSurvivalTermsSet()) {
+		return donor->getSurvivalTerms();
+	}
+
+	calculateDonorTerms(donor, buffer);
+
+	return buffer;
+}
+
+void KPDSurvivalModel::calculateLinearPredictors(KPDCandidate * candidate, const double candidateTerms[SURVIVAL_HORIZONS], KPDDonor * donor, const double donorTerms[SURVIVAL_HORIZONS], double linearPredictors[SURVIVAL_HORIZONS]) {
+
+	int ageGroup = recipientAgeGroup(candidate->getAge());
+
+	//Donor age enters piecewise, with change points at 30, 40 and 50
+	static const int donorAgeChangePoints[4] = { 30, 10, 10, 10 };
+
+	double donorAgeSegments[4] = { 0.0, 0.0, 0.0, 0.0 };
+	int donorsAge = donor->getAge();
+
+	for (int changePoint = 0; changePoint < 4 && donorsAge > 0; changePoint++) {
+		donorAgeSegments[changePoint] = donorsAge;
+		donorsAge -= donorAgeChangePoints[changePoint];
+	}
+
+	int sexLevel = -1;
+	if (!candidate->getMale()) {
+		sexLevel = donor->getMale() ? 1 : 0;
+	}
+	else if (donor->getMale()) {
+		sexLevel = 3;
+	}
+
+	double ratio = donor->getWeight() / candidate->getWeight();
+	int weightRatioLevel = -1;
+	if (ratio < 0.75) {
+		weightRatioLevel = 0;
+	}
+	else if (ratio >= 0.75 && ratio < 0.90) {
+		weightRatioLevel = 1;
+	}
+	else if (ratio >= 1.15) {
+		weightRatioLevel = 3;
+	}
+
+	ratio = donor->getHeight() / candidate->getHeight();
+	int heightRatioLevel = -1;
+	if (ratio < 0.94) {
+		heightRatioLevel = 0;
+	}
+	else if (ratio >= 0.94 && ratio < 1.0) {
+		heightRatioLevel = 1;
+	}
+	else if (ratio >= 1.06) {
+		heightRatioLevel = 2;
+	}
+
+	for (int h = 0; h < SURVIVAL_HORIZONS; h++) {
+
+		double linearPredictor = candidateTerms[h] + donorTerms[h] + constant[h];
+
+		for (int changePoint = 0; changePoint < 4; changePoint++) {
+			linearPredictor += donorAgeSegments[changePoint] * donorAge[h][ageGroup][changePoint];
+		}
+
+		if (sexLevel >= 0) {
+			linearPredictor += sex[h][sexLevel];
+		}
+		if (weightRatioLevel >= 0) {
+			linearPredictor += weightRatio[h][weightRatioLevel];
+		}
+		if (heightRatioLevel >= 0) {
+			linearPredictor += heightRatio[h][heightRatioLevel];
+		}
+
+		linearPredictors[h] = linearPredictor;
+	}
+}
+
+void KPDSurvivalModel::calculateSurvival(KPDCandidate * candidate, KPDDonor * donor, double survival[SURVIVAL_HORIZONS]) {
+
+	double candidateBuffer[SURVIVAL_HORIZONS];
+	double donorBuffer[SURVIVAL_HORIZONS];
+
+	double linearPredictors[SURVIVAL_HORIZONS];
+
+	calculateLinearPredictors(candidate, getCandidateTerms(candidate, candidateBuffer), donor, getDonorTerms(donor, donorBuffer), linearPredictors);
+
+	for (int h = 0; h < SURVIVAL_HORIZONS; h++) {
+		survival[h] = exp(exp(linearPredictors[h]) * logBaseline[h]);
+	}
+}
+
+void KPDSurvivalModel::calculateSurvivalBatch(const std::vector<KPDCandidate *> & candidates, const std::vector<KPDDonor *> & donors, std::vector<double> & fiveYearSurvival, std::vector<double> & tenYearSurvival) {
+
+	int n = (int)candidates.size();
+
+	fiveYearSurvival.resize(n);
+	tenYearSurvival.resize(n);
+
+	//Linear predictors (stored in the output arrays)
+	double candidateBuffer[SURVIVAL_HORIZONS];
+	double donorBuffer[SURVIVAL_HORIZONS];
+
+	const double * candidateTerms = NULL;
+	KPDCandidate * previousCandidate = NULL;
+
+	for (int i = 0; i < n; i++) {
+
+		// Consecutive pairs often share a candidate
+		if (candidates[i] != previousCandidate) {
+			candidateTerms = getCandidateTerms(candidates[i], candidateBuffer);
+			previousCandidate = candidates[i];
+		}
+
+		double linearPredictors[SURVIVAL_HORIZONS];
+
+		calculateLinearPredictors(candidates[i], candidateTerms, donors[i], getDonorTerms(donors[i], donorBuffer), linearPredictors);
+
+		fiveYearSurvival[i] = linearPredictors[SURVIVAL_5_YEAR];
+		tenYearSurvival[i] = linearPredictors[SURVIVAL_10_YEAR];
+	}
+
+	//Survival, over contiguous arrays
+	double * five = n > 0 ? &fiveYearSurvival[0] : NULL;
+	double * ten = n > 0 ? &tenYearSurvival[0] : NULL;
+
+	double logBaseline5 = logBaseline[SURVIVAL_5_YEAR];
+	double logBaseline10 = logBaseline[SURVIVAL_10_YEAR];
+
+	for (int i = 0; i < n; i++) {
+		five[i] = exp(exp(five[i]) * logBaseline5);
+	}
+
+	for (int i = 0; i < n; i++) {
+		ten[i] = exp(exp(ten[i]) * logBaseline10);
+	}
+}
+
+void KPDSurvivalModel::calculateSurvivalBatch(KPDCandidate * candidate, const std::vector<KPDDonor *> & donors, std::vector<double> & fiveYearSurvival, std::vector<double> & tenYearSurvival) {
+
+	std::vector<KPDCandidate *> candidates(donors.size(), candidate);
+
+	calculateSurvivalBatch(candidates, donors, fiveYearSurvival, tenYearSurvival);
+}
+
+#endif
@@ -0,0 +1,205 @@
+/* ---------------------------------------------
+DD-ThreadPool.h
+Defines a Work-Stealing Thread Pool for
+Independent Tasks (e.g., Arrangement Utilities)
+---------------------------------------------- */
+
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <algorithm>
+
+class KPDThreadPool {
+
+private:
+
+	int numberOfThreads;
+
+	// Each worker owns a queue of task indices; idle workers steal from the back of other queues
+	std::vector<std::deque<int> > taskQueues;
+	std::vector<std::mutex> taskQueueLocks;
+
+	// Worker threads are started by the first parallel loop and wait for the next one, so loops do not pay for starting threads
+	std::vector<std::thread> workerThreads;
+	std::mutex poolLock;
+	std::condition_variable workAvailable;
+	std::condition_variable workFinished;
+
+	const std::function<void(int)> * currentTask;
+	long long currentLoop; // Number of parallel loops started
+	int busyWorkers;
+	bool stopping;
+
+	bool popTask(int worker, int & task);
+	bool stealTask(int worker, int & task);
+	void runWorker(int worker, const std::function<void(int)> & task);
+	void waitForWork(int worker);
+
+public:
+
+	KPDThreadPool(int threads); // threads <= 0 uses all available hardware threads
+	~KPDThreadPool();
+
+	int getNumberOfThreads();
+
+	// Runs task(0), ..., task(numberOfTasks - 1); returns once every task has finished (tasks may not start another loop on the same pool)
+	void parallelFor(int numberOfTasks, const std::function<void(int)> & task);
+};
+
+KPDThreadPool::KPDThreadPool(int threads) : taskQueueLocks(threads > 0 ? threads : std::max(1, (int)std::thread::hardware_concurrency())) {
+
+	numberOfThreads = (int)taskQueueLocks.size();
+
+	taskQueues.assign(numberOfThreads, std::deque<int>());
+
+	currentTask = NULL;
+	currentLoop = 0;
+	busyWorkers = 0;
+	stopping = false;
+}
+
+KPDThreadPool::~KPDThreadPool() {
+
+	{
+		std::lock_guard<std::mutex> lock(poolLock);
+		stopping = true;
+	}
+
+	workAvailable.notify_all();
+
+	for (std::vector<std::thread>::iterator it = workerThreads.begin(); it != workerThreads.end(); it++) {
+		it->join();
+	}
+}
+
+int KPDThreadPool::getNumberOfThreads() {
+	return numberOfThreads;
+}
+
+bool KPDThreadPool::popTask(int worker, int & task) {
+
+	std::lock_guard<std::mutex> lock(taskQueueLocks[worker]);
+
+	if (taskQueues[worker].empty()) {
+		return false;
+	}
+
+	task = taskQueues[worker].front();
+	taskQueues[worker].pop_front();
+
+	return true;
+}
+
+bool KPDThreadPool::stealTask(int worker, int & task) {
+
+	// Visit the other workers in a fixed order, starting with the next worker
+	for (int i = 1; i < numberOfThreads; i++) {
+
+		int victim = (worker + i) % numberOfThreads;
+
+		std::lock_guard<std::mutex> lock(taskQueueLocks[victim]);
+
+		if (!taskQueues[victim].empty()) {
+			task = taskQueues[victim].back();
+			taskQueues[victim].pop_back();
+
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void KPDThreadPool::runWorker(int worker, const std::function<void(int)> & task) {
+
+	int taskIndex = -1;
+
+	// Tasks are never added once the loop starts, so a failed steal means all work is claimed
+	while (popTask(worker, taskIndex) || stealTask(worker, taskIndex)) {
+		task(taskIndex);
+	}
+}
+
+void KPDThreadPool::waitForWork(int worker) {
+
+	long long loopsSeen = 0;
+
+	while (true) {
+
+		const std::function<void(int)> * task;
+
+		{
+			std::unique_lock<std::mutex> lock(poolLock);
+			workAvailable.wait(lock, [&]() { return stopping || currentLoop != loopsSeen; });
+
+			if (stopping) {
+				return;
+			}
+
+			loopsSeen = currentLoop;
+			task = currentTask;
+		}
+
+		runWorker(worker, *task);
+
+		{
+			std::lock_guard<std::mutex> lock(poolLock);
+			busyWorkers--;
+
+			if (busyWorkers == 0) {
+				workFinished.notify_one();
+			}
+		}
+	}
+}
+
+void KPDThreadPool::parallelFor(int numberOfTasks, const std::function<void(int)> & task) {
+
+	if (numberOfTasks <= 0) {
+		return;
+	}
+
+	// Run serially when there is nothing to share
+	if (numberOfThreads == 1 || numberOfTasks == 1) {
+		for (int i = 0; i < numberOfTasks; i++) {
+			task(i);
+		}
+		return;
+	}
+
+	// Deal out contiguous blocks of tasks to the workers
+	int workers = std::min(numberOfThreads, numberOfTasks);
+
+	for (int i = 0; i < numberOfTasks; i++) {
+		taskQueues[(int)((long long)i * workers / numberOfTasks)].push_back(i);
+	}
+
+	if (workerThreads.empty()) {
+		for (int w = 1; w < numberOfThreads; w++) {
+			workerThreads.push_back(std::thread(&KPDThreadPool::waitForWork, this, w));
+		}
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(poolLock);
+
+		currentTask = &task;
+		currentLoop++;
+		busyWorkers = (int)workerThreads.size();
+	}
+
+	workAvailable.notify_all();
+
+	runWorker(0, task); // Calling thread acts as the first worker
+
+	std::unique_lock<std::mutex> lock(poolLock);
+	workFinished.wait(lock, [&]() { return busyWorkers == 0; });
+}
+
+#endif